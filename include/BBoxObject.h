@@ -45,6 +45,9 @@ public:
     bool is_within(glm::vec3 pos) const;
     glm::vec3 limit(glm::vec3 pos) const;
     glm::vec3 wrap(glm::vec3 pos) const;
+    void get_abs_min_max(TransformObject* self_transform_object,
+                         glm::vec3*       min,
+                         glm::vec3*       max) const;
     bool is_bbox_collide(TransformObject* self_transform_object,
                          TransformObject* other_transform_object,
                          BBoxObject*      other_bbox_object);
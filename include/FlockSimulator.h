@@ -0,0 +1,167 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_FLOCK_SIMULATOR_H_
+#define VT_FLOCK_SIMULATOR_H_
+
+#include <Octree.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vt {
+
+class ThreadPool;
+
+// what steered an agent during the last step (main_boids colors agents by it in wireframe mode)
+enum flock_behavior_t {
+    FLOCK_BEHAVIOR_NONE,
+    FLOCK_BEHAVIOR_REVERSE,        // obstacle dead ahead, turned around
+    FLOCK_BEHAVIOR_OBSTACLE_AVOID, // obstacle off to the side, steered past it
+    FLOCK_BEHAVIOR_SEPARATION,     // too close to nearest neighbor
+    FLOCK_BEHAVIOR_FLOCKING,       // cohesion & alignment
+    FLOCK_BEHAVIOR_HOMING,         // near target
+    FLOCK_BEHAVIOR_CRUISE          // nothing around, straight ahead
+};
+
+// LIDAR rays cast by every agent each step, in its local frame
+enum flock_lidar_t {
+    FLOCK_LIDAR_AHEAD,
+    FLOCK_LIDAR_UP,
+    FLOCK_LIDAR_LEFT,
+    FLOCK_LIDAR_RIGHT,
+    FLOCK_LIDAR_COUNT
+};
+
+// distances in world units, angles in degrees, per-step amounts are for dt = 1
+struct FlockConfig
+{
+    float m_avoid_radius;
+    float m_flocking_radius;
+    float m_nearest_neighbor_radius;
+    int   m_nearest_neighbor_count; // including self
+    float m_obstacle_avoid_radius;
+    float m_obstacle_reverse_radius;
+    float m_angle_delta;
+    float m_avoid_angle_delta;
+    float m_cohesion_to_alignment_ratio;
+    float m_max_heading_deviation;
+    float m_max_fov_deviation;
+    float m_lidar_fov;
+
+    FlockConfig();
+};
+
+// boids without meshes or GL: agent i is row i of every state array
+class FlockSimulator
+{
+public:
+    FlockSimulator(glm::vec3          origin, // agents wrap around this box
+                   glm::vec3          dim,
+                   const FlockConfig& config = FlockConfig());
+    ~FlockSimulator();
+
+    const FlockConfig& get_config() const { return m_config; }
+    void set_config(const FlockConfig& config);
+
+    // state (heading and up direction are unit length and orthogonal)
+    long add_agent(glm::vec3 pos, glm::vec3 heading, glm::vec3 up_direction, float speed);
+    void set_agent(long index, glm::vec3 pos, glm::vec3 heading, glm::vec3 up_direction, float speed);
+    void clear_agents();
+    size_t get_agent_count() const { return m_positions.size(); }
+    const std::vector<glm::vec3>&        get_positions() const     { return m_positions; }
+    const std::vector<glm::vec3>&        get_headings() const      { return m_headings; }
+    const std::vector<glm::vec3>&        get_up_directions() const { return m_up_directions; }
+    const std::vector<float>&            get_speeds() const        { return m_speeds; }
+    const std::vector<flock_behavior_t>& get_behaviors() const     { return m_behaviors; }
+
+    // obstacles are the boxes in obstacle_octree (NULL for none), hit_func refines bbox hits (e.g. rotated boxes)
+    // NOTE: when double buffered with a thread pool, hit_func is called from several threads at once
+    void set_obstacles(const Octree*                 obstacle_octree,
+                       const Octree::ray_hit_func_t& hit_func = Octree::ray_hit_func_t());
+    void set_target(glm::vec3 target) { m_target = target; }
+    glm::vec3 get_target() const { return m_target; }
+
+    // neighbor search
+    Octree* get_octree() const { return m_octree; }
+    void set_thread_pool(ThreadPool* thread_pool) { m_thread_pool = thread_pool; }
+    void set_use_find_hints(bool use_find_hints);
+    bool get_use_find_hints() const { return m_use_find_hints; }
+    int get_neighbors(long index, const long** ids) const; // from last step, self excluded
+    bool is_flocking_neighbor(long index, long other_index) const; // passes heading and FOV deviation limits, so steers
+
+    // double buffered: all agents read step t and write step t + 1, updated in parallel on the thread pool
+    // with the same result for any thread count; otherwise agents update in place, one after another
+    void set_double_buffered(bool double_buffered) { m_double_buffered = double_buffered; }
+    bool get_double_buffered() const { return m_double_buffered; }
+
+    // LIDAR reading from last step, BIG_NUMBER if nothing hit
+    float get_lidar_dist(long index, flock_lidar_t lidar) const;
+    glm::vec3 get_lidar_dir(long index, flock_lidar_t lidar) const;
+
+    // advance all agents by dt steps
+    void step(float dt = 1);
+
+private:
+    FlockConfig                   m_config;
+    glm::vec3                     m_min;
+    glm::vec3                     m_max;
+    glm::vec3                     m_target;
+    std::vector<glm::vec3>        m_positions;
+    std::vector<glm::vec3>        m_headings;
+    std::vector<glm::vec3>        m_up_directions;
+    std::vector<float>            m_speeds;
+    std::vector<flock_behavior_t> m_behaviors;
+    std::vector<float>            m_lidar_dists; // FLOCK_LIDAR_COUNT per agent
+    glm::vec3                     m_lidar_local_dirs[FLOCK_LIDAR_COUNT];
+    Octree*                       m_octree;
+    const Octree*                 m_obstacle_octree;
+    Octree::ray_hit_func_t        m_obstacle_hit_func;
+    ThreadPool*                   m_thread_pool;
+    bool                          m_use_find_hints;
+    bool                          m_double_buffered;
+    std::vector<glm::vec3>        m_next_positions;
+    std::vector<glm::vec3>        m_next_headings;
+    std::vector<glm::vec3>        m_next_up_directions;
+    KnnGraph                      m_nearest_k_graph;
+    FindBatchResults              m_nearest_k_results;
+    std::vector<FindHint>         m_find_hints;
+
+    void update_octree();
+    void update_agent(long       index,
+                      float      dt,
+                      glm::vec3* pos,
+                      glm::vec3* heading,
+                      glm::vec3* up_direction);
+    void update_lidar_local_dirs();
+    void turn_toward(glm::vec3  pos,
+                     glm::vec3  target,
+                     float      angle_delta,
+                     float      avoid_radius,
+                     glm::vec3* heading,
+                     glm::vec3* up_direction) const;
+    glm::vec3 wrap(glm::vec3 pos) const;
+    static bool within_flocking_view(glm::vec3 self_pos,
+                                     glm::vec3 self_heading,
+                                     glm::vec3 other_pos,
+                                     glm::vec3 other_heading,
+                                     float     max_heading_deviation_cos,
+                                     float     max_fov_deviation_cos);
+};
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_IK_BATCH_SOLVER_H_
+#define VT_IK_BATCH_SOLVER_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vt {
+
+class IKChain;
+class ThreadPool;
+
+// solves many independent chains at once (e.g. all legs of a robot once the body pose is fixed)
+// poses are loaded from the hierarchy up front, chains are solved concurrently on the thread pool,
+// and results are committed back to the hierarchy after all solves finish
+// NOTE: chains must not share segments, but may share ancestors
+class IKBatchSolver
+{
+public:
+    IKBatchSolver(ThreadPool* thread_pool = NULL); // NULL to solve on the calling thread
+    void set_thread_pool(ThreadPool* thread_pool) { m_thread_pool = thread_pool; }
+
+    // chain/target pairs for the next solve
+    void clear();
+    void add(IKChain* ik_chain, glm::vec3 target, const glm::vec3* end_effector_dir = NULL);
+    size_t get_job_count() const { return m_jobs.size(); }
+
+    // each chain with its own solver, returns how many found a solution, see IKChain::solve
+    int solve(int   iters,
+              float accept_end_effector_distance,
+              float accept_avg_angle_distance);
+    bool get_result(size_t index) const { return m_jobs[index].m_result; }
+
+private:
+    struct Job
+    {
+        IKChain*  m_ik_chain;
+        glm::vec3 m_target;
+        glm::vec3 m_end_effector_dir;
+        bool      m_use_end_effector_dir;
+        bool      m_result;
+    };
+
+    ThreadPool*      m_thread_pool;
+    std::vector<Job> m_jobs;
+};
+
+}
+
+#endif
@@ -0,0 +1,173 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_IK_CHAIN_H_
+#define VT_IK_CHAIN_H_
+
+#include <TransformObject.h>
+#include <Util.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vt {
+
+// joint chain from root down to end effector, copied out of the TransformObject hierarchy into flat arrays
+// so it can be solved without touching the hierarchy (no cached transforms, no virtual calls, no guide wires)
+// usage per frame: load() current poses, solve, commit() joints back to the hierarchy
+class IKChain
+{
+public:
+    enum solver_t {
+        SOLVER_CCD,
+        SOLVER_FABRIK,
+        SOLVER_DLS
+    };
+
+    IKChain(TransformObject* root,
+            TransformObject* end_effector,
+            glm::vec3        local_end_effector_tip);
+
+    TransformObject* get_root() const         { return m_segments.front(); }
+    TransformObject* get_end_effector() const { return m_segments.back(); }
+    size_t get_segment_count() const          { return m_segments.size(); }
+    glm::vec3 get_end_effector_tip() const;
+
+    // joint types and constraints are captured at construction, poses and root's parent transform here
+    void load();
+
+    // solver used by solve(), see bench_ik for which one suits a rig
+    solver_t get_solver() const      { return m_solver; }
+    void set_solver(solver_t solver) { m_solver = solver; }
+    float get_dls_damping() const           { return m_dls_damping; }
+    void set_dls_damping(float dls_damping) { m_dls_damping = dls_damping; } // as a fraction of chain length
+
+    // closed form solution for legs, used by solve() instead of iterating when the chain is shaped like one and
+    // end_effector_dir isn't given: 2 or 3 pitch hinges in one plane, after a yaw or roll hip that turns the plane,
+    // or before a yaw hinge wrist (of 3, the leading one is placed by sampling its range); solve() still iterates
+    // with the chosen solver if the target is out of reach within joint limits
+    bool is_analytic() const                       { return m_analytic_leg.m_upper_index >= 0; }
+    bool get_enable_analytic() const               { return m_enable_analytic; }
+    void set_enable_analytic(bool enable_analytic) { m_enable_analytic = enable_analytic; }
+
+    // all solvers share the constraint model of TransformObject::solve_ik_ccd (hinges, prismatic joint limits,
+    // end effector pointing along end_effector_dir) and its result: converged, with end effector tip on target
+    bool solve(glm::vec3  target,
+               glm::vec3* end_effector_dir,
+               int        iters,
+               float      accept_end_effector_distance,
+               float      accept_avg_angle_distance);
+
+    // same algorithm and constraint model as TransformObject::solve_ik_ccd
+    bool solve_ccd(glm::vec3  target,
+                   glm::vec3* end_effector_dir,
+                   int        iters,
+                   float      accept_end_effector_distance,
+                   float      accept_avg_angle_distance);
+
+    // FABRIK: joint positions are dragged to target and back to root, then joints turn to match, root first
+    // NOTE: links into prismatic joints stretch freely until joint limits are applied
+    bool solve_fabrik(glm::vec3  target,
+                      glm::vec3* end_effector_dir,
+                      int        iters,
+                      float      accept_end_effector_distance,
+                      float      accept_avg_angle_distance);
+
+    // Jacobian damped least squares: all joints take one linearized step together each iteration
+    bool solve_dls(glm::vec3  target,
+                   glm::vec3* end_effector_dir,
+                   int        iters,
+                   float      accept_end_effector_distance,
+                   float      accept_avg_angle_distance);
+
+    // tries both ways to turn the hip, and every elbow (and coxa) pose within joint limits, least joint motion first
+    // returns false (with poses untouched) if none puts end effector tip on target
+    bool solve_analytic(glm::vec3 target,
+                        float     accept_end_effector_distance);
+
+    // write joint origins and eulers back to the hierarchy in one pass
+    void commit();
+
+private:
+    // how the end effector moves per unit along one joint axis (per radian for revolute joints)
+    struct JacobianColumn
+    {
+        size_t    m_segment_index;
+        glm::vec3 m_local_axis; // in parent's system
+        glm::vec3 m_position_delta;
+        glm::vec3 m_heading_delta;
+    };
+
+    // segment indices of a leg solve_analytic can handle, -1 for parts it doesn't have
+    struct AnalyticLeg
+    {
+        int m_hip_index;   // turns leg plane about its yaw or roll axis
+        int m_coxa_index;  // pitch hinge, leading upper and lower when there are 3
+        int m_upper_index; // pitch hinge
+        int m_lower_index; // pitch hinge
+        int m_wrist_index; // yaw hinge, swings tip out of leg plane
+    };
+
+    std::vector<TransformObject*>              m_segments; // root first
+    glm::vec3                                  m_local_end_effector_tip;
+    glm::mat4                                  m_base_transform; // root's parent
+    std::vector<glm::vec3>                     m_origins;
+    std::vector<glm::vec3>                     m_eulers;
+    std::vector<glm::vec3>                     m_scales;
+    std::vector<TransformObject::joint_type_t> m_joint_types;
+    std::vector<euler_index_t>                 m_hinge_types;
+    std::vector<glm::ivec3>                    m_enable_joint_constraints;
+    std::vector<glm::vec3>                     m_joint_constraints_centers;
+    std::vector<glm::vec3>                     m_joint_constraints_max_deviations;
+    std::vector<glm::mat4>                     m_abs_transforms;
+    solver_t                                   m_solver;
+    float                                      m_dls_damping;
+    std::vector<glm::vec3>                     m_joint_positions;  // FABRIK, end effector tip last
+    std::vector<glm::vec3>                     m_goal_positions;   // FABRIK, where the passes want joint_positions
+    std::vector<float>                         m_link_lengths;     // FABRIK, joint to next joint
+    std::vector<JacobianColumn>                m_jacobian_columns; // DLS, one per joint axis, root first
+    AnalyticLeg                                m_analytic_leg;
+    bool                                       m_enable_analytic;
+    std::vector<glm::vec3>                     m_analytic_eulers;  // pose each branch starts from
+
+    glm::mat4 get_local_rotation_transform(size_t index) const;
+    glm::mat4 get_local_transform(size_t index) const;
+    glm::mat4 get_local_inverse_transform(size_t index) const;
+    void update_abs_transforms(size_t first_index = 0);
+    euler_index_t get_single_axis(size_t index) const;
+    glm::vec3 get_abs_axis(size_t index, euler_index_t euler_index) const;
+    void detect_analytic_leg();
+    bool solve_analytic_branch(glm::vec3 target, bool flip_hip);
+    void rotate_about_own_axis(size_t index, euler_index_t euler_index, float angle_delta);
+    float arcball(size_t           index,
+                  const glm::mat4& parent_transform,
+                  const glm::mat4& parent_inverse_transform,
+                  glm::vec3        abs_target,
+                  glm::vec3        abs_reference_point);
+    void apply_hinge_constraints_perpendicular_to_plane_of_free_rotation(size_t           index,
+                                                                         const glm::mat4& parent_transform,
+                                                                         const glm::mat4& parent_inverse_transform);
+    void apply_hinge_constraints_within_plane_of_free_rotation(size_t           index,
+                                                               const glm::mat4& parent_transform,
+                                                               const glm::mat4& parent_inverse_transform);
+    void apply_joint_constraints(size_t           index,
+                                 const glm::mat4& parent_transform,
+                                 const glm::mat4& parent_inverse_transform);
+};
+
+}
+
+#endif
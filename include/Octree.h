@@ -20,12 +20,19 @@
 
 #include <glm/glm.hpp>
 #include <Util.h>
-#include <queue>
+#include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
 
 namespace vt {
 
+class ThreadPool;
+class Octree;
+
 typedef std::pair<long, float> id_dist_t;
 
 struct id_dist_less_than_t
@@ -36,65 +43,368 @@ struct id_dist_less_than_t
     }
 };
 
+// flat find_batch results: query i owns m_ids[m_offsets[i] .. m_offsets[i] + m_counts[i]), nearest first
+struct FindBatchResults
+{
+    std::vector<long> m_ids;
+    std::vector<int>  m_offsets;
+    std::vector<int>  m_counts;
+};
+
+// compressed sparse row neighbor graph from knn_graph, one row per stored object in ascending id order
+// row i is object m_ids[i], its neighbors are m_neighbor_ids[m_offsets[i] .. m_offsets[i + 1]), nearest first
+struct KnnGraph
+{
+    std::vector<long> m_ids;
+    std::vector<int>  m_offsets;
+    std::vector<long> m_neighbor_ids;
+};
+
+// per-query state carried from one find to the next (e.g. one per agent)
+// remembers where the last query ended up and what it found, so a query that barely moved starts close to its answer
+// holds no pointers into the tree: the node is looked up in the tree's own pool, and only if the hint came from that
+// tree, so a hint outliving its tree or handed to another one is merely a miss
+struct FindHint
+{
+    const void*       m_tree;            // identity of the tree that wrote the hint, never dereferenced
+    int               m_node_pool_index; // -1 for root
+    unsigned          m_node_generation;
+    std::vector<long> m_nearest_k_ids;
+
+    FindHint() : m_tree(NULL), m_node_pool_index(-1), m_node_generation(0) {}
+};
+
+// query/maintenance counters, accumulated since reset_stats() (always zero when built with -DNO_OCTREE_STATS)
+enum octree_stat_t {
+    OCTREE_STAT_NODES_VISITED,    // nodes popped by find / knn_graph traversals
+    OCTREE_STAT_LEAVES_SCANNED,   // leaf scans (per query for knn_graph)
+    OCTREE_STAT_OBJECTS_TESTED,   // leaf objects distance-tested
+    OCTREE_STAT_SIBLING_SEARCHES, // hinted finds widened to a parent's other octants (k-th nearest crossed a wall)
+    OCTREE_STAT_SPLITS,           // leaves split by insert
+    OCTREE_STAT_PRUNES,           // empty nodes released
+    OCTREE_STAT_MIGRATIONS,       // objects re-homed by rebalance
+    OCTREE_STAT_COUNT
+};
+
+// tree shape, fixed for the life of a tree (see bench_octree_tune for picking one per workload)
+struct OctreeConfig
+{
+    int m_node_capacity; // objects a leaf holds before it splits
+    int m_depth_limit;   // leaves deeper than this never split
+
+    OctreeConfig();
+    OctreeConfig(int node_capacity, int depth_limit);
+};
+
+// reusable find scratch (one per thread), keeps its capacity so repeated finds don't allocate
+struct FindScratch
+{
+    std::vector<id_dist_t>                        m_nearest_k_heap;
+    std::vector<std::pair<const Octree*, float> > m_node_heap;
+};
+
+// nearest box a ray hits (see raycast), at ray_origin + ray_dir * m_dist
+struct RayHit
+{
+    long  m_id;
+    float m_dist;
+
+    RayHit() : m_id(-1), m_dist(0) {}
+};
+
 class Octree
 {
 public:
-    Octree(glm::vec3 origin,
-           glm::vec3 dim,
-           int       index  = -1,
-           int       depth  = 0,
-           Octree*   parent = NULL,
-           Octree*   root   = NULL);
+    // exact test against box id once the ray reaches its bbox; false to ignore it, else *dist to the actual hit
+    typedef std::function<bool(long id, glm::vec3 ray_origin, glm::vec3 ray_dir, float* dist)> ray_hit_func_t;
+
+    Octree(glm::vec3           origin,
+           glm::vec3           dim, // axes without a positive extent take the largest one
+           const OctreeConfig& config = OctreeConfig());
     virtual ~Octree();
     void clear();
     void prune_empty_nodes();
 
+    const OctreeConfig& get_config() const  { return m_root->m_config; }
     glm::vec3 get_origin() const            { return m_origin; }
     glm::vec3 get_dim() const               { return m_dim; }
     int       get_index() const             { return m_index; }
     int       get_depth() const             { return m_depth; }
-    Octree*   get_node(int index) const     { return m_nodes[index]; }
+    Octree*   get_node(int index) const;
     Octree*   get_parent() const            { return m_parent; }
-    Octree*   get_root() const              { return m_root; }
+    Octree*   get_root() const              { return m_root->m_node; }
     int       get_child_count() const       { return m_child_count; }
     bool      is_leaf() const               { return !m_child_count; }
     bool      is_root() const               { return !m_parent; }
-    size_t    get_leaf_object_count() const { return m_leaf_objects.size(); }
+    size_t    get_leaf_object_count() const { return m_leaf_ids.size(); }
+    size_t    get_box_count() const         { return m_box_ids.size(); }
+    float     get_mass() const              { return m_mass; } // total mass of objects under this node
+    glm::vec3 get_center_of_mass() const    { return m_center_of_mass; }
 
-    bool insert(long id, glm::vec3 pos);
+    bool insert(long id, glm::vec3 pos, float mass = 0); // root grows to fit pos, fails only if pos is not finite
+    bool build(const std::vector<std::pair<long, glm::vec3> >& objects); // root only, objects start massless
+    bool set_mass(long id, float mass);
     bool remove(long id);
     int find(glm::vec3          target,
              int                k,
              std::vector<long>* nearest_k_vec,
-             float              radius = -1) const;
+             float              radius             = -1,
+             int*               visited_node_count = NULL,
+             FindHint*          hint               = NULL) const;
+    int find(glm::vec3    target,
+             int          k,
+             long*        nearest_k_ids,   // room for k, nearest first
+             float*       nearest_k_dist2, // room for k squared distances, or NULL
+             FindScratch* scratch,
+             float        radius = -1,
+             FindHint*    hint   = NULL) const; // allocation-free once scratch (and hint) have grown
+    void find_batch(const std::vector<glm::vec3>& targets,
+                    int                           k,
+                    float                         radius,
+                    FindBatchResults*             results,
+                    ThreadPool*                   thread_pool = NULL,
+                    std::vector<FindHint>*        hints       = NULL) const; // read-only, tree must not change meanwhile
+    void knn_graph(int         k,
+                   float       radius,
+                   KnnGraph*   graph,
+                   ThreadPool* thread_pool = NULL) const; // k nearest other objects of every object, read-only
+
+    // barnes-hut: sum of mass * r / (|r|^2 + softening^2)^1.5 over every massive object (scale by G for acceleration)
+    // a node counts as one body at its center of mass once its size / distance to that is below theta (0 is exact)
+    // potential: -sum of mass / (|r|^2 + softening^2)^0.5, leaving out any object sitting exactly on target
+    glm::vec3 gravity(glm::vec3 target,
+                      float     theta,
+                      float     softening,
+                      float*    potential = NULL) const;
+    void gravity_batch(const std::vector<glm::vec3>& targets,
+                       float                         theta,
+                       float                         softening,
+                       std::vector<glm::vec3>*       accelerations,
+                       ThreadPool*                   thread_pool = NULL,
+                       std::vector<float>*           potentials  = NULL) const; // read-only, tree must not change meanwhile
     bool exists(long id);
     bool move(long id, glm::vec3 pos);
-    bool rebalance();
+    bool rebalance(); // re-homes objects that move() saw leave their leaf
+
+    // boxes (e.g. obstacles) live in the smallest node enclosing their world-space bbox, apart from the point objects
+    bool insert_box(long id, glm::vec3 min, glm::vec3 max);
+    bool remove_box(long id);
+    bool move_box(long id, glm::vec3 min, glm::vec3 max);
+    bool raycast(glm::vec3             ray_origin,
+                 glm::vec3             ray_dir,
+                 float                 max_dist,
+                 RayHit*               hit,
+                 const ray_hit_func_t& hit_func = ray_hit_func_t()) const; // first box hit, front-to-back
+    bool raycast_segment(glm::vec3             from,
+                         glm::vec3             to,
+                         RayHit*               hit,
+                         const ray_hit_func_t& hit_func = ray_hit_func_t()) const; // m_dist is distance from "from"
+    void query_overlaps(glm::vec3 min, glm::vec3 max, std::vector<long>* ids) const; // boxes touching bbox
+    void all_overlapping_pairs(std::vector<std::pair<long, long> >* pairs) const; // broadphase, smaller id first
+
+    // boxes may hang out of a node's bbox by (looseness - 1) / 2 of its size on each side
+    // 1 keeps them strictly inside (default), 2 gives a classic loose octree where moving boxes rarely change node
+    bool  set_looseness(float looseness); // root only, while holding no boxes
+    float get_looseness() const { return m_root->m_looseness; }
+
+    // hint usage: hit if the query stayed inside the node it ended up in last time
+    long get_hint_hit_count() const  { return m_root->m_hint_hit_count; }
+    long get_hint_miss_count() const { return m_root->m_hint_miss_count; }
+    void reset_hint_counters();
+
+    long get_stat(octree_stat_t stat) const { return m_root->m_stats[stat]; }
+    void reset_stats();
+    static const char* get_stat_name(octree_stat_t stat);
 
     std::string get_name() const;
     void dump() const;
 
 private:
-    void find_hier(glm::vec3                                                                    target,
-                   int                                                                          k,
-                   std::priority_queue<id_dist_t, std::vector<id_dist_t>, id_dist_less_than_t>* nearest_k_pq,
-                   bool                                                                         is_direct_lineage,
-                   float                                                                        radius) const;
+    struct MortonObject
+    {
+        uint64_t  m_code;
+        long      m_id;
+        glm::vec3 m_pos;
+    };
+
+    typedef std::pair<const Octree*, float> node_dist_t;
+
+    // counters a query (or a batch worker's range of queries) gathers locally, added to the root's in one go
+    struct QueryStats
+    {
+        long m_stats[OCTREE_STAT_COUNT];
+        long m_hint_hit_count;
+        long m_hint_miss_count;
+
+        QueryStats();
+    };
+
+    // state shared by the whole tree, owned by the root node and kept out of pool nodes so they stay small
+    struct Root
+    {
+        Octree*      m_node; // root node
+        OctreeConfig m_config;
+
+        // object id to owning leaf
+        std::unordered_map<long, Octree*> m_leaf_index;
+
+        // box id to owning node
+        std::unordered_map<long, Octree*> m_box_index;
+        float                             m_looseness;
+
+        // node pool
+        // nodes live in fixed-size blocks so their addresses stay stable; released nodes are recycled through a free list
+        std::vector<Octree*> m_pool_blocks;
+        std::vector<int>     m_pool_free_list;
+        int                  m_pool_size;
+        int                  m_leaf_capacity; // every node's leaf arrays are reserved to this, doubled when a leaf outgrows it
+
+        // objects moved out of their leaf since last rebalance (may hold duplicates and stale ids)
+        std::vector<long> m_dirty_ids;
+
+        // build scratch
+        std::vector<MortonObject> m_build_objects;
+
+        // hint counters
+        mutable std::atomic<long> m_hint_hit_count;
+        mutable std::atomic<long> m_hint_miss_count;
+
+        // see octree_stat_t
+        mutable std::atomic<long> m_stats[OCTREE_STAT_COUNT];
+
+        Root(Octree* node, const OctreeConfig& config);
+        ~Root(); // releases pool nodes
+        Octree* alloc_node(glm::vec3 origin,
+                           glm::vec3 dim,
+                           int       index,
+                           int       depth,
+                           Octree*   parent);
+        void free_node(Octree* node);
+        Octree* get_pool_node(int pool_index) const;
+    };
+
+    // pool node
+    Octree(glm::vec3 origin,
+           glm::vec3 dim,
+           int       index,
+           int       depth,
+           Octree*   parent,
+           Root*     root);
+
+    struct node_dist_greater_than_t
+    {
+        bool operator()(const node_dist_t& a, const node_dist_t& b) const
+        {
+            return a.second > b.second;
+        }
+    };
+
+    int find_best_first(glm::vec3                 target,
+                        int                       k,
+                        float                     radius,
+                        std::vector<id_dist_t>*   nearest_k_heap,
+                        std::vector<node_dist_t>* node_heap,
+                        FindHint*                 hint,
+                        QueryStats*               stats) const;
+    int find_best_first_hier(glm::vec3                 target,
+                             int                       k,
+                             float                     radius2,
+                             float                     bound2,
+                             std::vector<id_dist_t>*   nearest_k_heap,
+                             std::vector<node_dist_t>* node_heap,
+                             QueryStats*               stats) const;
+    float find_hint_bound2(const FindHint* hint, glm::vec3 target, int k, float radius2) const;
+    void knn_graph_leaf(const Octree*             query_leaf,
+                        int                       k,
+                        float                     radius2,
+                        id_dist_t*                nearest_k_heaps,
+                        int*                      nearest_k_heap_sizes,
+                        std::vector<node_dist_t>* node_heap,
+                        QueryStats*               stats) const;
+    void collect_leaves(std::vector<const Octree*>* leaves) const;
+    glm::vec3 gravity_hier(glm::vec3                   target,
+                           float                       theta2,
+                           float                       softening2,
+                           std::vector<const Octree*>* node_stack,
+                           float*                      potential,
+                           QueryStats*                 stats) const;
+    void add_query_stats(const QueryStats& stats) const;
+    void add_mass_hier(double mass, glm::vec3 mass_moment);
+    void find_hier(glm::vec3               target,
+                   int                     k,
+                   std::vector<id_dist_t>* nearest_k_heap,
+                   float                   radius2) const;
+    bool insert_hier(long id, glm::vec3 pos, float mass);
+    void insert_box_hier(long id, glm::vec3 min, glm::vec3 max);
+    void query_overlaps_hier(glm::vec3 min, glm::vec3 max, std::vector<long>* ids) const;
+    void all_overlapping_pairs_hier(const Octree*                        query_node,
+                                    std::vector<std::pair<long, long> >* pairs,
+                                    std::vector<long>*                   overlap_ids) const;
+    void clear_nodes();
+    void prune_empty_lineage();
+    bool grow(glm::vec3 pos);
+    void deepen_hier();
+    void unindex_hier();
+    bool build_hier(const MortonObject* begin, const MortonObject* end, int level);
+    void reset(glm::vec3 origin,
+               glm::vec3 dim,
+               int       index,
+               int       depth,
+               Octree*   parent);
+    int find_leaf_object(long id) const;
+    void remove_leaf_object(int slot);
+    void push_leaf_object(long id, glm::vec3 pos, float mass);
+    void reserve_leaf_objects(int capacity);
+    void clear_leaf_objects();
+    glm::vec3 get_leaf_position(int slot) const
+    {
+        return glm::vec3(m_leaf_xs[slot], m_leaf_ys[slot], m_leaf_zs[slot]);
+    }
+    void set_leaf_position(int slot, glm::vec3 pos)
+    {
+        if(m_leaf_masses[slot]) {
+            add_mass_hier(0, (pos - get_leaf_position(slot)) * m_leaf_masses[slot]);
+        }
+        m_leaf_xs[slot] = pos.x;
+        m_leaf_ys[slot] = pos.y;
+        m_leaf_zs[slot] = pos.z;
+    }
+    int find_box(long id) const;
+    void remove_box_slot(int slot);
+    bool is_empty() const;
     Octree* alloc_octant(glm::vec3 pos);
+    Octree* alloc_octant_index(int octant_index);
     Octree* first_including_parent_node(glm::vec3 pos);
     int get_octant_index(glm::vec3 pos) const;
+    float min_distance2(glm::vec3 pos) const;
+    float min_distance2(glm::vec3 min, glm::vec3 max) const;
+    bool within_bbox(glm::vec3 pos, float radius2) const;
     bool within_bbox(glm::vec3 pos) const;
+    void get_loose_bbox(glm::vec3* min, glm::vec3* max) const;
+    bool within_loose_bbox(glm::vec3 min, glm::vec3 max) const;
 
-    glm::vec3                 m_origin;
-    glm::vec3                 m_dim;
-    glm::vec3                 m_center;
-    int                       m_index;
-    int                       m_depth;
-    Octree*                   m_nodes[8];
-    Octree*                   m_parent;
-    Octree*                   m_root;
-    int                       m_child_count;
-    std::map<long, glm::vec3> m_leaf_objects;
+    glm::vec3              m_origin;
+    glm::vec3              m_dim;
+    glm::vec3              m_center;
+    glm::vec3              m_center_of_mass; // m_mass_moment / m_mass, cached for gravity traversals
+    double                 m_mass;           // sum over objects under this node, kept up to date on every change
+    double                 m_mass_moment[3]; // sum of mass * position
+    int                    m_index;
+    int                    m_depth;
+    int                    m_nodes[8]; // pool indices of child nodes (-1 if none)
+    Octree*                m_parent;
+    Root*                  m_root;
+    int                    m_child_count;
+    int                    m_pool_index; // -1 for root
+    unsigned               m_generation; // bumped whenever the node is released or recycled
+    std::vector<long>      m_leaf_ids;
+    std::vector<float>     m_leaf_xs; // leaf object positions, one array per axis for the vectorized scan
+    std::vector<float>     m_leaf_ys;
+    std::vector<float>     m_leaf_zs;
+    std::vector<float>     m_leaf_masses;
+    std::vector<long>      m_box_ids;
+    std::vector<glm::vec3> m_box_mins;
+    std::vector<glm::vec3> m_box_maxs;
 };
 
 }
@@ -0,0 +1,50 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_POSITION_STREAM_H_
+#define VT_POSITION_STREAM_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+
+namespace vt {
+
+// per-frame object positions recorded from a running demo, replayed by benchmarks
+class PositionStream
+{
+public:
+    PositionStream(int object_count = 0);
+
+    int get_object_count() const { return m_object_count; }
+    int get_frame_count() const;
+    const glm::vec3* get_frame(int frame) const;
+    void add_frame(const glm::vec3* positions);
+    void clear(int object_count);
+
+    // raw binary: int32 object count, int32 frame count, then frames of packed xyz floats
+    bool load(std::string filename);
+    bool save(std::string filename) const;
+
+private:
+    int                    m_object_count;
+    std::vector<glm::vec3> m_positions;
+};
+
+}
+
+#endif
@@ -165,6 +165,7 @@ public:
                                bool  draw_hud_text = false,
                                char* hud_text      = const_cast<char*>("")) const;
     void render_lights() const;
+    void render_points(const glm::vec3* points, size_t count, glm::vec3 color, float point_size = 2) const; // e.g. agents without a mesh
 
 private:
     Camera*     m_camera;
@@ -0,0 +1,47 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_SIMD_DISTANCE_H_
+#define VT_SIMD_DISTANCE_H_
+
+#include <glm/glm.hpp>
+
+namespace vt {
+
+enum simd_isa_t {
+    SIMD_ISA_SCALAR,
+    SIMD_ISA_SSE,
+    SIMD_ISA_AVX
+};
+
+// squared distances from target to count points held as separate x, y and z arrays
+// vectorized with the widest instruction set this cpu supports, picked at runtime
+void distance2_soa(const float* xs,
+                   const float* ys,
+                   const float* zs,
+                   int          count,
+                   glm::vec3    target,
+                   float*       dist2);
+
+simd_isa_t  get_simd_isa();
+bool        set_simd_isa(simd_isa_t isa); // false if this cpu lacks it; NOTE: not thread-safe, call before querying
+bool        is_simd_isa_supported(simd_isa_t isa);
+const char* get_simd_isa_name(simd_isa_t isa);
+
+}
+
+#endif
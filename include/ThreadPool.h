@@ -0,0 +1,64 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_THREAD_POOL_H_
+#define VT_THREAD_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace vt {
+
+// persistent worker threads; the calling thread joins in on every job
+class ThreadPool
+{
+public:
+    typedef std::function<void(int begin, int end)> range_func_t;
+
+    ThreadPool(int thread_count = 0); // total threads including caller, 0 for one per hardware thread
+    ~ThreadPool();
+
+    int get_thread_count() const { return m_threads.size() + 1; }
+
+    // run range_func over [0, count) in chunks of grain_size, returns when all chunks are done
+    // NOTE: not reentrant; call from one thread at a time
+    void parallel_for(int count, const range_func_t& range_func, int grain_size = 0);
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex               m_mutex;
+    std::condition_variable  m_work_cond;
+    std::condition_variable  m_done_cond;
+    const range_func_t*      m_range_func;
+    int                      m_count;
+    int                      m_grain_size;
+    std::atomic<int>         m_next_index;
+    int                      m_busy_thread_count;
+    long                     m_job_generation;
+    bool                     m_is_stopping;
+
+    void worker_loop();
+    void run_chunks();
+};
+
+}
+
+#endif
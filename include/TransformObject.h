@@ -28,6 +28,8 @@ namespace vt {
 
 class TransformObject : public NamedObject
 {
+    friend class IKChain;
+
 public:
     enum joint_type_t {
         JOINT_TYPE_REVOLUTE,
@@ -52,22 +54,24 @@ public:
     const glm::vec3 &get_euler() const  { return m_euler; }
     const glm::vec3 &get_scale() const  { return m_scale; }
     void set_origin(glm::vec3 origin);
-    void set_euler(glm::vec3 euler);
+    void set_euler(glm::vec3 euler, const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL);
     void set_scale(glm::vec3 scale);
     void reset_transform();
 
     // coordinate system conversions
-    glm::vec3 in_abs_system(glm::vec3 local_point = glm::vec3(0));
+    // NOTE: where given, parent_abs_transform stands in for the parent's cached transform (see solve_ik_ccd),
+    //       and must come with its inverse wherever a parent_inverse_transform is taken
+    glm::vec3 in_abs_system(glm::vec3 local_point = glm::vec3(0), const glm::mat4* parent_abs_transform = NULL);
     glm::vec3 in_parent_system(glm::vec3 abs_point) const;
-    glm::vec3 from_origin_in_parent_system(glm::vec3 abs_point) const;
+    glm::vec3 from_origin_in_parent_system(glm::vec3 abs_point, const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL) const;
     glm::vec3 get_abs_left_direction();
     glm::vec3 get_abs_up_direction();
     glm::vec3 get_abs_heading();
-    glm::vec3 get_abs_direction(euler_index_t euler_index);
+    glm::vec3 get_abs_direction(euler_index_t euler_index, const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL);
 
     // coordinate system operations
-    void point_at_local(glm::vec3 local_target, glm::vec3* local_up_direction = NULL);
-    void set_local_rotation_transform(glm::mat4 rotation_transform);
+    void point_at_local(glm::vec3 local_target, glm::vec3* local_up_direction = NULL, const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL);
+    void set_local_rotation_transform(glm::mat4 rotation_transform, const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL);
     void rotate(glm::mat4 rotation_transform);
     void rotate(float angle_delta, glm::vec3 pivot);
 
@@ -89,16 +93,21 @@ public:
     void set_joint_constraints_max_deviation(glm::vec3 joint_constraints_max_deviation) { m_joint_constraints_max_deviation = joint_constraints_max_deviation; }
     void set_hinge_type(euler_index_t hinge_type);
     bool is_hinge() const { return m_hinge_type != EULER_INDEX_UNDEF; }
-    void apply_hinge_constraints_perpendicular_to_plane_of_free_rotation();
-    void apply_hinge_constraints_within_plane_of_free_rotation();
-    void apply_joint_constraints();
+    void apply_hinge_constraints_perpendicular_to_plane_of_free_rotation(const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL);
+    void apply_hinge_constraints_within_plane_of_free_rotation(const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL);
+    void apply_joint_constraints(const glm::mat4* parent_abs_transform = NULL, const glm::mat4* parent_inverse_transform = NULL);
 
     // advanced features
-    void arcball(glm::vec3* local_arc_pivot_dir,
-                 float*     angle_delta,
-                 glm::vec3  abs_target,
-                 glm::vec3  abs_reference_point);
-    void project_to_plane_of_free_rotation(glm::vec3* target, glm::vec3* end_effector_tip);
+    void arcball(glm::vec3*       local_arc_pivot_dir,
+                 float*           angle_delta,
+                 glm::vec3        abs_target,
+                 glm::vec3        abs_reference_point,
+                 const glm::mat4* parent_abs_transform     = NULL,
+                 const glm::mat4* parent_inverse_transform = NULL);
+    void project_to_plane_of_free_rotation(glm::vec3*       target,
+                                           glm::vec3*       end_effector_tip,
+                                           const glm::mat4* parent_abs_transform     = NULL,
+                                           const glm::mat4* parent_inverse_transform = NULL);
     bool solve_ik_ccd(TransformObject* root,
                       glm::vec3        local_end_effector_tip,
                       glm::vec3        target,
@@ -116,6 +125,8 @@ public:
     const glm::mat4 &get_transform(bool trace_down = true);
     const glm::mat4 &get_normal_transform();
     glm::mat4 get_local_rotation_transform() const;
+    glm::mat4 get_local_transform() const;
+    glm::mat4 get_local_inverse_transform() const;
 
 protected:
     // basic features
@@ -150,6 +161,9 @@ private:
 
     // joint constraints
     void check_roll_hinge();
+    glm::vec3 get_parent_abs_origin(const glm::mat4* parent_abs_transform);
+    glm::mat4 get_parent_abs_transform(const glm::mat4* parent_abs_transform);
+    glm::vec3 get_parent_abs_direction(euler_index_t euler_index, const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform);
 
     // optional advanced features
     virtual void flatten(glm::mat4* basis = NULL) {}
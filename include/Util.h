@@ -84,6 +84,7 @@ glm::vec3 offset_to_euler(glm::vec3 offset);
 glm::vec3 as_offset_in_other_system(glm::vec3 euler, glm::mat4 transform);
 glm::vec3 dir_from_point_as_offset_in_other_system(glm::vec3 euler, glm::mat4 transform, glm::vec3 point);
 glm::vec3 euler_modulo(glm::vec3 euler);
+glm::vec3 euler_index_to_axis(euler_index_t euler_index);
 float angle_modulo(float angle);
 float angle_distance(float angle1, float angle2);
 glm::vec3 nearest_point_on_plane(glm::vec3 plane_origin, glm::vec3 plane_normal, glm::vec3 point);
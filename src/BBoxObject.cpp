@@ -111,6 +111,25 @@ glm::vec3 BBoxObject::wrap(glm::vec3 pos) const
     return _pos;
 }
 
+// world-space axis-aligned bbox enclosing the (possibly rotated) bbox
+void BBoxObject::get_abs_min_max(TransformObject* self_transform_object,
+                                 glm::vec3*       min,
+                                 glm::vec3*       max) const
+{
+    if(!min || !max) {
+        return;
+    }
+    glm::vec3 points[8];
+    glm::vec3 dim = m_max - m_min;
+    vt::PrimitiveFactory::get_box_corners(points, &m_min, &dim);
+    *min = *max = self_transform_object->in_abs_system(points[0]);
+    for(int i = 1; i < 8; i++) {
+        glm::vec3 abs_point = self_transform_object->in_abs_system(points[i]);
+        *min = glm::min(*min, abs_point);
+        *max = glm::max(*max, abs_point);
+    }
+}
+
 // "separating axis theory"
 // https://gamedev.stackexchange.com/questions/25397/obb-vs-obb-collision-detection
 bool BBoxObject::is_bbox_collide(TransformObject* self_transform_object,
@@ -0,0 +1,428 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <FlockSimulator.h>
+#include <Octree.h>
+#include <ThreadPool.h>
+#include <Util.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+#include <math.h>
+
+namespace vt {
+
+FlockConfig::FlockConfig()
+    : m_avoid_radius(0.25f),
+      m_flocking_radius(4),
+      m_nearest_neighbor_radius(2),
+      m_nearest_neighbor_count(5),
+      m_obstacle_avoid_radius(2),
+      m_obstacle_reverse_radius(1),
+      m_angle_delta(2.5f),
+      m_avoid_angle_delta(5.0f),
+      m_cohesion_to_alignment_ratio(0.25f),
+      m_max_heading_deviation(90),
+      m_max_fov_deviation(180),
+      m_lidar_fov(15.0f)
+{
+}
+
+// rotate v about unit axis by angle (radians)
+static glm::vec3 rotate_about_axis(glm::vec3 v, glm::vec3 axis, float angle)
+{
+    float c = cosf(angle);
+    float s = sinf(angle);
+    return v * c + glm::cross(axis, v) * s + axis * (glm::dot(axis, v) * (1 - c));
+}
+
+FlockSimulator::FlockSimulator(glm::vec3          origin,
+                               glm::vec3          dim,
+                               const FlockConfig& config)
+    : m_config(config),
+      m_min(origin),
+      m_max(origin + dim),
+      m_target(origin + dim * 0.5f),
+      m_octree(new Octree(origin, dim)),
+      m_obstacle_octree(NULL),
+      m_thread_pool(NULL),
+      m_use_find_hints(false),
+      m_double_buffered(false)
+{
+    update_lidar_local_dirs();
+}
+
+FlockSimulator::~FlockSimulator()
+{
+    delete m_octree;
+}
+
+void FlockSimulator::set_config(const FlockConfig& config)
+{
+    m_config = config;
+    update_lidar_local_dirs();
+}
+
+long FlockSimulator::add_agent(glm::vec3 pos, glm::vec3 heading, glm::vec3 up_direction, float speed)
+{
+    m_positions.push_back(pos);
+    m_headings.push_back(heading);
+    m_up_directions.push_back(up_direction);
+    m_speeds.push_back(speed);
+    m_behaviors.push_back(FLOCK_BEHAVIOR_NONE);
+    m_lidar_dists.insert(m_lidar_dists.end(), FLOCK_LIDAR_COUNT, BIG_NUMBER);
+    return m_positions.size() - 1;
+}
+
+void FlockSimulator::set_agent(long index, glm::vec3 pos, glm::vec3 heading, glm::vec3 up_direction, float speed)
+{
+    m_positions[index]     = pos;
+    m_headings[index]      = heading;
+    m_up_directions[index] = up_direction;
+    m_speeds[index]        = speed;
+}
+
+void FlockSimulator::clear_agents()
+{
+    m_positions.clear();
+    m_headings.clear();
+    m_up_directions.clear();
+    m_speeds.clear();
+    m_behaviors.clear();
+    m_lidar_dists.clear();
+    m_find_hints.clear();
+    m_octree->clear();
+}
+
+void FlockSimulator::set_obstacles(const Octree*                 obstacle_octree,
+                                   const Octree::ray_hit_func_t& hit_func)
+{
+    m_obstacle_octree   = obstacle_octree;
+    m_obstacle_hit_func = hit_func;
+}
+
+void FlockSimulator::set_use_find_hints(bool use_find_hints)
+{
+    m_use_find_hints = use_find_hints;
+    m_find_hints.clear();
+    m_octree->reset_hint_counters();
+}
+
+int FlockSimulator::get_neighbors(long index, const long** ids) const
+{
+    if(m_use_find_hints) {
+        if(index >= static_cast<long>(m_nearest_k_results.m_counts.size())) {
+            return 0;
+        }
+        const long* nearest_k_ids   = m_nearest_k_results.m_ids.data() + m_nearest_k_results.m_offsets[index];
+        int         nearest_k_count = m_nearest_k_results.m_counts[index];
+        *ids = nearest_k_ids;
+        return nearest_k_count; // self already dropped in update_octree
+    }
+    if(index + 1 >= static_cast<long>(m_nearest_k_graph.m_offsets.size())) {
+        return 0;
+    }
+    *ids = m_nearest_k_graph.m_neighbor_ids.data() + m_nearest_k_graph.m_offsets[index];
+    return m_nearest_k_graph.m_offsets[index + 1] - m_nearest_k_graph.m_offsets[index];
+}
+
+bool FlockSimulator::is_flocking_neighbor(long index, long other_index) const
+{
+    return within_flocking_view(m_positions[index],
+                                m_headings[index],
+                                m_positions[other_index],
+                                m_headings[other_index],
+                                cosf(glm::radians(m_config.m_max_heading_deviation)),
+                                cosf(glm::radians(m_config.m_max_fov_deviation)));
+}
+
+float FlockSimulator::get_lidar_dist(long index, flock_lidar_t lidar) const
+{
+    return m_lidar_dists[index * FLOCK_LIDAR_COUNT + lidar];
+}
+
+glm::vec3 FlockSimulator::get_lidar_dir(long index, flock_lidar_t lidar) const
+{
+    const glm::vec3 &heading      = m_headings[index];
+    const glm::vec3 &up_direction = m_up_directions[index];
+    glm::vec3 left_direction = glm::cross(up_direction, heading);
+    const glm::vec3 &local_dir = m_lidar_local_dirs[lidar];
+    return left_direction * local_dir.x + up_direction * local_dir.y + heading * local_dir.z;
+}
+
+void FlockSimulator::step(float dt)
+{
+    if(m_positions.empty()) {
+        return;
+    }
+    update_octree();
+    if(!m_double_buffered) {
+        // agents later in the list see the new state of agents earlier in it
+        for(long i = 0; i < static_cast<long>(m_positions.size()); i++) {
+            update_agent(i, dt, &m_positions[i], &m_headings[i], &m_up_directions[i]);
+        }
+    } else {
+        // every agent sees the state at the start of the step, so agents update in any order on any thread
+        int agent_count = m_positions.size();
+        m_next_positions.resize(agent_count);
+        m_next_headings.resize(agent_count);
+        m_next_up_directions.resize(agent_count);
+        ThreadPool::range_func_t update_range = [this, dt](int begin, int end) {
+            for(long i = begin; i < end; i++) {
+                update_agent(i, dt, &m_next_positions[i], &m_next_headings[i], &m_next_up_directions[i]);
+            }
+        };
+        if(m_thread_pool) {
+            m_thread_pool->parallel_for(agent_count, update_range);
+        } else {
+            update_range(0, agent_count);
+        }
+        m_positions.swap(m_next_positions);
+        m_headings.swap(m_next_headings);
+        m_up_directions.swap(m_next_up_directions);
+    }
+    for(std::vector<glm::vec3>::iterator p = m_positions.begin(); p != m_positions.end(); p++) {
+        *p = wrap(*p);
+    }
+}
+
+// agent i is object i in octree, so knn graph row i is agent i
+void FlockSimulator::update_octree()
+{
+    long index = 0;
+    for(std::vector<glm::vec3>::iterator p = m_positions.begin(); p != m_positions.end(); p++) {
+        if(m_octree->exists(index)) {
+            m_octree->move(index, *p);
+        } else {
+            m_octree->insert(index, *p);
+        }
+        index++;
+    }
+    m_octree->rebalance();
+
+    // neighbor lists for all agents at once (octree stays unchanged until next step)
+    if(m_use_find_hints) {
+        // one query per agent, each starting from where it ended up last step
+        m_octree->find_batch(m_positions,
+                             m_config.m_nearest_neighbor_count,
+                             m_config.m_nearest_neighbor_radius,
+                             &m_nearest_k_results,
+                             m_thread_pool,
+                             &m_find_hints);
+
+        // drop self wherever it landed (agents tied on distance may sort ahead of it), keeping nearest first order
+        for(long i = 0; i < static_cast<long>(m_nearest_k_results.m_counts.size()); i++) {
+            long* nearest_k_ids   = m_nearest_k_results.m_ids.data() + m_nearest_k_results.m_offsets[i];
+            int&  nearest_k_count = m_nearest_k_results.m_counts[i];
+            long* self_id         = std::find(nearest_k_ids, nearest_k_ids + nearest_k_count, i);
+            if(self_id != nearest_k_ids + nearest_k_count) {
+                std::copy(self_id + 1, nearest_k_ids + nearest_k_count, self_id);
+                nearest_k_count--;
+            }
+        }
+    } else {
+        m_octree->knn_graph(m_config.m_nearest_neighbor_count - 1, // not counting self
+                            m_config.m_nearest_neighbor_radius,
+                            &m_nearest_k_graph,
+                            m_thread_pool);
+    }
+}
+
+// reads state from current arrays, writes agent's next state to pos/heading/up_direction (may alias current)
+void FlockSimulator::update_agent(long       index,
+                                  float      dt,
+                                  glm::vec3* pos,
+                                  glm::vec3* heading,
+                                  glm::vec3* up_direction)
+{
+    glm::vec3 self_pos     = m_positions[index];
+    glm::vec3 self_heading = m_headings[index];
+    float     self_speed   = m_speeds[index] * dt;
+    *heading      = self_heading;
+    *up_direction = m_up_directions[index];
+
+    // LIDAR
+    float*    lidar_dists = &m_lidar_dists[index * FLOCK_LIDAR_COUNT];
+    glm::vec3 nearest_obstacles[FLOCK_LIDAR_COUNT];
+    for(int i = 0; i < FLOCK_LIDAR_COUNT; i++) {
+        glm::vec3 lidar_dir = get_lidar_dir(index, static_cast<flock_lidar_t>(i));
+        lidar_dists[i] = BIG_NUMBER;
+        RayHit hit;
+        if(m_obstacle_octree && m_obstacle_octree->raycast(self_pos, lidar_dir, BIG_NUMBER, &hit, m_obstacle_hit_func)) {
+            lidar_dists[i] = hit.m_dist;
+        }
+        nearest_obstacles[i] = self_pos + lidar_dir * lidar_dists[i];
+    }
+
+    // obstacle normal
+    glm::vec3 nearest_obstacle_normal = glm::normalize(glm::cross(nearest_obstacles[FLOCK_LIDAR_RIGHT] - nearest_obstacles[FLOCK_LIDAR_UP],
+                                                                  nearest_obstacles[FLOCK_LIDAR_LEFT]  - nearest_obstacles[FLOCK_LIDAR_UP]));
+
+    flock_behavior_t behavior = FLOCK_BEHAVIOR_CRUISE;
+    if(glm::distance(self_pos, nearest_obstacles[FLOCK_LIDAR_AHEAD]) < m_config.m_obstacle_reverse_radius) {
+        // avoid head-on collision with obstacle
+        // rotate 180 degrees maintaining up direction
+        *pos     = self_pos;
+        *heading = -self_heading;
+        m_behaviors[index] = FLOCK_BEHAVIOR_REVERSE;
+        return;
+    } else if(glm::distance(self_pos, nearest_obstacles[FLOCK_LIDAR_UP])    < m_config.m_obstacle_avoid_radius ||
+              glm::distance(self_pos, nearest_obstacles[FLOCK_LIDAR_LEFT])  < m_config.m_obstacle_avoid_radius ||
+              glm::distance(self_pos, nearest_obstacles[FLOCK_LIDAR_RIGHT]) < m_config.m_obstacle_avoid_radius)
+    {
+        // avoid glancing collision with obstacle
+        // explore deepest LIDAR reading direction
+        turn_toward(self_pos,
+                    nearest_obstacles[FLOCK_LIDAR_AHEAD] + nearest_obstacle_normal,
+                    m_config.m_angle_delta * dt,
+                    m_config.m_avoid_radius,
+                    heading,
+                    up_direction);
+        behavior = FLOCK_BEHAVIOR_OBSTACLE_AVOID;
+    } else {
+        // flocking behavior
+        const long* nearest_k_ids   = NULL;
+        int         nearest_k_count = get_neighbors(index, &nearest_k_ids);
+        if(nearest_k_count) {
+            float max_heading_deviation_cos = cosf(glm::radians(m_config.m_max_heading_deviation));
+            float max_fov_deviation_cos     = cosf(glm::radians(m_config.m_max_fov_deviation));
+            glm::vec3 group_centroid(0);
+            glm::vec3 average_heading(0);
+            size_t valid_neighbor_count = 0;
+            for(const long* q = nearest_k_ids; q != nearest_k_ids + nearest_k_count; q++) {
+                if(*q == index) { // ignore self (tied with a coincident agent)
+                    continue;
+                }
+                glm::vec3 other_pos     = m_positions[*q];
+                glm::vec3 other_heading = m_headings[*q];
+
+                // collect stats
+                if(within_flocking_view(self_pos, self_heading, other_pos, other_heading, max_heading_deviation_cos, max_fov_deviation_cos)) {
+                    group_centroid  += other_pos;
+                    average_heading += other_heading;
+                    valid_neighbor_count++;
+                }
+            }
+            glm::vec3 nearest_other_pos = m_positions[nearest_k_ids[0]];
+
+            if(glm::distance(self_pos, nearest_other_pos) < m_config.m_avoid_radius) {
+                turn_toward(self_pos,
+                            nearest_other_pos,
+                            m_config.m_avoid_angle_delta * dt,
+                            m_config.m_avoid_radius,
+                            heading,
+                            up_direction); // separation
+                behavior = FLOCK_BEHAVIOR_SEPARATION;
+            } else if(valid_neighbor_count) {
+                float contrib_factor = 1.0f / valid_neighbor_count;
+                group_centroid *= contrib_factor;
+                average_heading = self_pos + average_heading * contrib_factor;
+                glm::vec3 weighted_average_target = LERP(group_centroid, average_heading, m_config.m_cohesion_to_alignment_ratio);
+                turn_toward(self_pos,
+                            weighted_average_target,
+                            m_config.m_angle_delta * dt,
+                            0,
+                            heading,
+                            up_direction); // cohesion & alignment
+                behavior = FLOCK_BEHAVIOR_FLOCKING;
+            }
+        }
+        if(behavior == FLOCK_BEHAVIOR_CRUISE && glm::distance(self_pos, m_target) < m_config.m_flocking_radius) {
+            turn_toward(self_pos,
+                        m_target,
+                        m_config.m_angle_delta * dt,
+                        m_config.m_avoid_radius,
+                        heading,
+                        up_direction); // target homing
+            behavior = FLOCK_BEHAVIOR_HOMING;
+        }
+    }
+    *pos = self_pos + *heading * self_speed;
+    m_behaviors[index] = behavior;
+}
+
+// same LIDAR fan as main_boids: one ray ahead, three lidar_fov off it at 90/210/330 degrees around the heading
+void FlockSimulator::update_lidar_local_dirs()
+{
+    float lateral_offset = tanf(glm::radians(m_config.m_lidar_fov));
+    m_lidar_local_dirs[FLOCK_LIDAR_AHEAD] = glm::vec3(0, 0, 1);
+    m_lidar_local_dirs[FLOCK_LIDAR_UP]    = glm::normalize(glm::vec3(0,
+                                                                     lateral_offset,
+                                                                     1));
+    m_lidar_local_dirs[FLOCK_LIDAR_LEFT]  = glm::normalize(glm::vec3(lateral_offset * cosf(glm::radians(210.0f)),
+                                                                     lateral_offset * sinf(glm::radians(210.0f)),
+                                                                     1));
+    m_lidar_local_dirs[FLOCK_LIDAR_RIGHT] = glm::normalize(glm::vec3(lateral_offset * cosf(glm::radians(330.0f)),
+                                                                     lateral_offset * sinf(glm::radians(330.0f)),
+                                                                     1));
+}
+
+// TransformObject::update_boid on a bare heading/up frame: rotate by angle_delta toward target, or away if within avoid_radius
+void FlockSimulator::turn_toward(glm::vec3  pos,
+                                 glm::vec3  target,
+                                 float      angle_delta,
+                                 float      avoid_radius,
+                                 glm::vec3* heading,
+                                 glm::vec3* up_direction) const
+{
+    glm::vec3 target_dir = target - pos;
+    float     target_dist = glm::length(target_dir);
+    if(target_dist < EPSILON) {
+        return; // coincident, no direction to turn toward or away from
+    }
+    int       avoid_or_seek = (target_dist < avoid_radius) ? -1 : 1;
+    glm::vec3 pivot_dir = glm::cross(*heading, target_dir);
+    float     pivot_dir_length = glm::length(pivot_dir);
+    if(pivot_dir_length <= EPSILON * target_dist) {
+        if(avoid_or_seek > 0 && glm::dot(*heading, target_dir) >= 0) {
+            return; // already on target
+        }
+        pivot_dir = *up_direction; // dead ahead or behind, any perpendicular axis will do
+    } else {
+        pivot_dir /= pivot_dir_length;
+    }
+    float angle = glm::radians(angle_delta * avoid_or_seek);
+    *heading      = glm::normalize(rotate_about_axis(*heading, pivot_dir, angle));
+    *up_direction = glm::normalize(rotate_about_axis(*up_direction, pivot_dir, angle));
+    *up_direction = glm::normalize(*up_direction - *heading * glm::dot(*up_direction, *heading)); // keep frame orthonormal
+}
+
+// angle below deviation <=> cosine above cosine of deviation
+bool FlockSimulator::within_flocking_view(glm::vec3 self_pos,
+                                          glm::vec3 self_heading,
+                                          glm::vec3 other_pos,
+                                          glm::vec3 other_heading,
+                                          float     max_heading_deviation_cos,
+                                          float     max_fov_deviation_cos)
+{
+    return glm::dot(self_heading, other_heading)                            > max_heading_deviation_cos &&
+           glm::dot(self_heading, glm::normalize(other_pos - self_pos)) > max_fov_deviation_cos;
+}
+
+glm::vec3 FlockSimulator::wrap(glm::vec3 pos) const
+{
+    glm::vec3 _pos = pos;
+    if(_pos.x < m_min.x) { _pos.x = m_max.x; }
+    if(_pos.y < m_min.y) { _pos.y = m_max.y; }
+    if(_pos.z < m_min.z) { _pos.z = m_max.z; }
+    if(_pos.x > m_max.x) { _pos.x = m_min.x; }
+    if(_pos.y > m_max.y) { _pos.y = m_min.y; }
+    if(_pos.z > m_max.z) { _pos.z = m_min.z; }
+    return _pos;
+}
+
+}
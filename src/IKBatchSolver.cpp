@@ -0,0 +1,81 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <IKBatchSolver.h>
+#include <IKChain.h>
+#include <ThreadPool.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vt {
+
+IKBatchSolver::IKBatchSolver(ThreadPool* thread_pool)
+    : m_thread_pool(thread_pool)
+{
+}
+
+void IKBatchSolver::clear()
+{
+    m_jobs.clear();
+}
+
+void IKBatchSolver::add(IKChain* ik_chain, glm::vec3 target, const glm::vec3* end_effector_dir)
+{
+    Job job;
+    job.m_ik_chain             = ik_chain;
+    job.m_target               = target;
+    job.m_end_effector_dir     = end_effector_dir ? *end_effector_dir : glm::vec3(0);
+    job.m_use_end_effector_dir = (end_effector_dir != NULL);
+    job.m_result               = false;
+    m_jobs.push_back(job);
+}
+
+int IKBatchSolver::solve(int   iters,
+                         float accept_end_effector_distance,
+                         float accept_avg_angle_distance)
+{
+    // reading the hierarchy updates its caches, so not in parallel
+    for(std::vector<Job>::iterator p = m_jobs.begin(); p != m_jobs.end(); p++) {
+        (*p).m_ik_chain->load();
+    }
+    // chains only touch their own arrays while solving
+    ThreadPool::range_func_t solve_range = [this, iters, accept_end_effector_distance, accept_avg_angle_distance](int begin, int end) {
+        for(int i = begin; i < end; i++) {
+            Job &job = m_jobs[i];
+            job.m_result = job.m_ik_chain->solve(job.m_target,
+                                                 job.m_use_end_effector_dir ? &job.m_end_effector_dir : NULL,
+                                                 iters,
+                                                 accept_end_effector_distance,
+                                                 accept_avg_angle_distance);
+        }
+    };
+    if(m_thread_pool) {
+        m_thread_pool->parallel_for(m_jobs.size(), solve_range, 1);
+    } else {
+        solve_range(0, m_jobs.size());
+    }
+    int solution_count = 0;
+    for(std::vector<Job>::iterator p = m_jobs.begin(); p != m_jobs.end(); p++) {
+        (*p).m_ik_chain->commit();
+        if((*p).m_result) {
+            solution_count++;
+        }
+    }
+    return solution_count;
+}
+
+}
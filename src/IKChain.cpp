@@ -0,0 +1,1002 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <IKChain.h>
+#include <TransformObject.h>
+#include <Util.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/vector_angle.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#define DLS_MAX_STEP               0.2  // largest end effector move per iteration, as a fraction of chain length
+#define ANALYTIC_COXA_SAMPLE_COUNT 17   // coxa headings solve_analytic tries across its limits, besides current one
+#define ANALYTIC_LIMIT_TOLERANCE   0.01 // degrees
+#define ANALYTIC_REACH_TOLERANCE   1e-4 // as a fraction of reach
+
+namespace vt {
+
+// same as TransformObject::get_abs_direction, but from the inverse of the absolute transform
+static glm::vec3 abs_direction(const glm::mat4& abs_inverse_transform, euler_index_t euler_index)
+{
+    return glm::vec3(glm::transpose(abs_inverse_transform) * glm::vec4(euler_index_to_axis(euler_index), 1));
+}
+
+// point at distance from anchor, in the direction of point
+static glm::vec3 place_at_distance(glm::vec3 anchor, glm::vec3 point, float distance)
+{
+    glm::vec3 offset = point - anchor;
+    float     length = glm::length(offset);
+    if(length < EPSILON) {
+        return point;
+    }
+    return anchor + offset * (distance / length);
+}
+
+// solves a * x = b for symmetric positive definite a (size by size, row major), leaving x in b
+// NOTE: a is overwritten by its Cholesky factor
+static bool solve_cholesky(float* a, float* b, int size)
+{
+    for(int j = 0; j < size; j++) {
+        float sum = a[j * size + j];
+        for(int k = 0; k < j; k++) {
+            sum -= a[j * size + k] * a[j * size + k];
+        }
+        if(sum <= 0) {
+            return false;
+        }
+        a[j * size + j] = sqrt(sum);
+        for(int i = j + 1; i < size; i++) {
+            float sum2 = a[i * size + j];
+            for(int k = 0; k < j; k++) {
+                sum2 -= a[i * size + k] * a[j * size + k];
+            }
+            a[i * size + j] = sum2 / a[j * size + j];
+        }
+    }
+    for(int i = 0; i < size; i++) {
+        for(int k = 0; k < i; k++) {
+            b[i] -= a[i * size + k] * b[k];
+        }
+        b[i] /= a[i * size + i];
+    }
+    for(int i = size - 1; i >= 0; i--) {
+        for(int k = i + 1; k < size; k++) {
+            b[i] -= a[k * size + i] * b[k];
+        }
+        b[i] /= a[i * size + i];
+    }
+    return true;
+}
+
+// right-handed angle (degrees) about axis that turns from toward to, both as seen along axis
+static float angle_about_axis(glm::vec3 axis, glm::vec3 from, glm::vec3 to)
+{
+    from -= axis * glm::dot(from, axis);
+    to   -= axis * glm::dot(to,   axis);
+    return glm::degrees(atan2(glm::dot(glm::cross(from, to), axis), glm::dot(from, to)));
+}
+
+// pitch hinge of a leg seen in its plane, angles in degrees about plane normal
+struct PlanarHinge
+{
+    float m_heading;       // from heading of first hinge's parent
+    float m_link_angle;    // of link to next hinge (or end effector tip), from heading
+    float m_link_length;
+    float m_center;        // limits on heading relative to parent hinge
+    float m_max_deviation;
+};
+
+static glm::vec2 planar_dir(float angle)
+{
+    return glm::vec2(cos(glm::radians(angle)), sin(glm::radians(angle)));
+}
+
+static bool within_limits(const PlanarHinge& hinge, float relative_heading)
+{
+    return angle_distance(relative_heading, hinge.m_center) <= hinge.m_max_deviation + ANALYTIC_LIMIT_TOLERANCE;
+}
+
+// law of cosines: headings of 2 hinges that put the end of the second link on target from origin, elbow bent one
+// way (bend 1) or the other (bend -1), false if out of reach or limits
+static bool solve_planar_two_links(const PlanarHinge* hinges,
+                                   float              parent_heading,
+                                   glm::vec2          origin,
+                                   glm::vec2          target,
+                                   float              bend,
+                                   float*             headings)
+{
+    const PlanarHinge &upper = hinges[0];
+    const PlanarHinge &lower = hinges[1];
+    glm::vec2 reach        = target - origin;
+    float     reach_length = glm::length(reach);
+    if(reach_length < EPSILON ||
+       reach_length > (upper.m_link_length + lower.m_link_length) * (1 + ANALYTIC_REACH_TOLERANCE) ||
+       reach_length < fabs(upper.m_link_length - lower.m_link_length) * (1 - ANALYTIC_REACH_TOLERANCE))
+    {
+        return false;
+    }
+    float cos_upper = (upper.m_link_length * upper.m_link_length + reach_length * reach_length - lower.m_link_length * lower.m_link_length) /
+                      (2 * upper.m_link_length * reach_length);
+    float upper_link_angle = glm::degrees(atan2(reach.y, reach.x)) + bend * glm::degrees(acos(std::max(std::min(cos_upper, 1.0f), -1.0f)));
+    glm::vec2 lower_reach = target - (origin + planar_dir(upper_link_angle) * upper.m_link_length);
+    headings[0] = upper_link_angle - upper.m_link_angle;
+    headings[1] = glm::degrees(atan2(lower_reach.y, lower_reach.x)) - lower.m_link_angle;
+    return within_limits(upper, headings[0] - parent_heading) && within_limits(lower, headings[1] - headings[0]);
+}
+
+// headings of 2 or 3 planar hinges that put the end of the last link on target from first hinge, within limits and
+// with least joint motion; a leading hinge of 3 (coxa) is tried at its current heading and at samples across its limits
+static bool solve_planar_leg(const PlanarHinge* hinges, int hinge_count, glm::vec2 target, float* headings)
+{
+    bool  find_solution = false;
+    float min_motion    = 0;
+    int   coxa_count    = (hinge_count == 3) ? ANALYTIC_COXA_SAMPLE_COUNT + 1 : 1;
+    int   upper_index   = hinge_count - 2;
+    for(int i = 0; i < coxa_count; i++) {
+        float     new_headings[3];
+        glm::vec2 origin = glm::vec2(0);
+        if(hinge_count == 3) {
+            const PlanarHinge &coxa = hinges[0];
+            new_headings[0] = i ? coxa.m_center + coxa.m_max_deviation * (2.0f * (i - 1) / (ANALYTIC_COXA_SAMPLE_COUNT - 1) - 1) : coxa.m_heading;
+            if(!within_limits(coxa, new_headings[0])) {
+                continue;
+            }
+            origin = planar_dir(new_headings[0] + coxa.m_link_angle) * coxa.m_link_length;
+        }
+        for(int j = 0; j < 2; j++) {
+            if(!solve_planar_two_links(&hinges[upper_index], upper_index ? new_headings[0] : 0, origin, target, j ? -1 : 1, &new_headings[upper_index])) {
+                continue;
+            }
+            float motion = 0;
+            for(int k = 0; k < hinge_count; k++) {
+                float parent_heading     = k ? hinges[k - 1].m_heading : 0;
+                float new_parent_heading = k ? new_headings[k - 1]     : 0;
+                motion += angle_distance(new_headings[k] - new_parent_heading, hinges[k].m_heading - parent_heading);
+            }
+            if(!find_solution || motion < min_motion) {
+                std::copy(new_headings, new_headings + hinge_count, headings);
+                find_solution = true;
+                min_motion    = motion;
+            }
+        }
+    }
+    return find_solution;
+}
+
+IKChain::IKChain(TransformObject* root,
+                 TransformObject* end_effector,
+                 glm::vec3        local_end_effector_tip)
+    : m_local_end_effector_tip(local_end_effector_tip),
+      m_base_transform(glm::mat4(1)),
+      m_solver(SOLVER_CCD),
+      m_dls_damping(0.05),
+      m_enable_analytic(true)
+{
+    for(TransformObject* current_segment = end_effector; current_segment && current_segment != root->get_parent(); current_segment = current_segment->get_parent()) {
+        m_segments.push_back(current_segment);
+    }
+    std::reverse(m_segments.begin(), m_segments.end());
+    for(std::vector<TransformObject*>::iterator p = m_segments.begin(); p != m_segments.end(); p++) {
+        m_joint_types.push_back(                     (*p)->get_joint_type());
+        m_hinge_types.push_back(                     (*p)->get_hinge_type());
+        m_enable_joint_constraints.push_back(        (*p)->get_enable_joint_constraints());
+        m_joint_constraints_centers.push_back(       (*p)->get_joint_constraints_center());
+        m_joint_constraints_max_deviations.push_back((*p)->get_joint_constraints_max_deviation());
+    }
+    m_origins.resize(       m_segments.size());
+    m_eulers.resize(        m_segments.size());
+    m_scales.resize(        m_segments.size());
+    m_abs_transforms.resize(m_segments.size());
+    m_joint_positions.resize(m_segments.size() + 1);
+    m_goal_positions.resize( m_segments.size() + 1);
+    m_link_lengths.resize(   m_segments.size());
+    load();
+    detect_analytic_leg();
+}
+
+glm::vec3 IKChain::get_end_effector_tip() const
+{
+    if(m_segments.empty()) {
+        return glm::vec3(0);
+    }
+    return glm::vec3(m_abs_transforms.back() * glm::vec4(m_local_end_effector_tip, 1));
+}
+
+void IKChain::load()
+{
+    if(m_segments.empty()) {
+        return;
+    }
+    TransformObject* root_parent = m_segments.front()->get_parent();
+    m_base_transform = root_parent ? root_parent->get_transform(false) : glm::mat4(1); // no trace down, siblings of root aren't our concern
+    for(size_t i = 0; i < m_segments.size(); i++) {
+        m_origins[i] = m_segments[i]->get_origin();
+        m_eulers[i]  = m_segments[i]->get_euler();
+        m_scales[i]  = m_segments[i]->get_scale();
+    }
+    update_abs_transforms();
+}
+
+bool IKChain::solve(glm::vec3  target,
+                    glm::vec3* end_effector_dir,
+                    int        iters,
+                    float      accept_end_effector_distance,
+                    float      accept_avg_angle_distance)
+{
+    if(m_enable_analytic && is_analytic() && !end_effector_dir && solve_analytic(target, accept_end_effector_distance)) {
+        return true;
+    }
+    switch(m_solver) {
+        case SOLVER_FABRIK:
+            return solve_fabrik(target, end_effector_dir, iters, accept_end_effector_distance, accept_avg_angle_distance);
+        case SOLVER_DLS:
+            return solve_dls(target, end_effector_dir, iters, accept_end_effector_distance, accept_avg_angle_distance);
+        default:
+            break;
+    }
+    return solve_ccd(target, end_effector_dir, iters, accept_end_effector_distance, accept_avg_angle_distance);
+}
+
+// http://what-when-how.com/advanced-methods-in-computer-graphics/kinematics-advanced-methods-in-computer-graphics-part-4/
+bool IKChain::solve_ccd(glm::vec3  target,
+                        glm::vec3* end_effector_dir,
+                        int        iters,
+                        float      accept_end_effector_distance,
+                        float      accept_avg_angle_distance)
+{
+    if(m_segments.empty()) {
+        return false;
+    }
+    int end_effector_index = static_cast<int>(m_segments.size()) - 1;
+    bool converge = false;
+    bool find_solution = false;
+    for(int i = 0; i < iters && !converge; i++) {
+        update_abs_transforms();
+        glm::vec3 abs_end_effector_tip = get_end_effector_tip();
+        int segment_count = 0;
+        float sum_angle = 0;
+        for(int j = end_effector_index; j >= 0; j--) {
+            const glm::mat4 &parent_transform         = j ? m_abs_transforms[j - 1] : m_base_transform;
+            glm::mat4        parent_inverse_transform = glm::inverse(parent_transform);
+            // end effector tip in current segment's system, carried along by whatever happens to current segment
+            glm::mat4        abs_inverse_transform    = get_local_inverse_transform(j) * parent_inverse_transform;
+            glm::vec3 segment_end_effector_tip = glm::vec3(abs_inverse_transform * glm::vec4(abs_end_effector_tip, 1));
+            glm::vec3 end_effector_tip = abs_end_effector_tip;
+            find_solution = (glm::distance(end_effector_tip, target) < accept_end_effector_distance);
+            glm::vec3 _target;
+            if(end_effector_dir && j == end_effector_index) {
+                _target = glm::vec3(m_abs_transforms[j][3]) + *end_effector_dir;
+            } else {
+                _target = target;
+            }
+            if(m_joint_types[j] == TransformObject::JOINT_TYPE_PRISMATIC) {
+                m_origins[j] += glm::vec3(parent_inverse_transform * glm::vec4(_target, 1)) -
+                                glm::vec3(parent_inverse_transform * glm::vec4(end_effector_tip, 1));
+                apply_joint_constraints(j, parent_transform, parent_inverse_transform);
+            } else {
+                if(m_hinge_types[end_effector_index] != EULER_INDEX_UNDEF && m_hinge_types[j] != EULER_INDEX_UNDEF) {
+                    // project to plane of free rotation
+                    glm::vec3 plane_origin = glm::vec3(m_abs_transforms[j][3]);
+                    glm::vec3 plane_normal = abs_direction(abs_inverse_transform, m_hinge_types[j]);
+                    _target          = nearest_point_on_plane(plane_origin, plane_normal, _target);
+                    end_effector_tip = nearest_point_on_plane(plane_origin, plane_normal, end_effector_tip);
+                }
+                sum_angle += arcball(j, parent_transform, parent_inverse_transform, _target, end_effector_tip);
+                segment_count++;
+            }
+            m_abs_transforms[j]  = parent_transform * get_local_transform(j);
+            abs_end_effector_tip = glm::vec3(m_abs_transforms[j] * glm::vec4(segment_end_effector_tip, 1));
+        }
+        if(!segment_count) {
+            continue;
+        }
+        float average_angle = sum_angle / segment_count;
+        if(average_angle < accept_avg_angle_distance) {
+            converge = true;
+        }
+    }
+    update_abs_transforms();
+    return converge && find_solution;
+}
+
+// http://andreasaristidou.com/FABRIK.html
+bool IKChain::solve_fabrik(glm::vec3  target,
+                           glm::vec3* end_effector_dir,
+                           int        iters,
+                           float      accept_end_effector_distance,
+                           float      accept_avg_angle_distance)
+{
+    if(m_segments.empty()) {
+        return false;
+    }
+    int end_effector_index = static_cast<int>(m_segments.size()) - 1;
+    std::vector<glm::vec3> &joint_positions = m_joint_positions;
+    std::vector<glm::vec3> &goal_positions  = m_goal_positions;
+    bool converge = false;
+    bool find_solution = false;
+    for(int i = 0; i < iters && !converge; i++) {
+        update_abs_transforms();
+        for(int j = 0; j <= end_effector_index; j++) {
+            joint_positions[j] = glm::vec3(m_abs_transforms[j][3]);
+        }
+        joint_positions.back() = get_end_effector_tip();
+        for(int j = 0; j <= end_effector_index; j++) {
+            m_link_lengths[j] = glm::distance(joint_positions[j], joint_positions[j + 1]);
+        }
+        find_solution = (glm::distance(joint_positions.back(), target) < accept_end_effector_distance);
+        // backward, from target to root (links into prismatic joints stretch instead of pulling)
+        goal_positions = joint_positions;
+        goal_positions.back() = target;
+        for(int j = end_effector_index; j >= 0; j--) {
+            if(end_effector_dir && j == end_effector_index) {
+                goal_positions[j] = target - glm::normalize(*end_effector_dir) * m_link_lengths[j];
+            } else if(j == end_effector_index || m_joint_types[j + 1] != TransformObject::JOINT_TYPE_PRISMATIC) {
+                goal_positions[j] = place_at_distance(goal_positions[j + 1], goal_positions[j], m_link_lengths[j]);
+            }
+        }
+        // forward, from root to target
+        if(m_joint_types.front() != TransformObject::JOINT_TYPE_PRISMATIC) {
+            goal_positions.front() = joint_positions.front();
+        }
+        for(int j = 0; j <= end_effector_index; j++) {
+            if(j == end_effector_index || m_joint_types[j + 1] != TransformObject::JOINT_TYPE_PRISMATIC) {
+                goal_positions[j + 1] = place_at_distance(goal_positions[j], goal_positions[j + 1], m_link_lengths[j]);
+            }
+        }
+        // turn (or slide) joints to match, root first, so each sees where its parent really ended up
+        int segment_count = 0;
+        float sum_angle = 0;
+        for(int j = 0; j <= end_effector_index; j++) {
+            const glm::mat4 &parent_transform         = j ? m_abs_transforms[j - 1] : m_base_transform;
+            glm::mat4        parent_inverse_transform = glm::inverse(parent_transform);
+            if(m_joint_types[j] == TransformObject::JOINT_TYPE_PRISMATIC) {
+                m_origins[j] = glm::vec3(parent_inverse_transform * glm::vec4(goal_positions[j], 1));
+                apply_joint_constraints(j, parent_transform, parent_inverse_transform);
+                m_abs_transforms[j] = parent_transform * get_local_transform(j);
+                continue;
+            }
+            // carries points below this joint from where they were to where joints above have since moved them
+            glm::mat4 abs_transform        = parent_transform * get_local_transform(j);
+            glm::mat4 correction_transform = abs_transform * glm::inverse(m_abs_transforms[j]);
+            glm::vec3 abs_origin           = glm::vec3(abs_transform[3]);
+            m_abs_transforms[j] = abs_transform;
+            euler_index_t single_axis = get_single_axis(j); // hinge, or free joint constrained to one axis
+            glm::vec3 abs_reference_point;
+            glm::vec3 abs_target;
+            if(end_effector_dir && j == end_effector_index) {
+                abs_reference_point = glm::vec3(correction_transform * glm::vec4(joint_positions.back(), 1));
+                abs_target          = abs_origin + *end_effector_dir;
+            } else if(single_axis != EULER_INDEX_UNDEF) {
+                // turn about hinge axis by the angle that best matches every point below to its goal (least squares),
+                // since a single point may sit on the axis or off the plane the rest of the chain wants
+                glm::vec3 abs_axis      = glm::normalize(abs_direction(get_local_inverse_transform(j) * parent_inverse_transform, single_axis));
+                glm::vec3 reference_dir = glm::vec3(0);
+                float     sum_sin       = 0;
+                float     sum_cos       = 0;
+                for(int k = j + 1; k <= end_effector_index + 1; k++) {
+                    glm::vec3 point_dir = glm::vec3(correction_transform * glm::vec4(joint_positions[k], 1)) - abs_origin;
+                    glm::vec3 goal_dir  = goal_positions[k] - abs_origin;
+                    point_dir -= abs_axis * glm::dot(point_dir, abs_axis);
+                    goal_dir  -= abs_axis * glm::dot(goal_dir,  abs_axis);
+                    sum_sin += glm::dot(glm::cross(point_dir, goal_dir), abs_axis);
+                    sum_cos += glm::dot(point_dir, goal_dir);
+                    if(glm::length(point_dir) > glm::length(reference_dir)) {
+                        reference_dir = point_dir;
+                    }
+                }
+                if(glm::length(reference_dir) < EPSILON) {
+                    continue;
+                }
+                float angle_delta = glm::degrees(atan2(sum_sin, sum_cos));
+                abs_reference_point = abs_origin + reference_dir;
+                abs_target          = abs_origin + glm::vec3(GLM_ROTATION_TRANSFORM(glm::mat4(1), angle_delta, abs_axis) * glm::vec4(reference_dir, 0));
+            } else {
+                // swing the first point below that neither slides nor sits on this joint
+                int k = j + 1;
+                while(k <= end_effector_index &&
+                      (m_joint_types[k] == TransformObject::JOINT_TYPE_PRISMATIC || glm::distance(joint_positions[k], joint_positions[j]) < EPSILON))
+                {
+                    k++;
+                }
+                abs_reference_point = glm::vec3(correction_transform * glm::vec4(joint_positions[k], 1));
+                abs_target          = goal_positions[k];
+            }
+            if(single_axis != EULER_INDEX_UNDEF) {
+                // project to plane of free rotation
+                glm::vec3 plane_normal = abs_direction(get_local_inverse_transform(j) * parent_inverse_transform, single_axis);
+                abs_target          = nearest_point_on_plane(abs_origin, plane_normal, abs_target);
+                abs_reference_point = nearest_point_on_plane(abs_origin, plane_normal, abs_reference_point);
+            }
+            sum_angle += arcball(j, parent_transform, parent_inverse_transform, abs_target, abs_reference_point);
+            segment_count++;
+            m_abs_transforms[j] = parent_transform * get_local_transform(j);
+        }
+        if(!segment_count) {
+            continue;
+        }
+        float average_angle = sum_angle / segment_count;
+        if(average_angle < accept_avg_angle_distance) {
+            converge = true;
+        }
+    }
+    update_abs_transforms();
+    return converge && find_solution;
+}
+
+// http://www.math.ucsd.edu/~sbuss/ResearchWeb/ikmethods/iksurvey.pdf
+bool IKChain::solve_dls(glm::vec3  target,
+                        glm::vec3* end_effector_dir,
+                        int        iters,
+                        float      accept_end_effector_distance,
+                        float      accept_avg_angle_distance)
+{
+    if(m_segments.empty()) {
+        return false;
+    }
+    int end_effector_index = static_cast<int>(m_segments.size()) - 1;
+    int row_count = end_effector_dir ? 6 : 3; // end effector position, then heading
+    bool converge = false;
+    bool find_solution = false;
+    for(int i = 0; i < iters && !converge; i++) {
+        update_abs_transforms();
+        glm::vec3 abs_end_effector_tip    = get_end_effector_tip();
+        glm::vec3 abs_end_effector_origin = glm::vec3(m_abs_transforms.back()[3]);
+        find_solution = (glm::distance(abs_end_effector_tip, target) < accept_end_effector_distance);
+        // step size, damping and heading error scale with chain length, so results don't depend on units
+        float chain_length = glm::distance(abs_end_effector_origin, abs_end_effector_tip);
+        for(int j = 0; j < end_effector_index; j++) {
+            chain_length += glm::distance(glm::vec3(m_abs_transforms[j][3]), glm::vec3(m_abs_transforms[j + 1][3]));
+        }
+        if(chain_length < EPSILON) {
+            break;
+        }
+        float max_step = chain_length * DLS_MAX_STEP;
+        glm::vec3 position_error = target - abs_end_effector_tip;
+        if(glm::length(position_error) > max_step) {
+            position_error = glm::normalize(position_error) * max_step;
+        }
+        glm::vec3 heading_error = glm::vec3(0);
+        if(end_effector_dir) {
+            glm::vec3 abs_heading = glm::normalize(abs_end_effector_tip - abs_end_effector_origin);
+            glm::vec3 pivot       = glm::cross(abs_heading, *end_effector_dir);
+            if(glm::length(pivot) > EPSILON) {
+                heading_error = glm::normalize(pivot) * std::min(glm::angle(abs_heading, glm::normalize(*end_effector_dir)) * chain_length, max_step);
+            }
+        }
+        // one column per joint axis, locked prismatic axes left out
+        m_jacobian_columns.clear();
+        for(int j = 0; j <= end_effector_index; j++) {
+            const glm::mat4 &parent_transform = j ? m_abs_transforms[j - 1] : m_base_transform;
+            JacobianColumn column;
+            column.m_segment_index = j;
+            if(m_joint_types[j] == TransformObject::JOINT_TYPE_PRISMATIC) {
+                for(int k = 0; k < 3; k++) {
+                    if(m_enable_joint_constraints[j][k] && m_joint_constraints_max_deviations[j][k] == 0) {
+                        continue;
+                    }
+                    column.m_local_axis     = glm::vec3(0);
+                    column.m_local_axis[k]  = 1;
+                    column.m_position_delta = glm::vec3(parent_transform * glm::vec4(column.m_local_axis, 0));
+                    column.m_heading_delta  = glm::vec3(0);
+                    m_jacobian_columns.push_back(column);
+                }
+                continue;
+            }
+            glm::vec3 abs_origin = glm::vec3(m_abs_transforms[j][3]);
+            if(m_hinge_types[j] != EULER_INDEX_UNDEF) {
+                glm::mat4 parent_inverse_transform = glm::inverse(parent_transform);
+                glm::vec3 abs_axis = glm::normalize(abs_direction(get_local_inverse_transform(j) * parent_inverse_transform, m_hinge_types[j]));
+                column.m_local_axis     = glm::normalize(glm::vec3(parent_inverse_transform * glm::vec4(abs_axis, 0)));
+                column.m_position_delta = glm::cross(abs_axis, abs_end_effector_tip - abs_origin);
+                column.m_heading_delta  = abs_axis * chain_length;
+                m_jacobian_columns.push_back(column);
+                continue;
+            }
+            for(int k = 0; k < 3; k++) {
+                column.m_local_axis     = glm::vec3(0);
+                column.m_local_axis[k]  = 1;
+                glm::vec3 abs_axis      = glm::normalize(glm::vec3(parent_transform * glm::vec4(column.m_local_axis, 0)));
+                column.m_position_delta = glm::cross(abs_axis, abs_end_effector_tip - abs_origin);
+                column.m_heading_delta  = abs_axis * chain_length;
+                m_jacobian_columns.push_back(column);
+            }
+        }
+        // (J * J^T + damping^2 * I) * y = error, then joint deltas = J^T * y
+        float a[36] = {0};
+        float y[6]  = {position_error.x, position_error.y, position_error.z,
+                       heading_error.x,  heading_error.y,  heading_error.z};
+        for(std::vector<JacobianColumn>::iterator p = m_jacobian_columns.begin(); p != m_jacobian_columns.end(); p++) {
+            float column[6] = {(*p).m_position_delta.x, (*p).m_position_delta.y, (*p).m_position_delta.z,
+                               (*p).m_heading_delta.x,  (*p).m_heading_delta.y,  (*p).m_heading_delta.z};
+            for(int r = 0; r < row_count; r++) {
+                for(int c = 0; c <= r; c++) {
+                    a[r * row_count + c] += column[r] * column[c];
+                }
+            }
+        }
+        float damping = m_dls_damping * chain_length;
+        for(int r = 0; r < row_count; r++) {
+            a[r * row_count + r] += damping * damping;
+            for(int c = r + 1; c < row_count; c++) {
+                a[r * row_count + c] = a[c * row_count + r];
+            }
+        }
+        if(!solve_cholesky(a, y, row_count)) {
+            break;
+        }
+        glm::vec3 position_weight = glm::vec3(y[0], y[1], y[2]);
+        glm::vec3 heading_weight  = (row_count == 6) ? glm::vec3(y[3], y[4], y[5]) : glm::vec3(0);
+        // apply, root first, so constraints see where parents really ended up
+        int segment_count = 0;
+        float sum_angle = 0;
+        std::vector<JacobianColumn>::iterator p = m_jacobian_columns.begin();
+        for(int j = 0; j <= end_effector_index; j++) {
+            glm::vec3 local_delta = glm::vec3(0);
+            for(; p != m_jacobian_columns.end() && (*p).m_segment_index == static_cast<size_t>(j); p++) {
+                local_delta += (*p).m_local_axis * (glm::dot((*p).m_position_delta, position_weight) +
+                                                    glm::dot((*p).m_heading_delta,  heading_weight));
+            }
+            const glm::mat4 &parent_transform         = j ? m_abs_transforms[j - 1] : m_base_transform;
+            glm::mat4        parent_inverse_transform = glm::inverse(parent_transform);
+            if(m_joint_types[j] == TransformObject::JOINT_TYPE_PRISMATIC) {
+                m_origins[j] += local_delta;
+                apply_joint_constraints(j, parent_transform, parent_inverse_transform);
+            } else {
+                float angle_delta = glm::degrees(glm::length(local_delta));
+                if(angle_delta > 0) {
+                    glm::mat4 local_rotation_transform = GLM_ROTATION_TRANSFORM(glm::mat4(1), angle_delta, glm::normalize(local_delta)) * get_local_rotation_transform(j);
+                    glm::vec3 local_heading            = glm::vec3(local_rotation_transform * glm::vec4(VEC_FORWARD, 1));
+                    glm::vec3 local_up_direction       = glm::vec3(local_rotation_transform * glm::vec4(VEC_UP, 1));
+                    m_eulers[j] = offset_to_euler(local_heading, &local_up_direction);
+                    apply_joint_constraints(j, parent_transform, parent_inverse_transform);
+                }
+                sum_angle += angle_delta;
+                segment_count++;
+            }
+            m_abs_transforms[j] = parent_transform * get_local_transform(j);
+        }
+        if(!segment_count) {
+            continue;
+        }
+        float average_angle = sum_angle / segment_count;
+        if(average_angle < accept_avg_angle_distance) {
+            converge = true;
+        }
+    }
+    update_abs_transforms();
+    return converge && find_solution;
+}
+
+bool IKChain::solve_analytic(glm::vec3 target,
+                             float     accept_end_effector_distance)
+{
+    if(!is_analytic()) {
+        return false;
+    }
+    m_analytic_eulers = m_eulers;
+    int hip_branch_count = (m_analytic_leg.m_hip_index >= 0) ? 2 : 1;
+    for(int i = 0; i < hip_branch_count; i++) {
+        m_eulers = m_analytic_eulers;
+        update_abs_transforms();
+        if(solve_analytic_branch(target, i != 0) && glm::distance(get_end_effector_tip(), target) < accept_end_effector_distance) {
+            return true;
+        }
+    }
+    m_eulers = m_analytic_eulers;
+    update_abs_transforms();
+    return false;
+}
+
+void IKChain::commit()
+{
+    if(m_segments.empty()) {
+        return;
+    }
+    for(size_t i = 0; i < m_segments.size(); i++) {
+        TransformObject* segment = m_segments[i];
+        segment->m_origin = m_origins[i];
+        segment->m_euler  = m_eulers[i];
+        segment->mark_dirty_transform();
+    }
+    m_segments.front()->get_transform(); // bring cached transforms of everything under root up to date
+}
+
+glm::mat4 IKChain::get_local_rotation_transform(size_t index) const
+{
+    return GLM_EULER_TRANSFORM(EULER_YAW(m_eulers[index]), EULER_PITCH(m_eulers[index]), EULER_ROLL(m_eulers[index]));
+}
+
+glm::mat4 IKChain::get_local_transform(size_t index) const
+{
+    return glm::translate(glm::mat4(1), m_origins[index]) * get_local_rotation_transform(index) * glm::scale(glm::mat4(1), m_scales[index]);
+}
+
+// inverse of get_local_transform without a general 4x4 inverse
+glm::mat4 IKChain::get_local_inverse_transform(size_t index) const
+{
+    return glm::scale(glm::mat4(1), 1.0f / m_scales[index]) * glm::transpose(get_local_rotation_transform(index)) * glm::translate(glm::mat4(1), -m_origins[index]);
+}
+
+void IKChain::update_abs_transforms(size_t first_index)
+{
+    glm::mat4 parent_transform = first_index ? m_abs_transforms[first_index - 1] : m_base_transform;
+    for(size_t i = first_index; i < m_segments.size(); i++) {
+        parent_transform = m_abs_transforms[i] = parent_transform * get_local_transform(i);
+    }
+}
+
+// turn segment about its origin so abs_reference_point swings toward abs_target, then apply constraints
+// returns angle turned (degrees) before constraints
+float IKChain::arcball(size_t           index,
+                       const glm::mat4& parent_transform,
+                       const glm::mat4& parent_inverse_transform,
+                       glm::vec3        abs_target,
+                       glm::vec3        abs_reference_point)
+{
+    glm::vec3 local_target_dir          = glm::normalize(glm::vec3(parent_inverse_transform * glm::vec4(abs_target,          1)) - m_origins[index]);
+    glm::vec3 local_reference_point_dir = glm::normalize(glm::vec3(parent_inverse_transform * glm::vec4(abs_reference_point, 1)) - m_origins[index]);
+    glm::vec3 local_arc_delta           = local_target_dir - local_reference_point_dir;
+    glm::vec3 local_arc_midpoint        = (local_target_dir + local_reference_point_dir) * 0.5f;
+    if(!(glm::length(local_arc_delta) > 0) || !(glm::length(local_arc_midpoint) > 0)) { // already there, straight behind, or degenerate: no pivot
+        return 0;
+    }
+    glm::vec3 local_arc_delta_dir       = glm::normalize(local_arc_delta);
+    glm::vec3 local_arc_midpoint_dir    = glm::normalize(local_arc_midpoint);
+    glm::vec3 local_arc_pivot_dir       = glm::cross(local_arc_delta_dir, local_arc_midpoint_dir);
+    float     angle_delta               = glm::degrees(glm::angle(local_target_dir, local_reference_point_dir));
+    glm::mat4 local_rotation_transform  = GLM_ROTATION_TRANSFORM(glm::mat4(1), -angle_delta, local_arc_pivot_dir) * get_local_rotation_transform(index);
+    glm::vec3 local_heading             = glm::vec3(local_rotation_transform * glm::vec4(VEC_FORWARD, 1));
+    glm::vec3 local_up_direction        = glm::vec3(local_rotation_transform * glm::vec4(VEC_UP, 1));
+    m_eulers[index] = offset_to_euler(local_heading, &local_up_direction);
+    apply_joint_constraints(index, parent_transform, parent_inverse_transform);
+    return angle_delta;
+}
+
+//===========
+// analytic IK
+//===========
+
+// axis a revolute joint turns about, if only one: hinge axis, or the one axis constraints don't lock
+euler_index_t IKChain::get_single_axis(size_t index) const
+{
+    if(m_joint_types[index] != TransformObject::JOINT_TYPE_REVOLUTE) {
+        return EULER_INDEX_UNDEF;
+    }
+    if(m_hinge_types[index] != EULER_INDEX_UNDEF) {
+        return m_hinge_types[index];
+    }
+    euler_index_t single_axis = EULER_INDEX_UNDEF;
+    for(int i = 0; i < 3; i++) {
+        if(!m_enable_joint_constraints[index][i]) {
+            return EULER_INDEX_UNDEF;
+        }
+        if(m_joint_constraints_max_deviations[index][i] == 0) {
+            continue;
+        }
+        if(single_axis != EULER_INDEX_UNDEF) {
+            return EULER_INDEX_UNDEF;
+        }
+        single_axis = static_cast<euler_index_t>(i);
+    }
+    return single_axis;
+}
+
+// segment's own axis in world
+glm::vec3 IKChain::get_abs_axis(size_t index, euler_index_t euler_index) const
+{
+    return glm::normalize(glm::vec3(m_abs_transforms[index] * glm::vec4(euler_index_to_axis(euler_index), 0)));
+}
+
+// [hip] [coxa] upper lower [wrist], all offsets within leg plane (normal to pitch axis)
+void IKChain::detect_analytic_leg()
+{
+    AnalyticLeg &leg = m_analytic_leg;
+    leg.m_hip_index   = -1;
+    leg.m_coxa_index  = -1;
+    leg.m_upper_index = -1;
+    leg.m_lower_index = -1;
+    leg.m_wrist_index = -1;
+    int first_pitch_index = 0;
+    int last_pitch_index  = static_cast<int>(m_segments.size()) - 1;
+    if(last_pitch_index < 1) {
+        return;
+    }
+    euler_index_t hip_axis = get_single_axis(first_pitch_index);
+    if(hip_axis == EULER_INDEX_YAW || hip_axis == EULER_INDEX_ROLL) {
+        // first pitch hinge on hip axis, so leg plane always holds it
+        glm::vec3 axis   = euler_index_to_axis(hip_axis);
+        glm::vec3 origin = m_origins[first_pitch_index + 1];
+        if(glm::length(origin - axis * glm::dot(origin, axis)) > EPSILON) {
+            return;
+        }
+        first_pitch_index++;
+    } else if(get_single_axis(last_pitch_index) == EULER_INDEX_YAW) {
+        // wrist origin and tip straight ahead
+        glm::vec3 origin = m_origins[last_pitch_index];
+        glm::vec3 tip    = m_local_end_effector_tip;
+        if(fabs(origin.x) > EPSILON || fabs(origin.y) > EPSILON || origin.z < EPSILON ||
+           fabs(tip.x)    > EPSILON || fabs(tip.y)    > EPSILON || tip.z    < EPSILON)
+        {
+            return;
+        }
+        last_pitch_index--;
+    } else if(fabs(m_local_end_effector_tip.x) > EPSILON) {
+        return;
+    }
+    int pitch_count = last_pitch_index - first_pitch_index + 1;
+    if(pitch_count < 2 || pitch_count > 3) {
+        return;
+    }
+    for(int i = first_pitch_index; i <= last_pitch_index; i++) {
+        if(get_single_axis(i) != EULER_INDEX_PITCH || (i > first_pitch_index && fabs(m_origins[i].x) > EPSILON)) {
+            return;
+        }
+    }
+    leg.m_hip_index   = first_pitch_index ? 0 : -1;
+    leg.m_coxa_index  = (pitch_count == 3) ? first_pitch_index : -1;
+    leg.m_upper_index = last_pitch_index - 1;
+    leg.m_lower_index = last_pitch_index;
+    leg.m_wrist_index = (last_pitch_index < static_cast<int>(m_segments.size()) - 1) ? last_pitch_index + 1 : -1;
+}
+
+// hip mirrored (from what's nearest to current pose) if asked, false if pitch hinges can't reach within limits
+// NOTE: hip and wrist limits apply as they turn, so if they get in the way, end effector tip misses target
+bool IKChain::solve_analytic_branch(glm::vec3 target, bool flip_hip)
+{
+    const AnalyticLeg &leg = m_analytic_leg;
+    int first_pitch_index = (leg.m_coxa_index >= 0) ? leg.m_coxa_index : leg.m_upper_index;
+    // turn leg plane to hold target
+    if(leg.m_hip_index >= 0) {
+        euler_index_t hip_axis   = get_single_axis(leg.m_hip_index);
+        glm::vec3     abs_axis   = get_abs_axis(leg.m_hip_index, hip_axis);
+        glm::vec3     target_dir = target - glm::vec3(m_abs_transforms[leg.m_hip_index][3]);
+        target_dir -= abs_axis * glm::dot(target_dir, abs_axis);
+        if(glm::length(target_dir) > EPSILON) {
+            float angle_delta = angle_about_axis(abs_axis, get_abs_axis(leg.m_hip_index, EULER_INDEX_PITCH), glm::cross(abs_axis, target_dir));
+            if(fabs(angle_delta) > 90) { // same plane, facing the other way
+                angle_delta += (angle_delta > 0) ? -180 : 180;
+            }
+            if(flip_hip) {
+                angle_delta += (angle_delta > 0) ? -180 : 180;
+            }
+            rotate_about_own_axis(leg.m_hip_index, hip_axis, angle_delta);
+        }
+    }
+    // leg plane, that hinge constraints keep pitch hinges to, headings measured from that of first one's parent
+    const glm::mat4 &plane_transform = first_pitch_index ? m_abs_transforms[first_pitch_index - 1] : m_base_transform;
+    glm::vec3 plane_origin  = glm::vec3(m_abs_transforms[first_pitch_index][3]);
+    glm::vec3 plane_normal  = glm::normalize(glm::vec3(plane_transform * glm::vec4(VEC_LEFT,    0)));
+    glm::vec3 plane_heading = glm::normalize(glm::vec3(plane_transform * glm::vec4(VEC_FORWARD, 0)));
+    glm::vec3 plane_side    = glm::cross(plane_normal, plane_heading);
+    glm::vec3 plane_target  = target - plane_origin;
+    float     target_height = glm::dot(plane_target, plane_normal);
+    // lower link ends at tip, or where the wrist leaves the plane to swing tip target_height out of it
+    glm::vec3 abs_link_end = get_end_effector_tip();
+    if(leg.m_wrist_index >= 0) {
+        glm::vec3 abs_wrist_origin = glm::vec3(m_abs_transforms[leg.m_wrist_index][3]);
+        glm::vec3 abs_lower_origin = glm::vec3(m_abs_transforms[leg.m_lower_index][3]);
+        float     wrist_length     = glm::distance(abs_wrist_origin, abs_link_end);
+        float     sin_wrist        = std::min(static_cast<float>(fabs(target_height)) / wrist_length, 1.0f);
+        abs_link_end = abs_wrist_origin + glm::normalize(abs_wrist_origin - abs_lower_origin) * wrist_length * sqrt(1 - sin_wrist * sin_wrist);
+    }
+    PlanarHinge hinges[3];
+    int         hinge_count = 0;
+    for(int j = first_pitch_index; j <= leg.m_lower_index; j++) {
+        PlanarHinge &hinge       = hinges[hinge_count++];
+        glm::vec3    abs_heading = get_abs_axis(j, EULER_INDEX_ROLL);
+        glm::vec3    link        = ((j < leg.m_lower_index) ? glm::vec3(m_abs_transforms[j + 1][3]) : abs_link_end) - glm::vec3(m_abs_transforms[j][3]);
+        hinge.m_heading       = angle_about_axis(plane_normal, plane_heading, abs_heading);
+        hinge.m_link_angle    = angle_about_axis(plane_normal, abs_heading, link);
+        hinge.m_link_length   = glm::length(link);
+        hinge.m_center        = m_joint_constraints_centers[j][EULER_INDEX_PITCH];
+        hinge.m_max_deviation = m_joint_constraints_max_deviations[j][EULER_INDEX_PITCH];
+    }
+    float headings[3];
+    if(!solve_planar_leg(hinges, hinge_count, glm::vec2(glm::dot(plane_target, plane_heading), glm::dot(plane_target, plane_side)), headings)) {
+        return false;
+    }
+    // turn pitch hinges to match, root first
+    for(int k = 0; k < hinge_count; k++) {
+        int   j           = first_pitch_index + k;
+        float angle_delta = angle_modulo(headings[k] - angle_about_axis(plane_normal, plane_heading, get_abs_axis(j, EULER_INDEX_ROLL)) + 180) - 180;
+        if(glm::dot(get_abs_axis(j, EULER_INDEX_PITCH), plane_normal) < 0) {
+            angle_delta = -angle_delta;
+        }
+        rotate_about_own_axis(j, EULER_INDEX_PITCH, angle_delta);
+    }
+    // hinge constraints may leave pitch hinges a touch off plane, take that up at hip
+    if(leg.m_hip_index >= 0) {
+        euler_index_t hip_axis       = get_single_axis(leg.m_hip_index);
+        glm::vec3     abs_hip_origin = glm::vec3(m_abs_transforms[leg.m_hip_index][3]);
+        rotate_about_own_axis(leg.m_hip_index, hip_axis,
+                              angle_about_axis(get_abs_axis(leg.m_hip_index, hip_axis), get_end_effector_tip() - abs_hip_origin, target - abs_hip_origin));
+    }
+    // wrist off plane to target
+    if(leg.m_wrist_index >= 0) {
+        glm::vec3 abs_wrist_origin = glm::vec3(m_abs_transforms[leg.m_wrist_index][3]);
+        rotate_about_own_axis(leg.m_wrist_index, EULER_INDEX_YAW,
+                              angle_about_axis(get_abs_axis(leg.m_wrist_index, EULER_INDEX_YAW), get_end_effector_tip() - abs_wrist_origin, target - abs_wrist_origin));
+    }
+    return true;
+}
+
+// turn segment about its own axis, then apply constraints
+void IKChain::rotate_about_own_axis(size_t index, euler_index_t euler_index, float angle_delta)
+{
+    if(angle_delta == 0) {
+        return;
+    }
+    const glm::mat4 &parent_transform         = index ? m_abs_transforms[index - 1] : m_base_transform;
+    glm::mat4        parent_inverse_transform = glm::inverse(parent_transform);
+    glm::mat4        local_rotation_transform = get_local_rotation_transform(index) * GLM_ROTATION_TRANSFORM(glm::mat4(1), angle_delta, euler_index_to_axis(euler_index));
+    glm::vec3        local_heading            = glm::vec3(local_rotation_transform * glm::vec4(VEC_FORWARD, 1));
+    glm::vec3        local_up_direction       = glm::vec3(local_rotation_transform * glm::vec4(VEC_UP, 1));
+    m_eulers[index] = offset_to_euler(local_heading, &local_up_direction);
+    apply_joint_constraints(index, parent_transform, parent_inverse_transform);
+    update_abs_transforms(index);
+}
+
+//==================
+// joint constraints
+//==================
+
+// see TransformObject::apply_hinge_constraints_perpendicular_to_plane_of_free_rotation
+void IKChain::apply_hinge_constraints_perpendicular_to_plane_of_free_rotation(size_t           index,
+                                                                              const glm::mat4& parent_transform,
+                                                                              const glm::mat4& parent_inverse_transform)
+{
+    euler_index_t hinge_type = m_hinge_types[index];
+    if(hinge_type == EULER_INDEX_UNDEF || hinge_type == EULER_INDEX_ROLL) { // NOTE: roll hinge joints too unstable
+        return;
+    }
+    glm::vec3 local_heading;
+    glm::vec3 local_up_dir;
+    glm::vec3 parent_plane_origin             = glm::vec3(parent_transform[3]);
+    glm::mat4 normal_transform                = glm::transpose(get_local_inverse_transform(index) * parent_inverse_transform);
+    glm::vec3 joint_origin                    = glm::vec3(parent_transform * glm::vec4(m_origins[index], 1));
+    glm::vec3 joint_abs_left_axis_endpoint    = joint_origin + glm::vec3(normal_transform * glm::vec4(VEC_LEFT,    1)); // X
+    glm::vec3 joint_abs_up_axis_endpoint      = joint_origin + glm::vec3(normal_transform * glm::vec4(VEC_UP,      1)); // Y
+    glm::vec3 joint_abs_heading_axis_endpoint = joint_origin + glm::vec3(normal_transform * glm::vec4(VEC_FORWARD, 1)); // Z
+    switch(hinge_type) {
+        case EULER_INDEX_PITCH:
+            {
+                // allow ONLY pitch -- project onto YZ plane
+                glm::vec3 parent_plane_normal                  = abs_direction(parent_inverse_transform, EULER_INDEX_PITCH);                                        // X
+                glm::vec3 joint_flattened_abs_up_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_up_axis_endpoint);      // Y
+                glm::vec3 joint_flattened_abs_heading_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_heading_axis_endpoint); // Z
+                          local_up_dir                         = glm::vec3(parent_inverse_transform * glm::vec4(joint_flattened_abs_up_axis_endpoint, 1)) - m_origins[index]; // Y
+                          local_heading                        = glm::vec3(parent_inverse_transform * glm::vec4(joint_flattened_abs_heading_endpoint, 1)) - m_origins[index]; // Z
+            }
+            break;
+        case EULER_INDEX_YAW:
+            {
+                // allow ONLY yaw -- project onto XZ plane
+                glm::vec3 parent_plane_normal                    = abs_direction(parent_inverse_transform, EULER_INDEX_YAW);                                          // Y
+                glm::vec3 joint_flattened_abs_heading_endpoint   = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_heading_axis_endpoint); // Z
+                glm::vec3 joint_flattened_abs_left_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_left_axis_endpoint);    // X
+                          local_heading                          = glm::vec3(parent_inverse_transform * glm::vec4(joint_flattened_abs_heading_endpoint,   1)) - m_origins[index]; // Z
+                glm::vec3 local_left_dir                         = glm::vec3(parent_inverse_transform * glm::vec4(joint_flattened_abs_left_axis_endpoint, 1)) - m_origins[index]; // X
+                          local_up_dir                           = glm::normalize(glm::cross(local_heading, local_left_dir));                                                      // Y
+            }
+            break;
+        default:
+            break;
+    }
+    // point at local heading, with the same constraints minus this one
+    m_eulers[index] = offset_to_euler(local_heading, &local_up_dir);
+    apply_hinge_constraints_within_plane_of_free_rotation(index, parent_transform, parent_inverse_transform);
+}
+
+// see TransformObject::apply_hinge_constraints_within_plane_of_free_rotation
+void IKChain::apply_hinge_constraints_within_plane_of_free_rotation(size_t           index,
+                                                                    const glm::mat4& parent_transform,
+                                                                    const glm::mat4& parent_inverse_transform)
+{
+    euler_index_t hinge_type = m_hinge_types[index];
+    if(hinge_type == EULER_INDEX_UNDEF || hinge_type == EULER_INDEX_ROLL) { // NOTE: roll hinge joints too unstable
+        return;
+    }
+    glm::vec3 &euler                  = m_eulers[index];
+    glm::vec3 center                  = m_joint_constraints_centers[index];
+    glm::vec3 max_deviation           = m_joint_constraints_max_deviations[index];
+    glm::vec3 parent_abs_origin       = glm::vec3(parent_transform[3]);
+    glm::vec3 parent_abs_up_direction = abs_direction(parent_inverse_transform, EULER_INDEX_YAW);
+    glm::mat4 abs_inverse_transform   = get_local_inverse_transform(index) * parent_inverse_transform;
+    glm::vec3 abs_heading             = abs_direction(abs_inverse_transform, EULER_INDEX_ROLL);
+    glm::vec3 center_local_euler      = euler;
+    center_local_euler[hinge_type]    = center[hinge_type];
+    glm::vec3 center_dir              = dir_from_point_as_offset_in_other_system(center_local_euler, parent_transform, parent_abs_origin);
+    // if pointing backwards and not yet suppressed roll and yaw
+    if(hinge_type == EULER_INDEX_PITCH &&
+       glm::dot(abs_direction(abs_inverse_transform, EULER_INDEX_YAW), parent_abs_up_direction) < 0 &&
+       !(euler[EULER_INDEX_ROLL] == 0 && euler[EULER_INDEX_YAW] == 0))
+    {
+        // suppress roll and yaw and remap pitch from [-90, 90] to [-90, -270]
+        euler[EULER_INDEX_ROLL]  = 0;
+        euler[EULER_INDEX_PITCH] = -180 - euler[EULER_INDEX_PITCH];
+        euler[EULER_INDEX_YAW]   = 0;
+        // recalculate local vars to reflect change
+        abs_heading                    = abs_direction(get_local_inverse_transform(index) * parent_inverse_transform, EULER_INDEX_ROLL);
+        center_local_euler             = euler;
+        center_local_euler[hinge_type] = center[hinge_type];
+        center_dir                     = dir_from_point_as_offset_in_other_system(center_local_euler, parent_transform, parent_abs_origin);
+    }
+    if(fabs(euler[EULER_INDEX_ROLL]) > 90) { // if upside down for some reason, right it
+        euler[EULER_INDEX_ROLL] = 0;
+    }
+    if(glm::degrees(glm::angle(abs_heading, center_dir)) <= max_deviation[hinge_type]) { // if not violating constraints, leave it
+        return;
+    }
+    // if violating constraints, snap to nearest hinge boundary
+    float min_value = center[hinge_type] - max_deviation[hinge_type];
+    float max_value = center[hinge_type] + max_deviation[hinge_type];
+    glm::vec3 min_local_euler = euler;
+    glm::vec3 max_local_euler = euler;
+    min_local_euler[hinge_type] = min_value;
+    max_local_euler[hinge_type] = max_value;
+    glm::vec3 min_dir = dir_from_point_as_offset_in_other_system(min_local_euler, parent_transform, parent_abs_origin);
+    glm::vec3 max_dir = dir_from_point_as_offset_in_other_system(max_local_euler, parent_transform, parent_abs_origin);
+    euler[hinge_type] = (glm::distance(abs_heading, min_dir) < glm::distance(abs_heading, max_dir)) ? min_value : max_value;
+}
+
+// see TransformObject::apply_joint_constraints
+void IKChain::apply_joint_constraints(size_t           index,
+                                      const glm::mat4& parent_transform,
+                                      const glm::mat4& parent_inverse_transform)
+{
+    const glm::ivec3 &enable_joint_constraints = m_enable_joint_constraints[index];
+    const glm::vec3  &center                   = m_joint_constraints_centers[index];
+    const glm::vec3  &max_deviation            = m_joint_constraints_max_deviations[index];
+    glm::vec3        &euler                    = m_eulers[index];
+    glm::vec3        &origin                   = m_origins[index];
+    switch(m_joint_types[index]) {
+        case TransformObject::JOINT_TYPE_REVOLUTE:
+            if(m_hinge_types[index] != EULER_INDEX_UNDEF && m_hinge_types[index] != EULER_INDEX_ROLL) { // NOTE: roll hinge joints too unstable
+                apply_hinge_constraints_perpendicular_to_plane_of_free_rotation(index, parent_transform, parent_inverse_transform); // provides stability; prevents numerical errors from accumulating
+                apply_hinge_constraints_within_plane_of_free_rotation(index, parent_transform, parent_inverse_transform);           // enforces joint limits
+                break;
+            }
+            for(int i = 0; i < 3; i++) {
+                if(!enable_joint_constraints[i]) {
+                    continue;
+                }
+                if(angle_distance(euler[i], center[i]) > max_deviation[i]) {
+                    float min_value = center[i] - max_deviation[i];
+                    float max_value = center[i] + max_deviation[i];
+                    euler[i] = (angle_distance(euler[i], min_value) < angle_distance(euler[i], max_value)) ? min_value : max_value;
+                }
+            }
+            break;
+        case TransformObject::JOINT_TYPE_PRISMATIC:
+            for(int i = 0; i < 3; i++) {
+                if(!enable_joint_constraints[i]) {
+                    continue;
+                }
+                if(fabs(origin[i] - center[i]) > max_deviation[i]) {
+                    float min_value = center[i] - max_deviation[i];
+                    float max_value = center[i] + max_deviation[i];
+                    origin[i] = (fabs(origin[i] - min_value) < fabs(origin[i] - max_value)) ? min_value : max_value;
+                }
+            }
+            break;
+    }
+}
+
+}
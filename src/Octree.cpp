@@ -16,375 +16,1642 @@
 // along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <Octree.h>
-#include <TransformObject.h>
-#include <BBoxObject.h>
+#include <ThreadPool.h>
+#include <SimdDistance.h>
 #include <PrimitiveFactory.h>
-#include <queue>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <sstream>
-#include <memory.h>
+#include <algorithm>
+#include <new>
+#include <cmath>
+#include <limits>
 
-#define NODE_CAPACITY      5
-#define DEPTH_LIMIT        4
-#define EARLY_PRUNE_LEVELS 0 // of questionable benefit
+#define DEFAULT_NODE_CAPACITY 5
+#define DEFAULT_DEPTH_LIMIT   4
+#define POOL_BLOCK_SIZE       256
+#define MORTON_LEVELS         21 // bits per axis in a 63-bit morton code
+#define LEAF_SCAN_CHUNK       64 // leaf objects per distance2_soa call (stack scratch)
+#define MAX_GROW_COUNT        512 // root doublings, more than float's exponent range
+
+#ifdef NO_OCTREE_STATS
+    #define ADD_STAT(stat, n)
+    #define ADD_QUERY_STAT(stats, stat, n)
+#else
+    #define ADD_STAT(stat, n)              m_root->m_stats[(stat)] += (n)
+    #define ADD_QUERY_STAT(stats, stat, n) (stats)->m_stats[(stat)] += (n) // see add_query_stats
+#endif
 
 namespace vt {
 
-Octree::Octree(glm::vec3 origin,
-               glm::vec3 dim,
-               int       index,
-               int       depth,
-               Octree*   parent,
-               Octree*   root)
-    : m_origin(origin),
-      m_dim(dim),
-      m_center(origin + dim * 0.5f),
-      m_index(index),
-      m_depth(depth),
-      m_parent(parent),
-      m_root(parent ? root : this),
-      m_child_count(0)
+// morton digit (x << 2 | y << 1 | z) to octant index (see get_octant_index)
+static const int morton_digit_to_octant_index[8] = {0, 1, 4, 5, 3, 2, 7, 6};
+
+// keep the k nearest in a max-heap of squared distances
+static void push_nearest_k(id_dist_t* heap, int* heap_size, int k, long id, float dist2)
+{
+    if(*heap_size < k) {
+        heap[(*heap_size)++] = id_dist_t(id, dist2);
+        std::push_heap(heap, heap + *heap_size, id_dist_less_than_t());
+        return;
+    }
+    if(dist2 >= heap[0].second) { // no closer than current k-th nearest
+        return;
+    }
+    std::pop_heap(heap, heap + k, id_dist_less_than_t());
+    heap[k - 1] = id_dist_t(id, dist2);
+    std::push_heap(heap, heap + k, id_dist_less_than_t());
+}
+
+static uint64_t morton_spread_bits(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2)  & 0x1249249249249249ULL;
+    return x;
+}
+
+static uint64_t morton_quantize(float value, float origin, float dim)
+{
+    const float max_cell = static_cast<float>((1 << MORTON_LEVELS) - 1);
+    float cell = (value - origin) / dim * (1 << MORTON_LEVELS);
+    return static_cast<uint64_t>(std::min(std::max(cell, 0.0f), max_cell)); // clamp strays into border cells (like insert)
+}
+
+// slab test for ray_origin + ray_dir * t, 0 <= t <= max_t (inv_dir = 1 / ray_dir), enter_t is 0 if starting inside
+static bool ray_bbox_intersect(glm::vec3 ray_origin,
+                               glm::vec3 inv_dir,
+                               glm::vec3 min,
+                               glm::vec3 max,
+                               float     max_t,
+                               float*    enter_t)
+{
+    float enter = 0;
+    float exit  = max_t;
+    for(int i = 0; i < 3; i++) {
+        float t0 = (min[i] - ray_origin[i]) * inv_dir[i];
+        float t1 = (max[i] - ray_origin[i]) * inv_dir[i];
+        if(t0 > t1) {
+            std::swap(t0, t1);
+        }
+        enter = std::max(enter, t0); // NaN (parallel ray grazing a slab) keeps the old value
+        exit  = std::min(exit, t1);
+    }
+    *enter_t = enter;
+    return enter <= exit;
+}
+
+// axes with no extent (or a bad one) take the largest good one, else 1, so the root can double toward any pos
+static glm::vec3 nondegenerate_dim(glm::vec3 dim)
+{
+    float max_dim = 0;
+    for(int i = 0; i < 3; i++) {
+        if(std::isfinite(dim[i]) && dim[i] > max_dim) {
+            max_dim = dim[i];
+        }
+    }
+    if(max_dim == 0) {
+        max_dim = 1;
+    }
+    for(int i = 0; i < 3; i++) {
+        if(!std::isfinite(dim[i]) || dim[i] <= 0) {
+            dim[i] = max_dim;
+        }
+    }
+    return dim;
+}
+
+// bbox (origin, dim) grown about its center to looseness times its size
+static void loose_bbox(glm::vec3  origin,
+                       glm::vec3  dim,
+                       float      looseness,
+                       glm::vec3* min,
+                       glm::vec3* max)
+{
+    glm::vec3 margin = dim * ((looseness - 1) * 0.5f);
+    *min = origin - margin;
+    *max = origin + dim + margin;
+}
+
+static bool bbox_within_bbox(glm::vec3 min, glm::vec3 max, glm::vec3 outer_min, glm::vec3 outer_max)
+{
+    return (outer_min.x <= min.x && max.x <= outer_max.x) &&
+           (outer_min.y <= min.y && max.y <= outer_max.y) &&
+           (outer_min.z <= min.z && max.z <= outer_max.z);
+}
+
+static bool bbox_overlaps_bbox(glm::vec3 min, glm::vec3 max, glm::vec3 other_min, glm::vec3 other_max)
+{
+    return (min.x <= other_max.x && other_min.x <= max.x) &&
+           (min.y <= other_max.y && other_min.y <= max.y) &&
+           (min.z <= other_max.z && other_min.z <= max.z);
+}
+
+OctreeConfig::OctreeConfig()
+    : m_node_capacity(DEFAULT_NODE_CAPACITY),
+      m_depth_limit(DEFAULT_DEPTH_LIMIT)
+{
+}
+
+OctreeConfig::OctreeConfig(int node_capacity, int depth_limit)
+    : m_node_capacity(std::max(node_capacity, 1)),
+      m_depth_limit(std::max(depth_limit, 0))
+{
+}
+
+Octree::Octree(glm::vec3           origin,
+               glm::vec3           dim,
+               const OctreeConfig& config)
+    : m_root(new Root(this, config)),
+      m_pool_index(-1),
+      m_generation(0)
+{
+    reset(origin, nondegenerate_dim(dim), -1, 0, NULL);
+    reset_stats();
+    reserve_leaf_objects(m_root->m_leaf_capacity);
+}
+
+Octree::QueryStats::QueryStats()
+    : m_hint_hit_count(0),
+      m_hint_miss_count(0)
+{
+    for(int i = 0; i < OCTREE_STAT_COUNT; i++) {
+        m_stats[i] = 0;
+    }
+}
+
+Octree::Root::Root(Octree* node, const OctreeConfig& config)
+    : m_node(node),
+      m_config(config),
+      m_looseness(1),
+      m_pool_size(0),
+      m_leaf_capacity(config.m_node_capacity * 2), // headroom for leaves at the depth limit, which never split
+      m_hint_hit_count(0),
+      m_hint_miss_count(0)
+{
+}
+
+Octree::Root::~Root()
+{
+    for(int i = 0; i < m_pool_size; i++) {
+        get_pool_node(i)->~Octree();
+    }
+    for(std::vector<Octree*>::iterator p = m_pool_blocks.begin(); p != m_pool_blocks.end(); p++) {
+        ::operator delete(*p);
+    }
+}
+
+Octree::Octree(glm::vec3 origin,
+               glm::vec3 dim,
+               int       index,
+               int       depth,
+               Octree*   parent,
+               Root*     root)
+    : m_root(root),
+      m_pool_index(-1),
+      m_generation(0)
+{
+    reset(origin, dim, index, depth, parent);
+    reserve_leaf_objects(root->m_leaf_capacity);
+}
+
+Octree::~Octree()
+{
+    if(!is_root()) {
+        return; // pool nodes are released by the root
+    }
+    clear();
+    delete m_root;
+}
+
+void Octree::clear()
+{
+    if(is_root()) {
+        m_root->m_leaf_index.clear();
+        m_root->m_box_index.clear();
+        m_root->m_dirty_ids.clear();
+    } else {
+        unindex_hier();
+    }
+    clear_nodes();
+    if(is_root()) {
+        m_mass           = 0; // drop rounding left over from subtracting every object
+        m_center_of_mass = m_center;
+        for(int i = 0; i < 3; i++) {
+            m_mass_moment[i] = 0;
+        }
+    }
+}
+
+void Octree::clear_nodes()
+{
+    clear_leaf_objects(); // purge leaf contents
+    m_box_ids.clear();
+    m_box_mins.clear();
+    m_box_maxs.clear();
+    for(int i = 0; i < 8; i++) {
+        if(m_nodes[i] == -1) {
+            continue;
+        }
+        m_root->free_node(get_node(i));
+        m_nodes[i] = -1;
+        m_child_count--;
+    }
+}
+
+void Octree::unindex_hier()
+{
+    for(std::vector<long>::iterator p = m_leaf_ids.begin(); p != m_leaf_ids.end(); p++) {
+        m_root->m_leaf_index.erase(*p);
+    }
+    for(std::vector<long>::iterator p = m_box_ids.begin(); p != m_box_ids.end(); p++) {
+        m_root->m_box_index.erase(*p);
+    }
+    for(int i = 0; i < 8; i++) {
+        Octree* node = get_node(i);
+        if(node) {
+            node->unindex_hier();
+        }
+    }
+}
+
+void Octree::prune_empty_nodes()
+{
+    for(int i = 0; i < 8; i++) {
+        Octree* node = get_node(i);
+        if(!node) {
+            continue;
+        }
+        node->prune_empty_nodes();
+        if(!node->is_empty()) {
+            continue;
+        }
+        m_root->free_node(node);
+        m_nodes[i] = -1;
+        m_child_count--;
+        ADD_STAT(OCTREE_STAT_PRUNES, 1);
+    }
+}
+
+// double root bbox toward pos until it includes pos, pushing existing contents one level down
+// root keeps its address so outside pointers to it stay valid; returns false for non-finite pos (or if pos is still
+// out of reach after MAX_GROW_COUNT doublings)
+bool Octree::grow(glm::vec3 pos)
+{
+    if(!std::isfinite(pos.x) || !std::isfinite(pos.y) || !std::isfinite(pos.z)) {
+        return false;
+    }
+    for(int grow_count = 0; !within_bbox(pos); grow_count++) {
+        if(grow_count == MAX_GROW_COUNT) {
+            return false;
+        }
+        glm::vec3 old_origin = m_origin;
+        glm::vec3 old_dim    = m_dim;
+        glm::vec3 new_origin(pos.x < old_origin.x ? old_origin.x - old_dim.x : old_origin.x,
+                             pos.y < old_origin.y ? old_origin.y - old_dim.y : old_origin.y,
+                             pos.z < old_origin.z ? old_origin.z - old_dim.z : old_origin.z);
+        m_origin = new_origin;
+        m_dim    = old_dim * 2.0f;
+        m_center = m_origin + m_dim * 0.5f;
+        if(is_empty()) {
+            continue;
+        }
+
+        // old contents become the octant the old bbox now occupies
+        int octant_index = get_octant_index(old_origin + old_dim * 0.5f);
+        Octree* node = m_root->alloc_node(old_origin, old_dim, octant_index, 1, this);
+        for(int i = 0; i < 8; i++) {
+            node->m_nodes[i] = m_nodes[i];
+            m_nodes[i]       = -1;
+            Octree* child = node->get_node(i);
+            if(child) {
+                child->m_parent = node;
+                child->deepen_hier();
+            }
+        }
+        node->m_child_count = m_child_count;
+        node->m_leaf_ids.swap(m_leaf_ids);
+        node->m_leaf_xs.swap(m_leaf_xs);
+        node->m_leaf_ys.swap(m_leaf_ys);
+        node->m_leaf_zs.swap(m_leaf_zs);
+        node->m_leaf_masses.swap(m_leaf_masses);
+        node->m_mass           = m_mass; // old contents now sit under node, root totals stay the same
+        node->m_center_of_mass = m_center_of_mass;
+        for(int i = 0; i < 3; i++) {
+            node->m_mass_moment[i] = m_mass_moment[i];
+        }
+        for(std::vector<long>::iterator p = node->m_leaf_ids.begin(); p != node->m_leaf_ids.end(); p++) {
+            m_root->m_leaf_index[*p] = node;
+        }
+        node->m_box_ids.swap(m_box_ids);
+        node->m_box_mins.swap(m_box_mins);
+        node->m_box_maxs.swap(m_box_maxs);
+        for(std::vector<long>::iterator p = node->m_box_ids.begin(); p != node->m_box_ids.end(); p++) {
+            m_root->m_box_index[*p] = node;
+        }
+        m_nodes[octant_index] = node->m_pool_index;
+        m_child_count         = 1;
+    }
+    return true;
+}
+
+void Octree::deepen_hier()
+{
+    m_depth++;
+    for(int i = 0; i < 8; i++) {
+        Octree* node = get_node(i);
+        if(node) {
+            node->deepen_hier();
+        }
+    }
+}
+
+// free this node and every ancestor left empty by doing so
+void Octree::prune_empty_lineage()
+{
+    Octree* node = this;
+    while(node->m_parent && node->is_empty()) {
+        Octree* parent = node->m_parent;
+        parent->m_nodes[node->m_index] = -1;
+        parent->m_child_count--;
+        m_root->free_node(node);
+        ADD_STAT(OCTREE_STAT_PRUNES, 1);
+        node = parent;
+    }
+}
+
+Octree* Octree::get_node(int index) const
+{
+    if(m_nodes[index] == -1) {
+        return NULL;
+    }
+    return m_root->get_pool_node(m_nodes[index]);
+}
+
+bool Octree::insert(long id, glm::vec3 pos, float mass)
+{
+    if(m_root->m_leaf_index.find(id) != m_root->m_leaf_index.end()) { // object already added?
+        return false;
+    }
+    Octree* node = first_including_parent_node(pos);
+    if(!node) {
+        if(!m_root->m_node->grow(pos)) {
+            return false;
+        }
+        node = m_root->m_node;
+    }
+    return node->insert_hier(id, pos, mass);
+}
+
+// bulk-load: sort by morton code so every octant's objects are contiguous, then emit the tree in one top-down pass
+bool Octree::build(const std::vector<std::pair<long, glm::vec3> >& objects)
+{
+    if(!is_root()) {
+        return false;
+    }
+    for(std::unordered_map<long, Octree*>::iterator p = m_root->m_leaf_index.begin(); p != m_root->m_leaf_index.end(); p++) {
+        p->second = NULL; // keep index entries for reuse, erase whichever stay stale below
+    }
+
+    // boxes aren't bulk-loaded, set them aside and put them back into the new tree
+    std::vector<long>      box_ids;
+    std::vector<glm::vec3> box_mins;
+    std::vector<glm::vec3> box_maxs;
+    for(std::unordered_map<long, Octree*>::iterator p = m_root->m_box_index.begin(); p != m_root->m_box_index.end(); p++) {
+        const Octree* node = p->second;
+        int           slot = node->find_box(p->first);
+        box_ids.push_back(p->first);
+        box_mins.push_back(node->m_box_mins[slot]);
+        box_maxs.push_back(node->m_box_maxs[slot]);
+    }
+    m_root->m_box_index.clear();
+    clear_nodes();
+    bool skipped_any = false;
+    for(int i = 0; i < static_cast<int>(objects.size()); i++) {
+        skipped_any |= !grow(objects[i].second); // grow empty root to fit everything first
+    }
+    m_root->m_build_objects.clear();
+    for(int i = 0; i < static_cast<int>(objects.size()); i++) {
+        glm::vec3 pos = objects[i].second;
+        if(!within_bbox(pos)) { // not finite
+            continue;
+        }
+        MortonObject build_object;
+        build_object.m_code = (morton_spread_bits(morton_quantize(pos.x, m_origin.x, m_dim.x)) << 2) |
+                              (morton_spread_bits(morton_quantize(pos.y, m_origin.y, m_dim.y)) << 1) |
+                               morton_spread_bits(morton_quantize(pos.z, m_origin.z, m_dim.z));
+        build_object.m_id    = objects[i].first;
+        build_object.m_pos   = pos;
+        m_root->m_build_objects.push_back(build_object);
+    }
+    std::sort(m_root->m_build_objects.begin(), m_root->m_build_objects.end(), [](const MortonObject& a, const MortonObject& b) {
+        return a.m_code < b.m_code;
+    });
+    bool inserted_all = m_root->m_build_objects.empty() ||
+                        build_hier(&m_root->m_build_objects[0], &m_root->m_build_objects[0] + m_root->m_build_objects.size(), 0);
+    inserted_all &= !skipped_any;
+    for(int i = 0; i < static_cast<int>(box_ids.size()); i++) {
+        insert_box_hier(box_ids[i], box_mins[i], box_maxs[i]);
+    }
+    if(!inserted_all || m_root->m_leaf_index.size() != objects.size()) {
+        std::unordered_map<long, Octree*>::iterator p = m_root->m_leaf_index.begin();
+        while(p != m_root->m_leaf_index.end()) {
+            if(p->second) {
+                p++;
+                continue;
+            }
+            p = m_root->m_leaf_index.erase(p);
+        }
+    }
+    return inserted_all;
+}
+
+bool Octree::remove(long id)
+{
+    std::unordered_map<long, Octree*>::iterator p = m_root->m_leaf_index.find(id);
+    if(p == m_root->m_leaf_index.end()) {
+        return false;
+    }
+    Octree* leaf = (*p).second;
+    leaf->remove_leaf_object(leaf->find_leaf_object(id)); // remove core action
+    m_root->m_leaf_index.erase(p);
+    return true;
+}
+
+int Octree::find(glm::vec3          target,
+                 int                k,
+                 std::vector<long>* nearest_k_vec,
+                 float              radius,
+                 int*               visited_node_count,
+                 FindHint*          hint) const
+{
+    std::vector<id_dist_t>   nearest_k_heap;
+    std::vector<node_dist_t> node_heap;
+    QueryStats               stats;
+    int visited = find_best_first(target, k, radius, &nearest_k_heap, &node_heap, hint, &stats);
+    add_query_stats(stats);
+    if(visited_node_count) {
+        *visited_node_count = visited;
+    }
+    for(std::vector<id_dist_t>::iterator p = nearest_k_heap.begin(); p != nearest_k_heap.end(); p++) {
+        nearest_k_vec->push_back((*p).first);
+    }
+
+    // return actual result size
+    return nearest_k_vec->size();
+}
+
+int Octree::find(glm::vec3    target,
+                 int          k,
+                 long*        nearest_k_ids,
+                 float*       nearest_k_dist2,
+                 FindScratch* scratch,
+                 float        radius,
+                 FindHint*    hint) const
+{
+    QueryStats stats;
+    find_best_first(target, k, radius, &scratch->m_nearest_k_heap, &scratch->m_node_heap, hint, &stats);
+    add_query_stats(stats);
+    int count = scratch->m_nearest_k_heap.size();
+    for(int i = 0; i < count; i++) {
+        nearest_k_ids[i] = scratch->m_nearest_k_heap[i].first;
+        if(nearest_k_dist2) {
+            nearest_k_dist2[i] = scratch->m_nearest_k_heap[i].second;
+        }
+    }
+    return count;
+}
+
+void Octree::find_batch(const std::vector<glm::vec3>& targets,
+                        int                           k,
+                        float                         radius,
+                        FindBatchResults*             results,
+                        ThreadPool*                   thread_pool,
+                        std::vector<FindHint>*        hints) const
+{
+    int target_count = targets.size();
+    k = std::max(k, 0);
+    if(hints) {
+        hints->resize(target_count);
+    }
+    results->m_ids.resize(target_count * k);
+    results->m_offsets.resize(target_count);
+    results->m_counts.resize(target_count);
+    ThreadPool::range_func_t find_range = [&](int begin, int end) {
+        FindScratch scratch; // shared by every query in this range
+        QueryStats  stats;   // added to the root's once per range, not per query
+        for(int i = begin; i < end; i++) {
+            int offset = i * k;
+            find_best_first(targets[i], k, radius, &scratch.m_nearest_k_heap, &scratch.m_node_heap, hints ? &(*hints)[i] : NULL, &stats);
+            int count = scratch.m_nearest_k_heap.size();
+            for(int j = 0; j < count; j++) {
+                results->m_ids[offset + j] = scratch.m_nearest_k_heap[j].first;
+            }
+            results->m_offsets[i] = offset;
+            results->m_counts[i]  = count;
+        }
+        add_query_stats(stats);
+    };
+    if(thread_pool) {
+        thread_pool->parallel_for(target_count, find_range);
+    } else {
+        find_range(0, target_count);
+    }
+}
+
+// leaf-to-leaf: all objects of a leaf share one traversal, pruned against the farthest of their k-th nearest
+void Octree::knn_graph(int         k,
+                       float       radius,
+                       KnnGraph*   graph,
+                       ThreadPool* thread_pool) const
+{
+    k = std::max(k, 0);
+    std::vector<const Octree*> leaves;
+    collect_leaves(&leaves);
+    std::vector<int> leaf_offsets(leaves.size() + 1, 0); // first query slot of each leaf
+    for(int i = 0; i < static_cast<int>(leaves.size()); i++) {
+        leaf_offsets[i + 1] = leaf_offsets[i] + leaves[i]->m_leaf_ids.size();
+    }
+    int object_count = leaf_offsets.back();
+
+    // k slots per object, in leaf order
+    std::vector<id_dist_t> nearest_k_heaps(object_count * k);
+    std::vector<int>       nearest_k_heap_sizes(object_count, 0);
+    float radius2 = (radius > 0) ? radius * radius : std::numeric_limits<float>::max();
+    ThreadPool::range_func_t find_range = [&](int begin, int end) {
+        std::vector<node_dist_t> node_heap;
+        QueryStats               stats;
+        for(int i = begin; i < end; i++) {
+            int offset = leaf_offsets[i];
+            knn_graph_leaf(leaves[i], k, radius2, nearest_k_heaps.data() + offset * k, &nearest_k_heap_sizes[offset], &node_heap, &stats);
+        }
+        add_query_stats(stats);
+    };
+    if(thread_pool) {
+        thread_pool->parallel_for(leaves.size(), find_range);
+    } else {
+        find_range(0, leaves.size());
+    }
+
+    // compact into rows ordered by id
+    std::vector<std::pair<long, int> > id_slots(object_count);
+    for(int i = 0; i < static_cast<int>(leaves.size()); i++) {
+        for(int j = 0; j < static_cast<int>(leaves[i]->m_leaf_ids.size()); j++) {
+            id_slots[leaf_offsets[i] + j] = std::pair<long, int>(leaves[i]->m_leaf_ids[j], leaf_offsets[i] + j);
+        }
+    }
+    std::sort(id_slots.begin(), id_slots.end());
+    graph->m_ids.resize(object_count);
+    graph->m_offsets.resize(object_count + 1);
+    graph->m_neighbor_ids.clear();
+    graph->m_offsets[0] = 0;
+    for(int i = 0; i < object_count; i++) {
+        int slot = id_slots[i].second;
+        graph->m_ids[i] = id_slots[i].first;
+        for(int j = 0; j < nearest_k_heap_sizes[slot]; j++) {
+            graph->m_neighbor_ids.push_back(nearest_k_heaps[slot * k + j].first);
+        }
+        graph->m_offsets[i + 1] = graph->m_neighbor_ids.size();
+    }
+}
+
+void Octree::knn_graph_leaf(const Octree*             query_leaf,
+                            int                       k,
+                            float                     radius2,
+                            id_dist_t*                nearest_k_heaps,
+                            int*                      nearest_k_heap_sizes,
+                            std::vector<node_dist_t>* node_heap,
+                            QueryStats*               stats) const
+{
+    const std::vector<long>& query_ids = query_leaf->m_leaf_ids;
+    int query_count = query_ids.size();
+    if(!query_count || !k) {
+        return;
+    }
+    glm::vec3 query_min = query_leaf->get_leaf_position(0);
+    glm::vec3 query_max = query_min;
+    for(int i = 1; i < query_count; i++) {
+        query_min = glm::min(query_min, query_leaf->get_leaf_position(i));
+        query_max = glm::max(query_max, query_leaf->get_leaf_position(i));
+    }
+
+    // farthest distance any query in this leaf still cares about
+    float bound2 = radius2;
+
+    int visited        = 0;
+    int leaves_scanned = 0;
+    int objects_tested = 0;
+
+    node_heap->clear();
+    node_heap->push_back(node_dist_t(this, min_distance2(query_min, query_max)));
+    while(node_heap->size()) {
+        const Octree* node  = node_heap->front().first;
+        float         dist2 = node_heap->front().second;
+        std::pop_heap(node_heap->begin(), node_heap->end(), node_dist_greater_than_t());
+        node_heap->pop_back();
+        if(dist2 > bound2) { // every remaining node is at least this far away
+            break;
+        }
+        visited++;
+        if(!node->is_leaf()) {
+            for(int i = 0; i < 8; i++) {
+                const Octree* child = node->get_node(i);
+                if(!child) {
+                    continue;
+                }
+                float child_dist2 = child->min_distance2(query_min, query_max);
+                if(child_dist2 > bound2) {
+                    continue;
+                }
+                node_heap->push_back(node_dist_t(child, child_dist2));
+                std::push_heap(node_heap->begin(), node_heap->end(), node_dist_greater_than_t());
+            }
+            continue;
+        }
+        float next_bound2 = 0;
+        int   leaf_count  = node->m_leaf_ids.size();
+        float dist2s[LEAF_SCAN_CHUNK];
+        for(int i = 0; i < query_count; i++) {
+            id_dist_t* nearest_k_heap = nearest_k_heaps + i * k;
+            int*       heap_size      = &nearest_k_heap_sizes[i];
+            float      query_bound2   = (*heap_size == k) ? nearest_k_heap[0].second : radius2;
+            glm::vec3  query_pos      = query_leaf->get_leaf_position(i);
+            if(node->min_distance2(query_pos) <= query_bound2) {
+                leaves_scanned++;
+                objects_tested += leaf_count;
+                for(int begin = 0; begin < leaf_count; begin += LEAF_SCAN_CHUNK) {
+                    int count = std::min(leaf_count - begin, LEAF_SCAN_CHUNK);
+                    distance2_soa(&node->m_leaf_xs[begin], &node->m_leaf_ys[begin], &node->m_leaf_zs[begin], count, query_pos, dist2s);
+                    for(int j = 0; j < count; j++) {
+                        long id = node->m_leaf_ids[begin + j];
+                        if(dist2s[j] > radius2 || id == query_ids[i]) { // apply radius filter, skip self
+                            continue;
+                        }
+                        push_nearest_k(nearest_k_heap, heap_size, k, id, dist2s[j]);
+                    }
+                }
+                query_bound2 = (*heap_size == k) ? nearest_k_heap[0].second : radius2;
+            }
+            next_bound2 = std::max(next_bound2, query_bound2);
+        }
+        bound2 = next_bound2;
+    }
+    ADD_QUERY_STAT(stats, OCTREE_STAT_NODES_VISITED,  visited);
+    ADD_QUERY_STAT(stats, OCTREE_STAT_LEAVES_SCANNED, leaves_scanned);
+    ADD_QUERY_STAT(stats, OCTREE_STAT_OBJECTS_TESTED, objects_tested);
+
+    // nearest first
+    for(int i = 0; i < query_count; i++) {
+        std::sort_heap(nearest_k_heaps + i * k, nearest_k_heaps + i * k + nearest_k_heap_sizes[i], id_dist_less_than_t());
+    }
+}
+
+void Octree::collect_leaves(std::vector<const Octree*>* leaves) const
+{
+    if(is_leaf()) {
+        if(m_leaf_ids.size()) {
+            leaves->push_back(this);
+        }
+        return;
+    }
+    for(int i = 0; i < 8; i++) {
+        const Octree* node = get_node(i);
+        if(node) {
+            node->collect_leaves(leaves);
+        }
+    }
+}
+
+glm::vec3 Octree::gravity(glm::vec3 target,
+                          float     theta,
+                          float     softening,
+                          float*    potential) const
+{
+    std::vector<const Octree*> node_stack;
+    QueryStats                 stats;
+    glm::vec3 acceleration = gravity_hier(target, theta * theta, softening * softening, &node_stack, potential, &stats);
+    add_query_stats(stats);
+    return acceleration;
+}
+
+void Octree::gravity_batch(const std::vector<glm::vec3>& targets,
+                           float                         theta,
+                           float                         softening,
+                           std::vector<glm::vec3>*       accelerations,
+                           ThreadPool*                   thread_pool,
+                           std::vector<float>*           potentials) const
+{
+    int target_count = targets.size();
+    accelerations->resize(target_count);
+    if(potentials) {
+        potentials->resize(target_count);
+    }
+    ThreadPool::range_func_t gravity_range = [&](int begin, int end) {
+        std::vector<const Octree*> node_stack; // shared by every target in this range
+        QueryStats                 stats;
+        for(int i = begin; i < end; i++) {
+            (*accelerations)[i] = gravity_hier(targets[i], theta * theta, softening * softening, &node_stack, potentials ? &(*potentials)[i] : NULL, &stats);
+        }
+        add_query_stats(stats);
+    };
+    if(thread_pool) {
+        thread_pool->parallel_for(target_count, gravity_range);
+    } else {
+        gravity_range(0, target_count);
+    }
+}
+
+// depth-first, nodes far enough away (and not holding target) contribute as a single body
+glm::vec3 Octree::gravity_hier(glm::vec3                   target,
+                               float                       theta2,
+                               float                       softening2,
+                               std::vector<const Octree*>* node_stack,
+                               float*                      potential,
+                               QueryStats*                 stats) const
+{
+    glm::vec3 acceleration;
+    float     potential_sum  = 0;
+    int       visited        = 0;
+    int       objects_tested = 0;
+    node_stack->clear();
+    node_stack->push_back(this);
+    while(node_stack->size()) {
+        const Octree* node = node_stack->back();
+        node_stack->pop_back();
+        if(node->m_mass <= 0) {
+            continue;
+        }
+        visited++;
+        glm::vec3 offset = node->m_center_of_mass - target;
+        float     dist2  = glm::dot(offset, offset);
+        float     size   = std::max(node->m_dim.x, std::max(node->m_dim.y, node->m_dim.z));
+        if(size * size < theta2 * dist2 && !node->within_bbox(target)) {
+            float soft_dist = sqrtf(dist2 + softening2);
+            float mass      = node->m_mass;
+            acceleration  += offset * (mass / (soft_dist * soft_dist * soft_dist));
+            potential_sum -= mass / soft_dist;
+            continue;
+        }
+        if(node->is_leaf()) {
+            int leaf_count = node->m_leaf_ids.size();
+            for(int i = 0; i < leaf_count; i++) {
+                float mass = node->m_leaf_masses[i];
+                if(!mass) {
+                    continue;
+                }
+                glm::vec3 leaf_offset = node->get_leaf_position(i) - target;
+                float     leaf_dist2  = glm::dot(leaf_offset, leaf_offset);
+                if(!leaf_dist2) { // self adds nothing
+                    continue;
+                }
+                float leaf_soft_dist = sqrtf(leaf_dist2 + softening2);
+                acceleration  += leaf_offset * (mass / (leaf_soft_dist * leaf_soft_dist * leaf_soft_dist));
+                potential_sum -= mass / leaf_soft_dist;
+            }
+            objects_tested += leaf_count;
+            continue;
+        }
+        for(int i = 0; i < 8; i++) {
+            const Octree* child = node->get_node(i);
+            if(child) {
+                node_stack->push_back(child);
+            }
+        }
+    }
+    ADD_QUERY_STAT(stats, OCTREE_STAT_NODES_VISITED,  visited);
+    ADD_QUERY_STAT(stats, OCTREE_STAT_OBJECTS_TESTED, objects_tested);
+    if(potential) {
+        *potential = potential_sum;
+    }
+    return acceleration;
+}
+
+int Octree::find_best_first(glm::vec3                 target,
+                            int                       k,
+                            float                     radius,
+                            std::vector<id_dist_t>*   nearest_k_heap,
+                            std::vector<node_dist_t>* node_heap,
+                            FindHint*                 hint,
+                            QueryStats*               stats) const
+{
+    nearest_k_heap->clear();
+    node_heap->clear();
+    if(k <= 0) {
+        return 0;
+    }
+    int visited = 0;
+    float radius2 = (radius > 0) ? radius * radius : std::numeric_limits<float>::max();
+    if(!hint) {
+        node_heap->push_back(node_dist_t(this, min_distance2(target)));
+        visited = find_best_first_hier(target, k, radius2, radius2, nearest_k_heap, node_heap, stats);
+    } else {
+        // start from last query's node if target is still inside it, else from the top
+        // (identity and pool index are checked before the node is touched; a hint from another tree never resolves)
+        const Octree* start_node = this;
+        const Octree* hint_node  = NULL;
+        if(hint->m_tree == m_root && hint->m_node_pool_index < m_root->m_pool_size) {
+            hint_node = (hint->m_node_pool_index == -1) ? m_root->m_node : m_root->get_pool_node(hint->m_node_pool_index);
+        }
+        if(hint_node &&
+           hint_node->m_generation == hint->m_node_generation &&
+           hint_node->within_bbox(target))
+        {
+            start_node = hint_node;
+            stats->m_hint_hit_count++;
+        } else {
+            stats->m_hint_miss_count++;
+        }
+        while(!start_node->is_leaf()) {
+            const Octree* node = start_node->get_node(start_node->get_octant_index(target));
+            if(!node) {
+                break;
+            }
+            start_node = node;
+        }
+
+        // last query's neighbors (at their current positions) give an upper bound on the k-th nearest distance
+        float bound2 = find_hint_bound2(hint, target, k, radius2);
+
+        // bottom-up: search outward from start node until the k-th nearest distance fits inside the current node
+        node_heap->push_back(node_dist_t(start_node, 0));
+        visited = find_best_first_hier(target, k, radius2, bound2, nearest_k_heap, node_heap, stats);
+        const Octree* node = start_node;
+        while(node != this && node->m_parent) {
+            float kth_dist2 = (static_cast<int>(nearest_k_heap->size()) == k) ? nearest_k_heap->front().second : bound2;
+            if(node->within_bbox(target, kth_dist2)) {
+                break;
+            }
+            const Octree* parent = node->m_parent;
+            ADD_QUERY_STAT(stats, OCTREE_STAT_SIBLING_SEARCHES, 1);
+            for(int i = 0; i < 8; i++) {
+                const Octree* sibling = parent->get_node(i);
+                if(!sibling || sibling == node) {
+                    continue;
+                }
+                node_heap->push_back(node_dist_t(sibling, sibling->min_distance2(target)));
+                std::push_heap(node_heap->begin(), node_heap->end(), node_dist_greater_than_t());
+            }
+            visited += find_best_first_hier(target, k, radius2, bound2, nearest_k_heap, node_heap, stats);
+            node = parent;
+        }
+        hint->m_tree            = m_root;
+        hint->m_node_pool_index = start_node->m_pool_index;
+        hint->m_node_generation = start_node->m_generation;
+    }
+
+    // nearest first
+    std::sort_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+    if(hint) {
+        hint->m_nearest_k_ids.clear();
+        for(std::vector<id_dist_t>::iterator p = nearest_k_heap->begin(); p != nearest_k_heap->end(); p++) {
+            hint->m_nearest_k_ids.push_back((*p).first);
+        }
+    }
+    return visited;
+}
+
+int Octree::find_best_first_hier(glm::vec3                 target,
+                                 int                       k,
+                                 float                     radius2,
+                                 float                     bound2,
+                                 std::vector<id_dist_t>*   nearest_k_heap,
+                                 std::vector<node_dist_t>* node_heap,
+                                 QueryStats*               stats) const
+{
+    // nearest_k_heap: max-heap of squared distances, never more than k entries
+    // node_heap:      min-heap of unvisited nodes by squared distance to their bbox, drained on return
+    // bound2:         nothing farther than this can make the k nearest (radius2 or tighter)
+    int visited        = 0;
+    int leaves_scanned = 0;
+    int objects_tested = 0;
+    while(node_heap->size()) {
+        const Octree* node  = node_heap->front().first;
+        float         dist2 = node_heap->front().second;
+        std::pop_heap(node_heap->begin(), node_heap->end(), node_dist_greater_than_t());
+        node_heap->pop_back();
+
+        // every remaining node is at least this far away
+        if(dist2 > bound2 ||
+           (static_cast<int>(nearest_k_heap->size()) == k && dist2 >= nearest_k_heap->front().second))
+        {
+            node_heap->clear();
+            break;
+        }
+        visited++;
+        if(node->is_leaf()) {
+            node->find_hier(target, k, nearest_k_heap, radius2);
+            leaves_scanned++;
+            objects_tested += node->m_leaf_ids.size();
+            continue;
+        }
+        for(int i = 0; i < 8; i++) {
+            const Octree* child = node->get_node(i);
+            if(!child) {
+                continue;
+            }
+            float child_dist2 = child->min_distance2(target);
+            if(child_dist2 > bound2 ||
+               (static_cast<int>(nearest_k_heap->size()) == k && child_dist2 >= nearest_k_heap->front().second))
+            {
+                continue;
+            }
+            node_heap->push_back(node_dist_t(child, child_dist2));
+            std::push_heap(node_heap->begin(), node_heap->end(), node_dist_greater_than_t());
+        }
+    }
+    ADD_QUERY_STAT(stats, OCTREE_STAT_NODES_VISITED,  visited);
+    ADD_QUERY_STAT(stats, OCTREE_STAT_LEAVES_SCANNED, leaves_scanned);
+    ADD_QUERY_STAT(stats, OCTREE_STAT_OBJECTS_TESTED, objects_tested);
+    return visited;
+}
+
+float Octree::find_hint_bound2(const FindHint* hint, glm::vec3 target, int k, float radius2) const
+{
+    if(static_cast<int>(hint->m_nearest_k_ids.size()) < k) { // fewer than k neighbors say nothing about the k-th
+        return radius2;
+    }
+    float bound2 = 0;
+    for(int i = 0; i < k; i++) {
+        long id = hint->m_nearest_k_ids[i];
+        std::unordered_map<long, Octree*>::const_iterator p = m_root->m_leaf_index.find(id);
+        if(p == m_root->m_leaf_index.end()) { // neighbor since removed
+            return radius2;
+        }
+        const Octree* leaf   = (*p).second;
+        glm::vec3     offset = leaf->get_leaf_position(leaf->find_leaf_object(id)) - target;
+        bound2 = std::max(bound2, glm::dot(offset, offset));
+    }
+    return std::min(bound2, radius2);
+}
+
+// squared distances a chunk at a time through the vectorized kernel, then a scalar pass to keep the k nearest
+void Octree::find_hier(glm::vec3               target,
+                       int                     k,
+                       std::vector<id_dist_t>* nearest_k_heap,
+                       float                   radius2) const
+{
+    int   leaf_count = m_leaf_ids.size();
+    float dist2s[LEAF_SCAN_CHUNK];
+    for(int begin = 0; begin < leaf_count; begin += LEAF_SCAN_CHUNK) {
+        int count = std::min(leaf_count - begin, LEAF_SCAN_CHUNK);
+        distance2_soa(&m_leaf_xs[begin], &m_leaf_ys[begin], &m_leaf_zs[begin], count, target, dist2s);
+        for(int i = 0; i < count; i++) {
+            float dist2 = dist2s[i];
+            if(dist2 > radius2) { // apply radius filter
+                continue;
+            }
+            if(static_cast<int>(nearest_k_heap->size()) < k) {
+                nearest_k_heap->push_back(id_dist_t(m_leaf_ids[begin + i], dist2));
+                std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+                continue;
+            }
+            if(dist2 >= nearest_k_heap->front().second) { // no closer than current k-th nearest
+                continue;
+            }
+            std::pop_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+            nearest_k_heap->back() = id_dist_t(m_leaf_ids[begin + i], dist2);
+            std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+        }
+    }
+}
+
+// one atomic add per nonzero counter, so batch workers don't fight over the root's cache lines query by query
+void Octree::add_query_stats(const QueryStats& stats) const
+{
+    for(int i = 0; i < OCTREE_STAT_COUNT; i++) {
+        if(stats.m_stats[i]) {
+            m_root->m_stats[i] += stats.m_stats[i];
+        }
+    }
+    if(stats.m_hint_hit_count) {
+        m_root->m_hint_hit_count += stats.m_hint_hit_count;
+    }
+    if(stats.m_hint_miss_count) {
+        m_root->m_hint_miss_count += stats.m_hint_miss_count;
+    }
+}
+
+void Octree::reset_hint_counters()
+{
+    m_root->m_hint_hit_count  = 0;
+    m_root->m_hint_miss_count = 0;
+}
+
+void Octree::reset_stats()
+{
+    for(int i = 0; i < OCTREE_STAT_COUNT; i++) {
+        m_root->m_stats[i] = 0;
+    }
+}
+
+const char* Octree::get_stat_name(octree_stat_t stat)
+{
+    switch(stat) {
+        case OCTREE_STAT_NODES_VISITED:    return "nodes visited";
+        case OCTREE_STAT_LEAVES_SCANNED:   return "leaves scanned";
+        case OCTREE_STAT_OBJECTS_TESTED:   return "objects tested";
+        case OCTREE_STAT_SIBLING_SEARCHES: return "sibling searches";
+        case OCTREE_STAT_SPLITS:           return "splits";
+        case OCTREE_STAT_PRUNES:           return "prunes";
+        case OCTREE_STAT_MIGRATIONS:       return "migrations";
+        default:                           return "";
+    }
+}
+
+bool Octree::exists(long id)
+{
+    return m_root->m_leaf_index.find(id) != m_root->m_leaf_index.end(); // find core action
+}
+
+bool Octree::move(long id, glm::vec3 pos)
+{
+    std::unordered_map<long, Octree*>::iterator p = m_root->m_leaf_index.find(id);
+    if(p == m_root->m_leaf_index.end()) {
+        return false;
+    }
+    Octree* leaf = (*p).second;
+    leaf->set_leaf_position(leaf->find_leaf_object(id), pos); // move core action
+    if(!leaf->within_bbox(pos)) {
+        m_root->m_dirty_ids.push_back(id); // left its leaf, re-home on next rebalance
+    }
+    return true;
+}
+
+bool Octree::set_mass(long id, float mass)
+{
+    std::unordered_map<long, Octree*>::iterator p = m_root->m_leaf_index.find(id);
+    if(p == m_root->m_leaf_index.end()) {
+        return false;
+    }
+    Octree* leaf       = (*p).second;
+    int     slot       = leaf->find_leaf_object(id);
+    float   delta_mass = mass - leaf->m_leaf_masses[slot];
+    leaf->m_leaf_masses[slot] = mass;
+    if(delta_mass) {
+        leaf->add_mass_hier(delta_mass, leaf->get_leaf_position(slot) * delta_mass);
+    }
+    return true;
+}
+
+// only objects move() flagged as having left their leaf are re-homed, and only the leaves they left are pruned
+bool Octree::rebalance()
+{
+    std::vector<long>& dirty_ids = m_root->m_dirty_ids;
+    bool changed = false;
+    for(int i = 0; i < static_cast<int>(dirty_ids.size()); i++) {
+        long id = dirty_ids[i];
+        std::unordered_map<long, Octree*>::iterator p = m_root->m_leaf_index.find(id);
+        if(p == m_root->m_leaf_index.end()) { // removed since
+            continue;
+        }
+        Octree*   leaf = (*p).second;
+        int       slot = leaf->find_leaf_object(id);
+        glm::vec3 pos  = leaf->get_leaf_position(slot);
+        if(leaf->within_bbox(pos)) { // moved back in, or flagged twice
+            continue;
+        }
+        float mass = leaf->m_leaf_masses[slot];
+        leaf->remove_leaf_object(slot);
+
+        // add back to first including parent node, growing the root if it wandered off
+        Octree* node = leaf->first_including_parent_node(pos);
+        if(!node && m_root->m_node->grow(pos)) {
+            node = m_root->m_node;
+        }
+        if(!node || !node->insert_hier(id, pos, mass)) {
+            m_root->m_leaf_index.erase(id); // not finite
+        }
+        leaf->prune_empty_lineage();
+        ADD_STAT(OCTREE_STAT_MIGRATIONS, 1);
+        changed = true;
+    }
+    dirty_ids.clear();
+    return changed;
+}
+
+bool Octree::insert_box(long id, glm::vec3 min, glm::vec3 max)
 {
-    memset(m_nodes, 0, sizeof(Octree*) * 8);
+    if(m_root->m_box_index.find(id) != m_root->m_box_index.end()) { // box already added?
+        return false;
+    }
+    if(!m_root->m_node->grow(min) || !m_root->m_node->grow(max)) {
+        return false;
+    }
+    m_root->m_node->insert_box_hier(id, min, max);
+    return true;
 }
 
-Octree::~Octree()
+bool Octree::remove_box(long id)
 {
-    clear();
+    std::unordered_map<long, Octree*>::iterator p = m_root->m_box_index.find(id);
+    if(p == m_root->m_box_index.end()) {
+        return false;
+    }
+    Octree* node = (*p).second;
+    node->remove_box_slot(node->find_box(id));
+    m_root->m_box_index.erase(p);
+    return true;
 }
 
-void Octree::clear()
+bool Octree::move_box(long id, glm::vec3 min, glm::vec3 max)
 {
-    m_leaf_objects.clear(); // purge leaf contents
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
+    std::unordered_map<long, Octree*>::iterator p = m_root->m_box_index.find(id);
+    if(p == m_root->m_box_index.end()) {
+        return false;
+    }
+    Octree* node = (*p).second;
+    int     slot = node->find_box(id);
+    if(node->within_loose_bbox(min, max)) { // still enclosed, update in place
+        node->m_box_mins[slot] = min;
+        node->m_box_maxs[slot] = max;
+        return true;
+    }
+    node->remove_box_slot(slot);
+    m_root->m_box_index.erase(p);
+    bool inserted = insert_box(id, min, max);
+    node->prune_empty_lineage();
+    return inserted;
+}
+
+// best-first over nodes by where the ray enters their loose bbox, so the search stops at the first node entered past the nearest hit
+bool Octree::raycast(glm::vec3             ray_origin,
+                     glm::vec3             ray_dir,
+                     float                 max_dist,
+                     RayHit*               hit,
+                     const ray_hit_func_t& hit_func) const
+{
+    glm::vec3 inv_dir = glm::vec3(1) / ray_dir;
+    glm::vec3 node_min, node_max;
+    float     enter_dist;
+    get_loose_bbox(&node_min, &node_max);
+    if(!ray_bbox_intersect(ray_origin, inv_dir, node_min, node_max, max_dist, &enter_dist)) {
+        return false;
+    }
+    long  nearest_id   = -1;
+    float nearest_dist = max_dist;
+    std::vector<node_dist_t> node_heap;
+    node_heap.push_back(node_dist_t(this, enter_dist));
+    while(node_heap.size()) {
+        const Octree* node = node_heap.front().first;
+        float         dist = node_heap.front().second;
+        std::pop_heap(node_heap.begin(), node_heap.end(), node_dist_greater_than_t());
+        node_heap.pop_back();
+        if(dist > nearest_dist) { // every remaining node is entered farther away
+            break;
+        }
+        for(int i = 0; i < static_cast<int>(node->m_box_ids.size()); i++) {
+            long id = node->m_box_ids[i];
+            if(!ray_bbox_intersect(ray_origin, inv_dir, node->m_box_mins[i], node->m_box_maxs[i], nearest_dist, &enter_dist)) {
+                continue;
+            }
+            float hit_dist = enter_dist;
+            if(hit_func && !hit_func(id, ray_origin, ray_dir, &hit_dist)) {
+                continue;
+            }
+            if(hit_dist < nearest_dist || (nearest_id == -1 && hit_dist == nearest_dist)) {
+                nearest_id   = id;
+                nearest_dist = hit_dist;
+            }
+        }
+        for(int i = 0; i < 8; i++) {
+            const Octree* child = node->get_node(i);
+            if(!child) {
+                continue;
+            }
+            child->get_loose_bbox(&node_min, &node_max);
+            if(!ray_bbox_intersect(ray_origin, inv_dir, node_min, node_max, nearest_dist, &enter_dist)) {
+                continue;
+            }
+            node_heap.push_back(node_dist_t(child, enter_dist));
+            std::push_heap(node_heap.begin(), node_heap.end(), node_dist_greater_than_t());
         }
-        delete m_nodes[i];
-        m_nodes[i] = NULL;
-        m_child_count--;
     }
+    if(nearest_id == -1) {
+        return false;
+    }
+    if(hit) {
+        hit->m_id   = nearest_id;
+        hit->m_dist = nearest_dist;
+    }
+    return true;
 }
 
-void Octree::prune_empty_nodes()
+bool Octree::raycast_segment(glm::vec3             from,
+                             glm::vec3             to,
+                             RayHit*               hit,
+                             const ray_hit_func_t& hit_func) const
+{
+    float length = glm::distance(from, to);
+    if(length < EPSILON) {
+        return false;
+    }
+    return raycast(from, (to - from) / length, length, hit, hit_func);
+}
+
+void Octree::query_overlaps(glm::vec3 min, glm::vec3 max, std::vector<long>* ids) const
+{
+    glm::vec3 node_min, node_max;
+    get_loose_bbox(&node_min, &node_max);
+    if(!bbox_overlaps_bbox(min, max, node_min, node_max)) {
+        return;
+    }
+    query_overlaps_hier(min, max, ids);
+}
+
+// tight: a box only meets boxes in its own node and below, so ancestors never need revisiting
+// loose: neighboring nodes' loose bboxes overlap, so every box looks through the whole tree
+void Octree::all_overlapping_pairs(std::vector<std::pair<long, long> >* pairs) const
+{
+    std::vector<long> overlap_ids;
+    all_overlapping_pairs_hier((m_root->m_looseness == 1) ? NULL : this, pairs, &overlap_ids);
+}
+
+bool Octree::set_looseness(float looseness)
+{
+    if(!is_root() || looseness < 1 || m_root->m_box_index.size()) {
+        return false;
+    }
+    m_root->m_looseness = looseness;
+    return true;
+}
+
+std::string Octree::get_name() const
+{
+    std::stringstream ss;
+    ss << (m_parent ? m_parent->get_name() + "." : "");
+    if(m_index == -1) {
+        ss << "<root>";
+    } else {
+        ss << m_index;
+    }
+    return ss.str();
+}
+
+void Octree::dump() const
 {
+    static size_t indent = 0;
+    std::string indent_str = std::string(indent, '\t');
+    std::cout << indent_str << this << std::endl;
+    std::cout << indent_str << "name: "    << get_name()  << std::endl;
+    std::cout << indent_str << "depth: "   << get_depth() << std::endl;
+    std::cout << indent_str << "is_root: " << is_root()   << std::endl;
+    std::cout << indent_str << "is_leaf: " << is_leaf()   << std::endl;
+    std::cout << indent_str << "parent: "  << m_parent    << std::endl;
+    std::cout << indent_str << "root: "    << get_root()  << std::endl;
+    std::cout << std::endl;
+    indent++;
     for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
-        }
-        m_nodes[i]->prune_empty_nodes();
-        if(!m_nodes[i]->is_leaf() || m_nodes[i]->get_leaf_object_count()) {
+        Octree* node = get_node(i);
+        if(!node) {
             continue;
         }
-        delete m_nodes[i];
-        m_nodes[i] = NULL;
-        m_child_count--;
+        node->dump();
     }
+    indent--;
 }
 
-bool Octree::insert(long id, glm::vec3 pos)
+bool Octree::insert_hier(long id, glm::vec3 pos, float mass)
 {
     if(is_leaf()) { // if leaf
-        if((m_leaf_objects.size() < NODE_CAPACITY || m_depth > DEPTH_LIMIT)) { // if leaf and there's still room or we've reached depth limit
-            if(m_leaf_objects.find(id) != m_leaf_objects.end()) { // object already added?
+        if(static_cast<int>(m_leaf_ids.size()) < m_root->m_config.m_node_capacity || m_depth > m_root->m_config.m_depth_limit) { // if leaf and there's still room or we've reached depth limit
+            if(find_leaf_object(id) != -1) { // object already added?
                 return false;
             }
-            m_leaf_objects.insert(std::pair<long, glm::vec3>(id, pos)); // add object to leaf
+            push_leaf_object(id, pos, mass); // add object to leaf
+            m_root->m_leaf_index[id] = this;
             return true;
         }
         // create sub-nodes and copy leaf contents to sub-nodes
-        for(std::map<long, glm::vec3>::iterator p = m_leaf_objects.begin(); p != m_leaf_objects.end(); p++) {
-            long      _id  = (*p).first;
-            glm::vec3 _pos = (*p).second;
+        ADD_STAT(OCTREE_STAT_SPLITS, 1);
+        for(int i = 0; i < static_cast<int>(m_leaf_ids.size()); i++) {
+            long      _id   = m_leaf_ids[i];
+            glm::vec3 _pos  = get_leaf_position(i);
+            float     _mass = m_leaf_masses[i];
             Octree* node = alloc_octant(_pos);
             if(!node) {
                 continue;
             }
-            node->insert(_id, _pos);
+            node->insert_hier(_id, _pos, _mass);
         }
-        m_leaf_objects.clear(); // purge leaf contents
+        clear_leaf_objects(); // purge leaf contents
     }
     Octree* node = alloc_octant(pos);
-    if(!node || !node->insert(id, pos)) { // add object to including node
+    if(!node || !node->insert_hier(id, pos, mass)) { // add object to including node
         return false;
     }
     return true;
 }
 
-bool Octree::remove(long id)
+// sink box into the smallest node whose loose bbox encloses it, following the octant of its center
+// stops at leaves that hold objects (those aren't split for a box)
+void Octree::insert_box_hier(long id, glm::vec3 min, glm::vec3 max)
 {
-    if(is_leaf()) {
-        std::map<long, glm::vec3>::iterator p = m_leaf_objects.find(id);
-        if(p == m_leaf_objects.end()) {
-            return false;
+    glm::vec3 center    = (min + max) * 0.5f;
+    float     looseness = m_root->m_looseness;
+    Octree*   node      = this;
+    while(node->m_depth <= m_root->m_config.m_depth_limit && (!node->is_leaf() || node->m_leaf_ids.empty())) {
+        int octant_index = node->get_octant_index(center);
+        glm::vec3 points[8];
+        glm::vec3 half_dim = node->m_dim * 0.5f;
+        vt::PrimitiveFactory::get_box_corners(points, &node->m_origin, &half_dim);
+        glm::vec3 child_min, child_max;
+        loose_bbox(points[octant_index], half_dim, looseness, &child_min, &child_max);
+        if(!bbox_within_bbox(min, max, child_min, child_max)) {
+            break;
+        }
+        node = node->alloc_octant_index(octant_index);
+    }
+    node->m_box_ids.push_back(id);
+    node->m_box_mins.push_back(min);
+    node->m_box_maxs.push_back(max);
+    m_root->m_box_index[id] = node;
+}
+
+// caller already checked bbox against this node's loose bbox
+void Octree::query_overlaps_hier(glm::vec3 min, glm::vec3 max, std::vector<long>* ids) const
+{
+    for(int i = 0; i < static_cast<int>(m_box_ids.size()); i++) {
+        if(bbox_overlaps_bbox(min, max, m_box_mins[i], m_box_maxs[i])) {
+            ids->push_back(m_box_ids[i]);
         }
-        m_leaf_objects.erase(p); // remove core action
-        return true;
     }
     for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
+        const Octree* node = get_node(i);
+        if(!node) {
             continue;
         }
-        if(m_nodes[i]->remove(id)) {
-            return true;
+        glm::vec3 node_min, node_max;
+        node->get_loose_bbox(&node_min, &node_max);
+        if(bbox_overlaps_bbox(min, max, node_min, node_max)) {
+            node->query_overlaps_hier(min, max, ids);
         }
     }
-    return false;
 }
 
-int Octree::find(glm::vec3          target,
-                 int                k,
-                 std::vector<long>* nearest_k_vec,
-                 float              radius) const
+// query_node: where each box looks for its partners (NULL for its own node and below)
+void Octree::all_overlapping_pairs_hier(const Octree*                        query_node,
+                                        std::vector<std::pair<long, long> >* pairs,
+                                        std::vector<long>*                   overlap_ids) const
 {
-    std::priority_queue<id_dist_t, std::vector<id_dist_t>, id_dist_less_than_t> nearest_k_pq;
-    find_hier(target, k, &nearest_k_pq, true, radius);
+    for(int i = 0; i < static_cast<int>(m_box_ids.size()); i++) {
+        long      id  = m_box_ids[i];
+        glm::vec3 min = m_box_mins[i];
+        glm::vec3 max = m_box_maxs[i];
+        overlap_ids->clear();
+        if(query_node) {
+            query_node->query_overlaps(min, max, overlap_ids);
+            for(std::vector<long>::iterator p = overlap_ids->begin(); p != overlap_ids->end(); p++) {
+                if(id < *p) { // each pair (and not self) once
+                    pairs->push_back(std::pair<long, long>(id, *p));
+                }
+            }
+            continue;
+        }
 
-    // reverse order and copy k elements into more friendly container
-    int i = nearest_k_pq.size() - 1;
-    while(nearest_k_pq.size()) {
-        if(i < k) {
-            nearest_k_vec->insert(nearest_k_vec->begin(), nearest_k_pq.top().first);
+        // against the rest of this node, then everything below it
+        for(int j = i + 1; j < static_cast<int>(m_box_ids.size()); j++) {
+            if(bbox_overlaps_bbox(min, max, m_box_mins[j], m_box_maxs[j])) {
+                overlap_ids->push_back(m_box_ids[j]);
+            }
+        }
+        for(int j = 0; j < 8; j++) {
+            const Octree* node = get_node(j);
+            if(node) {
+                node->query_overlaps(min, max, overlap_ids);
+            }
+        }
+        for(std::vector<long>::iterator p = overlap_ids->begin(); p != overlap_ids->end(); p++) {
+            pairs->push_back(std::pair<long, long>(std::min(id, *p), std::max(id, *p)));
         }
-        nearest_k_pq.pop();
-        i--;
     }
-
-    // return actual result size
-    return nearest_k_vec->size();
-}
-
-void Octree::find_hier(glm::vec3                                                                    target,
-                       int                                                                          k,
-                       std::priority_queue<id_dist_t, std::vector<id_dist_t>, id_dist_less_than_t>* nearest_k_pq,
-                       bool                                                                         is_direct_lineage,
-                       float                                                                        radius) const
-{
-    // apply early prune near root; theoretically efficient, in practice very expensive
-    if(m_depth <= EARLY_PRUNE_LEVELS) {
-        TransformObject transform_object("", m_origin);
-        if(!BBoxObject(glm::vec3(0), m_dim).is_sphere_collide(&transform_object,
-                                                              target,
-                                                              radius))
-        {
-            return;
+    for(int i = 0; i < 8; i++) {
+        const Octree* node = get_node(i);
+        if(node) {
+            node->all_overlapping_pairs_hier(query_node, pairs, overlap_ids);
         }
     }
+}
 
-    //==========
-    // leaf node
-    //==========
-
-    if(is_leaf()) {
-        for(std::map<long, glm::vec3>::const_iterator p = m_leaf_objects.begin(); p != m_leaf_objects.end(); p++) {
-            long      id  = (*p).first;
-            glm::vec3 pos = (*p).second;
-            if(radius > 0 && glm::distance(pos, target) > radius) { // apply radius filter
+bool Octree::build_hier(const MortonObject* begin, const MortonObject* end, int level)
+{
+    if(end - begin <= m_root->m_config.m_node_capacity || m_depth > m_root->m_config.m_depth_limit || level >= MORTON_LEVELS) {
+        bool inserted_all = true;
+        for(const MortonObject* p = begin; p != end; p++) {
+            Octree*& leaf = m_root->m_leaf_index[p->m_id];
+            if(leaf) { // object already added?
+                inserted_all = false;
                 continue;
             }
-            nearest_k_pq->push(id_dist_t(id, glm::distance(pos, target))); // record ALL visited objects (filtered)
+            push_leaf_object(p->m_id, p->m_pos, 0);
+            leaf = this;
         }
-        return;
+        return inserted_all;
     }
 
-    //==============
-    // internal node
-    //==============
-
-    int octant_index = get_octant_index(target);
-    if(octant_index == -1) {
-        return;
+    // split sorted range into runs sharing the same morton digit at this level
+    bool inserted_all = true;
+    int shift = 3 * (MORTON_LEVELS - 1 - level);
+    const MortonObject* p = begin;
+    while(p != end) {
+        int digit = (p->m_code >> shift) & 7;
+        const MortonObject* q = p;
+        while(q != end && static_cast<int>((q->m_code >> shift) & 7) == digit) {
+            q++;
+        }
+        inserted_all &= alloc_octant_index(morton_digit_to_octant_index[digit])->build_hier(p, q, level + 1);
+        p = q;
     }
+    return inserted_all;
+}
 
-    // search best-candidate octant
-    if(m_nodes[octant_index]) {
-        m_nodes[octant_index]->find_hier(target, k, nearest_k_pq, is_direct_lineage, radius);
+void Octree::reset(glm::vec3 origin,
+                   glm::vec3 dim,
+                   int       index,
+                   int       depth,
+                   Octree*   parent)
+{
+    m_origin         = origin;
+    m_dim            = dim;
+    m_center         = origin + dim * 0.5f;
+    m_index          = index;
+    m_depth          = depth;
+    m_parent         = parent;
+    m_child_count    = 0;
+    m_mass           = 0;
+    m_center_of_mass = m_center;
+    m_generation++;
+    for(int i = 0; i < 3; i++) {
+        m_mass_moment[i] = 0;
     }
-
-    // stop here if best-candidate octant results sufficient
-
-    // conditions for searching sibling octants:
-    // * collecting fewer than k objects from within the best-candidate octant sub-tree
-    // * farthest object distance within best-candidate octant exceeds nearest wall distance (automatically true if not direct lineage)
-
-    // consider a quadtree search for k nearest neighbors with k == 2 and query points X, Y, and Z
-    // * query point X is closer to the nearest wall than to A in the including quadrant, warranting a search within sibling quadrants
-    // * query point Y is closer to C in the including quadrant than to the nearest wall
-    //   however, C alone is not enough to satisfy the k == 2 requirement, warranting a search within sibling quadrants
-    // * query point Z is closer to D and E in the including quadrant than to the nearest wall, satisfying the k == 2 requirement
-    //   therefore, this no longer warrants a search within sibling quadrants
-    //
-    // NOTE: when searching within sibling quadrants, any found objects are inherently farther from the original query point than the nearest wall
-    //       stop here if sibling quadrant results insufficient
-    //
-    // +---------------+---------------+
-    // |               |               |
-    // |               |               |
-    // |               |               |
-    // |               |               |
-    // |               |               |
-    // |               |               |
-    // |               |               |
-    // +---------------+-------+-------+
-    // |               |       |       |
-    // |               |   Z   |   Y   |
-    // |               | D   E | C     |
-    // |               +-------+-------+
-    // |               |       | X     |
-    // |               |       |       |
-    // |               |       |     A |
-    // +---------------+-------+-------+
-
-    // get nearest wall distance
-    float nearest_wall_distance = BIG_NUMBER;
-    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.x - m_origin.x)));
-    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.y - m_origin.y)));
-    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.z - m_origin.z)));
-    glm::vec3 opposite = m_origin + m_dim;
-    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.x - opposite.x)));
-    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.y - opposite.y)));
-    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.z - opposite.z)));
-
-    float farthest_object_distance = nearest_k_pq->size() ? nearest_k_pq->top().second : 0;
-    bool should_search_siblings = !is_direct_lineage || (farthest_object_distance > nearest_wall_distance);
-    if(static_cast<int>(nearest_k_pq->size()) >= k && !should_search_siblings) {
-        return;
+    for(int i = 0; i < 8; i++) {
+        m_nodes[i] = -1;
     }
+}
 
-    // search sibling octants
-    for(int i = 0; i < 8; i++) {
-        if(i == octant_index) { // skip best-candidate octant (already searched)
-            continue;
+Octree* Octree::Root::alloc_node(glm::vec3 origin,
+                                 glm::vec3 dim,
+                                 int       index,
+                                 int       depth,
+                                 Octree*   parent)
+{
+    // out of released nodes: double the pool, constructing every new node up front, so that once warmed up a node
+    // count drifting above its earlier peak finds spare nodes instead of allocating
+    if(m_pool_free_list.empty()) {
+        int block_count = std::max(static_cast<int>(m_pool_blocks.size()), 1);
+        m_pool_free_list.reserve((m_pool_blocks.size() + block_count) * POOL_BLOCK_SIZE); // so releasing nodes never allocates
+        for(int i = 0; i < block_count; i++) {
+            m_pool_blocks.push_back(static_cast<Octree*>(::operator new(sizeof(Octree) * POOL_BLOCK_SIZE)));
+            for(int j = 0; j < POOL_BLOCK_SIZE; j++) {
+                Octree* node = new (&m_pool_blocks.back()[j]) Octree(origin, dim, index, depth, parent, this);
+                node->m_pool_index = m_pool_size++;
+            }
         }
-        if(m_nodes[i]) {
-            m_nodes[i]->find_hier(target, k, nearest_k_pq, false, radius);
+        for(int i = m_pool_size - 1; i >= m_pool_size - block_count * POOL_BLOCK_SIZE; i--) {
+            m_pool_free_list.push_back(i); // lowest index handed out first
         }
     }
+
+    // recycle released node (keeps its leaf buffers' capacity)
+    Octree* node = get_pool_node(m_pool_free_list.back());
+    m_pool_free_list.pop_back();
+    node->reset(origin, dim, index, depth, parent);
+    return node;
 }
 
-bool Octree::exists(long id)
+void Octree::Root::free_node(Octree* node)
 {
-    if(is_leaf()) {
-        std::map<long, glm::vec3>::iterator p = m_leaf_objects.find(id);
-        if(p != m_leaf_objects.end()) {
-            return true; // find core action
+    node->clear_nodes();
+    node->m_generation++; // invalidate hints pointing here
+    m_pool_free_list.push_back(node->m_pool_index);
+}
+
+Octree* Octree::Root::get_pool_node(int pool_index) const
+{
+    return &m_pool_blocks[pool_index / POOL_BLOCK_SIZE][pool_index % POOL_BLOCK_SIZE];
+}
+
+int Octree::find_leaf_object(long id) const
+{
+    for(int i = 0; i < static_cast<int>(m_leaf_ids.size()); i++) {
+        if(m_leaf_ids[i] == id) {
+            return i;
         }
-        return false;
     }
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
-        }
-        if(m_nodes[i]->exists(id)) {
-            return true;
-        }
+    return -1;
+}
+
+void Octree::remove_leaf_object(int slot)
+{
+    float mass = m_leaf_masses[slot];
+    if(mass) {
+        add_mass_hier(-mass, get_leaf_position(slot) * -mass);
     }
-    return false;
+
+    // swap with last and pop (order within leaf doesn't matter)
+    m_leaf_ids[slot]    = m_leaf_ids.back();
+    m_leaf_xs[slot]     = m_leaf_xs.back();
+    m_leaf_ys[slot]     = m_leaf_ys.back();
+    m_leaf_zs[slot]     = m_leaf_zs.back();
+    m_leaf_masses[slot] = m_leaf_masses.back();
+    m_leaf_ids.pop_back();
+    m_leaf_xs.pop_back();
+    m_leaf_ys.pop_back();
+    m_leaf_zs.pop_back();
+    m_leaf_masses.pop_back();
 }
 
-bool Octree::move(long id, glm::vec3 pos)
+void Octree::push_leaf_object(long id, glm::vec3 pos, float mass)
 {
-    if(is_leaf()) {
-        std::map<long, glm::vec3>::iterator p = m_leaf_objects.find(id);
-        if(p != m_leaf_objects.end()) {
-            (*p).second = pos; // move core action
-            return true;
+    // leaves at the depth limit outgrow node capacity; raise the high-water mark for every node (with headroom),
+    // so whichever node ends up holding that many next time already has room
+    if(m_leaf_ids.size() == m_leaf_ids.capacity()) {
+        m_root->m_leaf_capacity = std::max(m_root->m_leaf_capacity, static_cast<int>(m_leaf_ids.size()) * 2);
+        m_root->m_node->reserve_leaf_objects(m_root->m_leaf_capacity);
+        for(int i = 0; i < m_root->m_pool_size; i++) {
+            m_root->get_pool_node(i)->reserve_leaf_objects(m_root->m_leaf_capacity);
         }
-        return false;
     }
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
-        }
-        if(m_nodes[i]->move(id, pos)) {
-            return true;
-        }
+    m_leaf_ids.push_back(id);
+    m_leaf_xs.push_back(pos.x);
+    m_leaf_ys.push_back(pos.y);
+    m_leaf_zs.push_back(pos.z);
+    m_leaf_masses.push_back(mass);
+    if(mass) {
+        add_mass_hier(mass, pos * mass);
     }
-    return false;
 }
 
-bool Octree::rebalance()
+void Octree::reserve_leaf_objects(int capacity)
 {
-    bool changed = false;
-    if(is_leaf()) {
-        std::vector<long> remove_vec;
-        for(std::map<long, glm::vec3>::iterator p = m_leaf_objects.begin(); p != m_leaf_objects.end(); p++) {
-            long      id  = (*p).first;
-            glm::vec3 pos = (*p).second;
-            if(!within_bbox(pos)) {
-                remove_vec.push_back(id);
-            }
-        }
-        for(std::vector<long>::iterator q = remove_vec.begin(); q != remove_vec.end(); q++) {
-            long id = *q;
-            std::map<long, glm::vec3>::iterator r = m_leaf_objects.find(id);
-            if(r == m_leaf_objects.end()) {
-                continue;
-            }
-
-            // remove from subtree
-            if(!remove(id)) {
-                continue;
-            }
-
-            // add back to first including parent node
-            glm::vec3 pos = (*r).second;
-            Octree* node = first_including_parent_node(pos);
-            if(node) {
-                if(!node->insert(id, pos)) {
-                    continue;
-                }
-            }
+    m_leaf_ids.reserve(capacity);
+    m_leaf_xs.reserve(capacity);
+    m_leaf_ys.reserve(capacity);
+    m_leaf_zs.reserve(capacity);
+    m_leaf_masses.reserve(capacity);
+}
 
-            changed = true;
-        }
-        return changed;
-    }
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
-        }
-        changed |= m_nodes[i]->rebalance();
+void Octree::clear_leaf_objects()
+{
+    double    mass = 0;
+    glm::vec3 mass_moment;
+    for(int i = 0; i < static_cast<int>(m_leaf_ids.size()); i++) {
+        mass        += m_leaf_masses[i];
+        mass_moment += get_leaf_position(i) * m_leaf_masses[i];
     }
-    if(is_root()) {
-        prune_empty_nodes();
+    if(mass) {
+        add_mass_hier(-mass, -mass_moment);
     }
-    return changed;
+    m_leaf_ids.clear();
+    m_leaf_xs.clear();
+    m_leaf_ys.clear();
+    m_leaf_zs.clear();
+    m_leaf_masses.clear();
 }
 
-std::string Octree::get_name() const
+// this node and every ancestor
+void Octree::add_mass_hier(double mass, glm::vec3 mass_moment)
 {
-    std::stringstream ss;
-    ss << (m_parent ? m_parent->get_name() + "." : "");
-    if(m_index == -1) {
-        ss << "<root>";
-    } else {
-        ss << m_index;
+    for(Octree* node = this; node; node = node->m_parent) {
+        node->m_mass           += mass;
+        node->m_mass_moment[0] += mass_moment.x;
+        node->m_mass_moment[1] += mass_moment.y;
+        node->m_mass_moment[2] += mass_moment.z;
+        if(node->m_mass > 0) {
+            node->m_center_of_mass = glm::vec3(node->m_mass_moment[0] / node->m_mass,
+                                               node->m_mass_moment[1] / node->m_mass,
+                                               node->m_mass_moment[2] / node->m_mass);
+        }
     }
-    return ss.str();
 }
 
-void Octree::dump() const
+int Octree::find_box(long id) const
 {
-    static size_t indent = 0;
-    std::string indent_str = std::string(indent, '\t');
-    std::cout << indent_str << this << std::endl;
-    std::cout << indent_str << "name: "    << get_name()  << std::endl;
-    std::cout << indent_str << "depth: "   << get_depth() << std::endl;
-    std::cout << indent_str << "is_root: " << is_root()   << std::endl;
-    std::cout << indent_str << "is_leaf: " << is_leaf()   << std::endl;
-    std::cout << indent_str << "parent: "  << m_parent    << std::endl;
-    std::cout << indent_str << "root: "    << m_root      << std::endl;
-    std::cout << std::endl;
-    indent++;
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
+    for(int i = 0; i < static_cast<int>(m_box_ids.size()); i++) {
+        if(m_box_ids[i] == id) {
+            return i;
         }
-        m_nodes[i]->dump();
     }
-    indent--;
+    return -1;
+}
+
+void Octree::remove_box_slot(int slot)
+{
+    m_box_ids[slot]  = m_box_ids.back();
+    m_box_mins[slot] = m_box_mins.back();
+    m_box_maxs[slot] = m_box_maxs.back();
+    m_box_ids.pop_back();
+    m_box_mins.pop_back();
+    m_box_maxs.pop_back();
+}
+
+// leaf holding no objects or boxes
+bool Octree::is_empty() const
+{
+    return is_leaf() && m_leaf_ids.empty() && m_box_ids.empty();
 }
 
 Octree* Octree::alloc_octant(glm::vec3 pos)
@@ -393,14 +1660,20 @@ Octree* Octree::alloc_octant(glm::vec3 pos)
     if(octant_index == -1) {
         return NULL;
     }
-    if(!m_nodes[octant_index]) {
+    return alloc_octant_index(octant_index);
+}
+
+Octree* Octree::alloc_octant_index(int octant_index)
+{
+    if(m_nodes[octant_index] == -1) {
         glm::vec3 points[8];
         glm::vec3 half_dim = m_dim * 0.5f;
         vt::PrimitiveFactory::get_box_corners(points, &m_origin, &half_dim);
-        m_nodes[octant_index] = new Octree(points[octant_index], half_dim, octant_index, m_depth + 1, this, m_root);
+        Octree* node = m_root->alloc_node(points[octant_index], half_dim, octant_index, m_depth + 1, this);
+        m_nodes[octant_index] = node->m_pool_index;
         m_child_count++;
     }
-    return m_nodes[octant_index];
+    return get_node(octant_index);
 }
 
 Octree* Octree::first_including_parent_node(glm::vec3 pos)
@@ -464,6 +1737,18 @@ int Octree::get_octant_index(glm::vec3 pos) const
     return -1;
 }
 
+float Octree::min_distance2(glm::vec3 pos) const
+{
+    glm::vec3 offset = pos - glm::clamp(pos, m_origin, m_origin + m_dim);
+    return glm::dot(offset, offset);
+}
+
+float Octree::min_distance2(glm::vec3 min, glm::vec3 max) const
+{
+    glm::vec3 gap = glm::max(glm::max(m_origin - max, min - (m_origin + m_dim)), glm::vec3(0));
+    return glm::dot(gap, gap);
+}
+
 bool Octree::within_bbox(glm::vec3 pos) const
 {
     glm::vec3 min = m_origin;
@@ -473,4 +1758,27 @@ bool Octree::within_bbox(glm::vec3 pos) const
            (min.z <= pos.z && pos.z <= max.z);
 }
 
+void Octree::get_loose_bbox(glm::vec3* min, glm::vec3* max) const
+{
+    loose_bbox(m_origin, m_dim, m_root->m_looseness, min, max);
+}
+
+bool Octree::within_loose_bbox(glm::vec3 min, glm::vec3 max) const
+{
+    glm::vec3 loose_min, loose_max;
+    get_loose_bbox(&loose_min, &loose_max);
+    return bbox_within_bbox(min, max, loose_min, loose_max);
+}
+
+// sphere (pos, sqrt(radius2)) entirely inside bbox
+bool Octree::within_bbox(glm::vec3 pos, float radius2) const
+{
+    if(!within_bbox(pos)) {
+        return false;
+    }
+    glm::vec3 wall_dist = glm::min(pos - m_origin, m_origin + m_dim - pos);
+    float nearest_wall_dist = std::min(std::min(wall_dist.x, wall_dist.y), wall_dist.z);
+    return nearest_wall_dist * nearest_wall_dist >= radius2;
+}
+
 }
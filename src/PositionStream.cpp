@@ -0,0 +1,100 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <PositionStream.h>
+#include <glm/glm.hpp>
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+namespace vt {
+
+PositionStream::PositionStream(int object_count)
+    : m_object_count(object_count)
+{
+}
+
+int PositionStream::get_frame_count() const
+{
+    if(!m_object_count) {
+        return 0;
+    }
+    return m_positions.size() / m_object_count;
+}
+
+const glm::vec3* PositionStream::get_frame(int frame) const
+{
+    if(frame < 0 || frame >= get_frame_count()) {
+        return NULL;
+    }
+    return &m_positions[frame * m_object_count];
+}
+
+void PositionStream::add_frame(const glm::vec3* positions)
+{
+    m_positions.insert(m_positions.end(), positions, positions + m_object_count);
+}
+
+void PositionStream::clear(int object_count)
+{
+    m_object_count = object_count;
+    m_positions.clear();
+}
+
+bool PositionStream::load(std::string filename)
+{
+    FILE* stream = fopen(filename.c_str(), "rb");
+    if(!stream) {
+        return false;
+    }
+    int32_t header[2];
+    if(fread(header, sizeof(int32_t), 2, stream) != 2 || header[0] < 0 || header[1] < 0) {
+        fclose(stream);
+        return false;
+    }
+    std::vector<float> values(static_cast<size_t>(header[0]) * header[1] * 3);
+    if(fread(values.empty() ? NULL : &values[0], sizeof(float), values.size(), stream) != values.size()) {
+        fclose(stream);
+        return false;
+    }
+    fclose(stream);
+    clear(header[0]);
+    m_positions.resize(values.size() / 3);
+    for(int i = 0, n = m_positions.size(); i < n; i++) {
+        m_positions[i] = glm::vec3(values[i * 3], values[i * 3 + 1], values[i * 3 + 2]);
+    }
+    return true;
+}
+
+bool PositionStream::save(std::string filename) const
+{
+    FILE* stream = fopen(filename.c_str(), "wb");
+    if(!stream) {
+        return false;
+    }
+    int32_t header[2] = {m_object_count, get_frame_count()};
+    bool success = fwrite(header, sizeof(int32_t), 2, stream) == 2;
+    for(std::vector<glm::vec3>::const_iterator p = m_positions.begin(); success && p != m_positions.end(); p++) {
+        float values[3] = {(*p).x, (*p).y, (*p).z};
+        success = fwrite(values, sizeof(float), 3, stream) == 3;
+    }
+    fclose(stream);
+    return success;
+}
+
+}
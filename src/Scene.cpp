@@ -35,6 +35,7 @@
 #include <map>
 #include <algorithm>
 #include <iterator>
+#include <sstream>
 #include <stdlib.h>
 
 #define NUM_LIGHTS              8
@@ -44,6 +45,7 @@
 #define LIGHT_RADIUS            0.125
 #define TARGET_RADIUS           0.125
 #define TARGETS_RADIUS          0.0625
+#define HUD_LINE_PIXELS         22 // GLUT_BITMAP_HELVETICA_18 line pitch
 
 #define BROKEN_EDGE_ALPHA 0.125f
 
@@ -1093,6 +1095,18 @@ void Scene::render_lines_and_text(bool  draw_guide_wires,
         glColor3f(1, 1, 1);
         glRasterPos2f(0, 0);
         print_bitmap_string(GLUT_BITMAP_HELVETICA_18, hud_text);
+        if(m_octree) {
+            // one counter per line below the hud text
+            float line_height = (half_height / 0.45) * HUD_LINE_PIXELS / dim.y;
+            for(int i = 0; i < OCTREE_STAT_COUNT; i++) {
+                octree_stat_t stat = static_cast<octree_stat_t>(i);
+                std::stringstream ss;
+                ss << Octree::get_stat_name(stat) << ": " << m_octree->get_stat(stat);
+                glLoadMatrixf(glm::value_ptr(glm::translate(glm::mat4(1), glm::vec3(-half_width, half_height - line_height * (i + 1), 0)) * m_camera->get_transform()));
+                glRasterPos2f(0, 0);
+                print_bitmap_string(GLUT_BITMAP_HELVETICA_18, ss.str().c_str());
+            }
+        }
         glPopMatrix();
     }
 
@@ -1114,4 +1128,26 @@ void Scene::render_lights() const
     glPopMatrix();
 }
 
+// straight from client memory, nothing uploaded or kept per point
+void Scene::render_points(const glm::vec3* points, size_t count, glm::vec3 color, float point_size) const
+{
+    if(!points || !count) {
+        return;
+    }
+    glUseProgram(0);
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(glm::value_ptr(m_camera->get_projection_transform()));
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadMatrixf(glm::value_ptr(m_camera->get_transform()));
+    glPointSize(point_size);
+    glColor3f(color.r, color.g, color.b);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(glm::vec3), points);
+    glDrawArrays(GL_POINTS, 0, count);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glPointSize(1);
+    glPopMatrix();
+}
+
 }
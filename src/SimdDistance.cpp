@@ -0,0 +1,187 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <SimdDistance.h>
+#include <glm/glm.hpp>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define SIMD_X86 1
+#endif
+
+namespace vt {
+
+typedef void (*distance2_soa_func_t)(const float* xs,
+                                     const float* ys,
+                                     const float* zs,
+                                     int          count,
+                                     glm::vec3    target,
+                                     float*       dist2);
+
+static void distance2_soa_scalar(const float* xs,
+                                 const float* ys,
+                                 const float* zs,
+                                 int          count,
+                                 glm::vec3    target,
+                                 float*       dist2)
+{
+    for(int i = 0; i < count; i++) {
+        float dx = xs[i] - target.x;
+        float dy = ys[i] - target.y;
+        float dz = zs[i] - target.z;
+        dist2[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+#ifdef SIMD_X86
+// 4 points per instruction
+__attribute__((target("sse2")))
+static void distance2_soa_sse(const float* xs,
+                              const float* ys,
+                              const float* zs,
+                              int          count,
+                              glm::vec3    target,
+                              float*       dist2)
+{
+    __m128 tx = _mm_set1_ps(target.x);
+    __m128 ty = _mm_set1_ps(target.y);
+    __m128 tz = _mm_set1_ps(target.z);
+    int i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), tx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), ty);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(zs + i), tz);
+        _mm_storeu_ps(dist2 + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+    }
+    distance2_soa_scalar(xs + i, ys + i, zs + i, count - i, target, dist2 + i);
+}
+
+// 8 points per instruction
+__attribute__((target("avx")))
+static void distance2_soa_avx(const float* xs,
+                              const float* ys,
+                              const float* zs,
+                              int          count,
+                              glm::vec3    target,
+                              float*       dist2)
+{
+    __m256 tx = _mm256_set1_ps(target.x);
+    __m256 ty = _mm256_set1_ps(target.y);
+    __m256 tz = _mm256_set1_ps(target.z);
+    int i = 0;
+    for(; i + 8 <= count; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), tx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), ty);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(zs + i), tz);
+        _mm256_storeu_ps(dist2 + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+    }
+    if(i == count) {
+        return;
+    }
+
+    // masked tail, so small leaves stay in one pass without switching back to sse
+    static const int mask_table[16] = {-1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+    __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask_table + 8 - (count - i)));
+    __m256  dx   = _mm256_sub_ps(_mm256_maskload_ps(xs + i, mask), tx);
+    __m256  dy   = _mm256_sub_ps(_mm256_maskload_ps(ys + i, mask), ty);
+    __m256  dz   = _mm256_sub_ps(_mm256_maskload_ps(zs + i, mask), tz);
+    _mm256_maskstore_ps(dist2 + i, mask, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+}
+#endif
+
+bool is_simd_isa_supported(simd_isa_t isa)
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init(); // may run from a static initializer, before libgcc sets up cpu features
+#endif
+    switch(isa) {
+        case SIMD_ISA_SCALAR:
+            return true;
+#ifdef SIMD_X86
+        case SIMD_ISA_SSE:
+            return __builtin_cpu_supports("sse2");
+        case SIMD_ISA_AVX:
+            return __builtin_cpu_supports("avx");
+#endif
+        default:
+            return false;
+    }
+}
+
+static simd_isa_t get_best_simd_isa()
+{
+    if(is_simd_isa_supported(SIMD_ISA_AVX)) {
+        return SIMD_ISA_AVX;
+    }
+    if(is_simd_isa_supported(SIMD_ISA_SSE)) {
+        return SIMD_ISA_SSE;
+    }
+    return SIMD_ISA_SCALAR;
+}
+
+static distance2_soa_func_t get_distance2_soa_func(simd_isa_t isa)
+{
+    switch(isa) {
+#ifdef SIMD_X86
+        case SIMD_ISA_SSE:
+            return distance2_soa_sse;
+        case SIMD_ISA_AVX:
+            return distance2_soa_avx;
+#endif
+        default:
+            return distance2_soa_scalar;
+    }
+}
+
+static simd_isa_t           simd_isa           = get_best_simd_isa();
+static distance2_soa_func_t distance2_soa_func = get_distance2_soa_func(simd_isa);
+
+void distance2_soa(const float* xs,
+                   const float* ys,
+                   const float* zs,
+                   int          count,
+                   glm::vec3    target,
+                   float*       dist2)
+{
+    distance2_soa_func(xs, ys, zs, count, target, dist2);
+}
+
+simd_isa_t get_simd_isa()
+{
+    return simd_isa;
+}
+
+bool set_simd_isa(simd_isa_t isa)
+{
+    if(!is_simd_isa_supported(isa)) {
+        return false;
+    }
+    simd_isa           = isa;
+    distance2_soa_func = get_distance2_soa_func(isa);
+    return true;
+}
+
+const char* get_simd_isa_name(simd_isa_t isa)
+{
+    switch(isa) {
+        case SIMD_ISA_SCALAR: return "scalar";
+        case SIMD_ISA_SSE:    return "sse";
+        case SIMD_ISA_AVX:    return "avx";
+    }
+    return "";
+}
+
+}
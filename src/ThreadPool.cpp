@@ -0,0 +1,113 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ThreadPool.h>
+#include <algorithm>
+
+#define CHUNKS_PER_THREAD 8 // smaller chunks balance uneven work better
+
+namespace vt {
+
+ThreadPool::ThreadPool(int thread_count)
+    : m_range_func(NULL),
+      m_count(0),
+      m_grain_size(1),
+      m_next_index(0),
+      m_busy_thread_count(0),
+      m_job_generation(0),
+      m_is_stopping(false)
+{
+    if(thread_count <= 0) {
+        thread_count = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+    for(int i = 1; i < thread_count; i++) { // caller is the first thread
+        m_threads.push_back(std::thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_stopping = true;
+    }
+    m_work_cond.notify_all();
+    for(std::vector<std::thread>::iterator p = m_threads.begin(); p != m_threads.end(); p++) {
+        (*p).join();
+    }
+}
+
+void ThreadPool::parallel_for(int count, const range_func_t& range_func, int grain_size)
+{
+    if(count <= 0) {
+        return;
+    }
+    if(grain_size <= 0) {
+        grain_size = std::max(count / (get_thread_count() * CHUNKS_PER_THREAD), 1);
+    }
+    if(m_threads.empty() || count <= grain_size) { // not worth waking anyone
+        range_func(0, count);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_range_func        = &range_func;
+        m_count             = count;
+        m_grain_size        = grain_size;
+        m_next_index        = 0;
+        m_busy_thread_count = m_threads.size();
+        m_job_generation++;
+    }
+    m_work_cond.notify_all();
+    run_chunks();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cond.wait(lock, [this]() { return !m_busy_thread_count; });
+    m_range_func = NULL;
+}
+
+void ThreadPool::worker_loop()
+{
+    long seen_job_generation = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_cond.wait(lock, [&]() { return m_is_stopping || m_job_generation != seen_job_generation; });
+            if(m_is_stopping) {
+                return;
+            }
+            seen_job_generation = m_job_generation;
+        }
+        run_chunks();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(!--m_busy_thread_count) {
+            m_done_cond.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run_chunks()
+{
+    while(true) {
+        int begin = m_next_index.fetch_add(m_grain_size);
+        if(begin >= m_count) {
+            return;
+        }
+        (*m_range_func)(begin, std::min(begin + m_grain_size, m_count));
+    }
+}
+
+}
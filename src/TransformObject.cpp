@@ -22,6 +22,7 @@
 #include <glm/gtx/vector_angle.hpp>
 #include <glm/glm.hpp>
 #include <set>
+#include <vector>
 
 //#define DEBUG
 
@@ -61,10 +62,10 @@ void TransformObject::set_origin(glm::vec3 origin)
     mark_dirty_transform();
 }
 
-void TransformObject::set_euler(glm::vec3 euler)
+void TransformObject::set_euler(glm::vec3 euler, const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
 {
     m_euler = euler;
-    apply_joint_constraints();
+    apply_joint_constraints(parent_abs_transform, parent_inverse_transform);
     mark_dirty_transform();
 }
 
@@ -86,8 +87,11 @@ void TransformObject::reset_transform()
 // coordinate system conversions
 //==============================
 
-glm::vec3 TransformObject::in_abs_system(glm::vec3 local_point)
+glm::vec3 TransformObject::in_abs_system(glm::vec3 local_point, const glm::mat4* parent_abs_transform)
 {
+    if(parent_abs_transform) {
+        return glm::vec3(*parent_abs_transform * get_local_transform() * glm::vec4(local_point, 1));
+    }
     return glm::vec3(get_transform() * glm::vec4(local_point, 1));
 }
 
@@ -99,8 +103,11 @@ glm::vec3 TransformObject::in_parent_system(glm::vec3 abs_point) const
     return glm::vec3(glm::inverse(m_parent->get_transform()) * glm::vec4(abs_point, 1));
 }
 
-glm::vec3 TransformObject::from_origin_in_parent_system(glm::vec3 abs_point) const
+glm::vec3 TransformObject::from_origin_in_parent_system(glm::vec3 abs_point, const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform) const
 {
+    if(parent_abs_transform) {
+        return glm::vec3(*parent_inverse_transform * glm::vec4(abs_point, 1)) - m_origin;
+    }
     return in_parent_system(abs_point) - m_origin;
 }
 
@@ -119,8 +126,12 @@ glm::vec3 TransformObject::get_abs_heading()
     return glm::vec3(get_normal_transform() * glm::vec4(VEC_FORWARD, 1));
 }
 
-glm::vec3 TransformObject::get_abs_direction(euler_index_t euler_index)
+glm::vec3 TransformObject::get_abs_direction(euler_index_t euler_index, const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
 {
+    if(parent_abs_transform) {
+        glm::mat4 normal_transform = glm::transpose(get_local_inverse_transform() * *parent_inverse_transform);
+        return glm::vec3(normal_transform * glm::vec4(euler_index_to_axis(euler_index), 1));
+    }
     switch(euler_index) {
         case EULER_INDEX_ROLL:  return get_abs_heading();
         case EULER_INDEX_PITCH: return get_abs_left_direction();
@@ -133,16 +144,16 @@ glm::vec3 TransformObject::get_abs_direction(euler_index_t euler_index)
 // coordinate system operations
 //=============================
 
-void TransformObject::point_at_local(glm::vec3 local_target, glm::vec3* local_up_direction)
+void TransformObject::point_at_local(glm::vec3 local_target, glm::vec3* local_up_direction, const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
 {
-    set_euler(offset_to_euler(local_target, local_up_direction));
+    set_euler(offset_to_euler(local_target, local_up_direction), parent_abs_transform, parent_inverse_transform);
 }
 
-void TransformObject::set_local_rotation_transform(glm::mat4 rotation_transform)
+void TransformObject::set_local_rotation_transform(glm::mat4 rotation_transform, const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
 {
     glm::vec3 local_heading      = glm::vec3(rotation_transform * glm::vec4(VEC_FORWARD, 1));
     glm::vec3 local_up_direction = glm::vec3(rotation_transform * glm::vec4(VEC_UP, 1));
-    point_at_local(local_heading, &local_up_direction);
+    point_at_local(local_heading, &local_up_direction, parent_abs_transform, parent_inverse_transform);
 }
 
 void TransformObject::rotate(glm::mat4 rotation_transform)
@@ -236,7 +247,31 @@ void TransformObject::set_enable_joint_constraints(glm::ivec3 enable_joint_const
     check_roll_hinge();
 }
 
-void TransformObject::apply_hinge_constraints_perpendicular_to_plane_of_free_rotation()
+glm::vec3 TransformObject::get_parent_abs_origin(const glm::mat4* parent_abs_transform)
+{
+    if(parent_abs_transform) {
+        return glm::vec3((*parent_abs_transform)[3]);
+    }
+    return m_parent ? m_parent->in_abs_system() : glm::vec3(0);
+}
+
+glm::mat4 TransformObject::get_parent_abs_transform(const glm::mat4* parent_abs_transform)
+{
+    if(parent_abs_transform) {
+        return *parent_abs_transform;
+    }
+    return m_parent ? m_parent->get_transform() : glm::mat4(1);
+}
+
+glm::vec3 TransformObject::get_parent_abs_direction(euler_index_t euler_index, const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
+{
+    if(parent_abs_transform) {
+        return glm::vec3(glm::transpose(*parent_inverse_transform) * glm::vec4(euler_index_to_axis(euler_index), 1));
+    }
+    return m_parent ? m_parent->get_abs_direction(euler_index) : euler_index_to_axis(euler_index);
+}
+
+void TransformObject::apply_hinge_constraints_perpendicular_to_plane_of_free_rotation(const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
 {
     static bool disable_recursion = false;
     if(!is_hinge() || m_hinge_type == EULER_INDEX_ROLL || disable_recursion) { // NOTE: roll hinge joints too unstable
@@ -244,79 +279,70 @@ void TransformObject::apply_hinge_constraints_perpendicular_to_plane_of_free_rot
     }
     glm::vec3 local_heading;
     glm::vec3 local_up_dir;
-    glm::vec3 parent_plane_origin = m_parent ? m_parent->in_abs_system() : glm::vec3(0);
+    glm::vec3 parent_plane_origin = get_parent_abs_origin(parent_abs_transform);
     if(!m_parent) {
         mark_dirty_transform(); // strangely necessary, otherwise absolute axis endpoints aren't calculated for root
     }
-    glm::vec3 joint_origin                    = in_abs_system();
-    glm::vec3 joint_abs_left_axis_endpoint    = joint_origin + get_abs_left_direction(); // X
-    glm::vec3 joint_abs_up_axis_endpoint      = joint_origin + get_abs_up_direction();   // Y
-    glm::vec3 joint_abs_heading_axis_endpoint = joint_origin + get_abs_heading();        // Z
+    glm::vec3 joint_origin                    = in_abs_system(glm::vec3(0), parent_abs_transform);
+    glm::vec3 joint_abs_left_axis_endpoint    = joint_origin + get_abs_direction(EULER_INDEX_PITCH, parent_abs_transform, parent_inverse_transform); // X
+    glm::vec3 joint_abs_up_axis_endpoint      = joint_origin + get_abs_direction(EULER_INDEX_YAW,   parent_abs_transform, parent_inverse_transform); // Y
+    glm::vec3 joint_abs_heading_axis_endpoint = joint_origin + get_abs_direction(EULER_INDEX_ROLL,  parent_abs_transform, parent_inverse_transform); // Z
     switch(m_hinge_type) {
         case EULER_INDEX_ROLL:
             {
                 // allow ONLY roll -- project onto XY plane
-                glm::vec3 parent_plane_normal                    = m_parent ? m_parent->get_abs_heading() : VEC_FORWARD;                                           // Z
-                glm::vec3 joint_flattened_abs_left_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_left_axis_endpoint); // X
-                glm::vec3 joint_flattened_abs_up_axis_endpoint   = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_up_axis_endpoint);   // Y
-                glm::vec3 local_left_dir                         = from_origin_in_parent_system(joint_flattened_abs_left_axis_endpoint); // X
-                          local_up_dir                           = from_origin_in_parent_system(joint_flattened_abs_up_axis_endpoint);   // Y
-                          local_heading                          = glm::normalize(glm::cross(local_left_dir, local_up_dir));             // Z
+                glm::vec3 parent_plane_normal                    = get_parent_abs_direction(EULER_INDEX_ROLL, parent_abs_transform, parent_inverse_transform);                           // Z
+                glm::vec3 joint_flattened_abs_left_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_left_axis_endpoint);                       // X
+                glm::vec3 joint_flattened_abs_up_axis_endpoint   = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_up_axis_endpoint);                         // Y
+                glm::vec3 local_left_dir                         = from_origin_in_parent_system(joint_flattened_abs_left_axis_endpoint, parent_abs_transform, parent_inverse_transform); // X
+                          local_up_dir                           = from_origin_in_parent_system(joint_flattened_abs_up_axis_endpoint,   parent_abs_transform, parent_inverse_transform); // Y
+                          local_heading                          = glm::normalize(glm::cross(local_left_dir, local_up_dir));                                                             // Z
             }
             break;
         case EULER_INDEX_PITCH:
             {
                 // allow ONLY pitch -- project onto YZ plane
-                glm::vec3 parent_plane_normal                  = m_parent ? m_parent->get_abs_left_direction() : VEC_LEFT;                                          // X
-                glm::vec3 joint_flattened_abs_up_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_up_axis_endpoint);      // Y
-                glm::vec3 joint_flattened_abs_heading_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_heading_axis_endpoint); // Z
-                          local_up_dir                         = from_origin_in_parent_system(joint_flattened_abs_up_axis_endpoint); // Y
-                          local_heading                        = from_origin_in_parent_system(joint_flattened_abs_heading_endpoint); // Z
+                glm::vec3 parent_plane_normal                  = get_parent_abs_direction(EULER_INDEX_PITCH, parent_abs_transform, parent_inverse_transform);                        // X
+                glm::vec3 joint_flattened_abs_up_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_up_axis_endpoint);                       // Y
+                glm::vec3 joint_flattened_abs_heading_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_heading_axis_endpoint);                  // Z
+                          local_up_dir                         = from_origin_in_parent_system(joint_flattened_abs_up_axis_endpoint, parent_abs_transform, parent_inverse_transform); // Y
+                          local_heading                        = from_origin_in_parent_system(joint_flattened_abs_heading_endpoint, parent_abs_transform, parent_inverse_transform); // Z
             }
             break;
         case EULER_INDEX_YAW:
             {
                 // allow ONLY yaw -- project onto XZ plane
-                glm::vec3 parent_plane_normal                    = m_parent ? m_parent->get_abs_up_direction() : VEC_UP;                                              // Y
-                glm::vec3 joint_flattened_abs_heading_endpoint   = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_heading_axis_endpoint); // Z
-                glm::vec3 joint_flattened_abs_left_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_left_axis_endpoint);    // X
-                          local_heading                          = from_origin_in_parent_system(joint_flattened_abs_heading_endpoint);   // Z
-                glm::vec3 local_left_dir                         = from_origin_in_parent_system(joint_flattened_abs_left_axis_endpoint); // X
-                          local_up_dir                           = glm::normalize(glm::cross(local_heading, local_left_dir));            // Y
+                glm::vec3 parent_plane_normal                    = get_parent_abs_direction(EULER_INDEX_YAW, parent_abs_transform, parent_inverse_transform);                            // Y
+                glm::vec3 joint_flattened_abs_heading_endpoint   = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_heading_axis_endpoint);                    // Z
+                glm::vec3 joint_flattened_abs_left_axis_endpoint = nearest_point_on_plane(parent_plane_origin, parent_plane_normal, joint_abs_left_axis_endpoint);                       // X
+                          local_heading                          = from_origin_in_parent_system(joint_flattened_abs_heading_endpoint,   parent_abs_transform, parent_inverse_transform); // Z
+                glm::vec3 local_left_dir                         = from_origin_in_parent_system(joint_flattened_abs_left_axis_endpoint, parent_abs_transform, parent_inverse_transform); // X
+                          local_up_dir                           = glm::normalize(glm::cross(local_heading, local_left_dir));                                                            // Y
             }
             break;
         default:
             break;
     }
     disable_recursion = true;
-    point_at_local(local_heading, &local_up_dir);
+    point_at_local(local_heading, &local_up_dir, parent_abs_transform, parent_inverse_transform);
     disable_recursion = false;
 }
 
-void TransformObject::apply_hinge_constraints_within_plane_of_free_rotation()
+void TransformObject::apply_hinge_constraints_within_plane_of_free_rotation(const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
 {
     if(!is_hinge() || m_hinge_type == EULER_INDEX_ROLL) { // NOTE: roll hinge joints too unstable
         return;
     }
-    glm::vec3 parent_abs_origin;
-    glm::mat4 parent_transform;
-    glm::vec3 parent_abs_up_direction;
-    if(m_parent) {
-        parent_abs_origin       = m_parent->in_abs_system();
-        parent_transform        = m_parent->get_transform();
-        parent_abs_up_direction = m_parent->get_abs_up_direction();
-    } else {
-        parent_abs_origin       = glm::vec3(0);
-        parent_transform        = glm::mat4(1);
-        parent_abs_up_direction = VEC_UP;
-    }
-    glm::vec3 abs_heading            = get_abs_heading();
+    glm::vec3 parent_abs_origin       = get_parent_abs_origin(parent_abs_transform);
+    glm::mat4 parent_transform        = get_parent_abs_transform(parent_abs_transform);
+    glm::vec3 parent_abs_up_direction = get_parent_abs_direction(EULER_INDEX_YAW, parent_abs_transform, parent_inverse_transform);
+    glm::vec3 abs_heading            = get_abs_direction(EULER_INDEX_ROLL, parent_abs_transform, parent_inverse_transform);
     glm::vec3 center_local_euler     = m_euler;
     center_local_euler[m_hinge_type] = m_joint_constraints_center[m_hinge_type];
     glm::vec3 center_dir             = dir_from_point_as_offset_in_other_system(center_local_euler, parent_transform, parent_abs_origin);
     // if pointing backwards and not yet suppressed roll and yaw
     if(m_hinge_type == EULER_INDEX_PITCH &&
-       glm::dot(get_abs_up_direction(), parent_abs_up_direction) < 0 &&
+       glm::dot(get_abs_direction(EULER_INDEX_YAW, parent_abs_transform, parent_inverse_transform), parent_abs_up_direction) < 0 &&
        !(m_euler[EULER_INDEX_ROLL] == 0 && m_euler[EULER_INDEX_YAW] == 0))
     {
         // suppress roll and yaw and remap pitch from [-90, 90] to [-90, -270]
@@ -325,7 +351,7 @@ void TransformObject::apply_hinge_constraints_within_plane_of_free_rotation()
         m_euler[EULER_INDEX_YAW]   = 0;
         mark_dirty_transform();
         // recalculate local vars to reflect change
-        abs_heading                      = get_abs_heading();
+        abs_heading                      = get_abs_direction(EULER_INDEX_ROLL, parent_abs_transform, parent_inverse_transform);
         center_local_euler               = m_euler;
         center_local_euler[m_hinge_type] = m_joint_constraints_center[m_hinge_type];
         center_dir                       = dir_from_point_as_offset_in_other_system(center_local_euler, parent_transform, parent_abs_origin);
@@ -349,13 +375,13 @@ void TransformObject::apply_hinge_constraints_within_plane_of_free_rotation()
     mark_dirty_transform();
 }
 
-void TransformObject::apply_joint_constraints()
+void TransformObject::apply_joint_constraints(const glm::mat4* parent_abs_transform, const glm::mat4* parent_inverse_transform)
 {
     switch(m_joint_type) {
         case JOINT_TYPE_REVOLUTE:
             if(is_hinge() && m_hinge_type != EULER_INDEX_ROLL) { // NOTE: roll hinge joints too unstable
-                apply_hinge_constraints_perpendicular_to_plane_of_free_rotation(); // provides stability; prevents numerical errors from accumulating
-                apply_hinge_constraints_within_plane_of_free_rotation();           // enforces joint limits
+                apply_hinge_constraints_perpendicular_to_plane_of_free_rotation(parent_abs_transform, parent_inverse_transform); // provides stability; prevents numerical errors from accumulating
+                apply_hinge_constraints_within_plane_of_free_rotation(parent_abs_transform, parent_inverse_transform);           // enforces joint limits
                 break;
             }
             for(int i = 0; i < 3; i++) {
@@ -390,13 +416,15 @@ void TransformObject::apply_joint_constraints()
 // advanced features
 //==================
 
-void TransformObject::arcball(glm::vec3* local_arc_pivot_dir,
-                              float*     angle_delta,
-                              glm::vec3  abs_target,
-                              glm::vec3  abs_reference_point)
+void TransformObject::arcball(glm::vec3*       local_arc_pivot_dir,
+                              float*           angle_delta,
+                              glm::vec3        abs_target,
+                              glm::vec3        abs_reference_point,
+                              const glm::mat4* parent_abs_transform,
+                              const glm::mat4* parent_inverse_transform)
 {
-    glm::vec3 local_target_dir          = glm::normalize(from_origin_in_parent_system(abs_target));
-    glm::vec3 local_reference_point_dir = glm::normalize(from_origin_in_parent_system(abs_reference_point));
+    glm::vec3 local_target_dir          = glm::normalize(from_origin_in_parent_system(abs_target,          parent_abs_transform, parent_inverse_transform));
+    glm::vec3 local_reference_point_dir = glm::normalize(from_origin_in_parent_system(abs_reference_point, parent_abs_transform, parent_inverse_transform));
     glm::vec3 local_arc_delta_dir       = glm::normalize(local_target_dir - local_reference_point_dir);
     glm::vec3 local_arc_midpoint_dir    = glm::normalize((local_target_dir + local_reference_point_dir) * 0.5f);
     if(local_arc_pivot_dir) {
@@ -407,13 +435,16 @@ void TransformObject::arcball(glm::vec3* local_arc_pivot_dir,
     }
 }
 
-void TransformObject::project_to_plane_of_free_rotation(glm::vec3* target, glm::vec3* end_effector_tip)
+void TransformObject::project_to_plane_of_free_rotation(glm::vec3*       target,
+                                                        glm::vec3*       end_effector_tip,
+                                                        const glm::mat4* parent_abs_transform,
+                              const glm::mat4* parent_inverse_transform)
 {
     if(!is_hinge()) {
         return;
     }
-    glm::vec3 plane_origin = in_abs_system();
-    glm::vec3 plane_normal = get_abs_direction(m_hinge_type);
+    glm::vec3 plane_origin = in_abs_system(glm::vec3(0), parent_abs_transform);
+    glm::vec3 plane_normal = get_abs_direction(m_hinge_type, parent_abs_transform, parent_inverse_transform);
     if(target) {
         *target = nearest_point_on_plane(plane_origin, plane_normal, *target);
     }
@@ -431,46 +462,70 @@ bool TransformObject::solve_ik_ccd(TransformObject* root,
                                    float            accept_end_effector_distance,
                                    float            accept_avg_angle_distance)
 {
+    // world transforms of the chain are tracked here for the duration of the solve, so that a step costs the
+    // same no matter how many segments hang below the one being rotated (one pass per iteration to refresh)
+    std::vector<TransformObject*> segments; // end effector first
+    for(TransformObject* current_segment = this; current_segment && current_segment != root->get_parent(); current_segment = current_segment->get_parent()) {
+        segments.push_back(current_segment);
+    }
+    if(segments.empty()) {
+        return false;
+    }
+    TransformObject* root_parent = segments.back()->get_parent();
+    glm::mat4 root_parent_transform = root_parent ? root_parent->get_transform() : glm::mat4(1);
+    std::vector<glm::mat4> abs_transforms(segments.size());
     bool converge = false;
     bool find_solution = false;
     for(int i = 0; i < iters && !converge; i++) {
+        glm::mat4 parent_transform = root_parent_transform;
+        for(int j = static_cast<int>(segments.size()) - 1; j >= 0; j--) {
+            parent_transform = abs_transforms[j] = parent_transform * segments[j]->get_local_transform();
+        }
+        glm::vec3 abs_end_effector_tip = glm::vec3(abs_transforms[0] * glm::vec4(local_end_effector_tip, 1));
         int segment_count = 0;
         float sum_angle = 0;
-        for(TransformObject* current_segment = this; current_segment && current_segment != root->get_parent(); current_segment = current_segment->get_parent()) {
-            glm::vec3 end_effector_tip = in_abs_system(local_end_effector_tip);
+        for(size_t j = 0; j < segments.size(); j++) {
+            TransformObject* current_segment          = segments[j];
+            const glm::mat4* parent_abs_transform     = (j + 1 < segments.size()) ? &abs_transforms[j + 1] : &root_parent_transform;
+            glm::mat4        parent_inverse_transform = glm::inverse(*parent_abs_transform); // once per step, helpers below reuse it
+            // end effector tip in current segment's system, carried along by whatever happens to current segment
+            glm::vec3 segment_end_effector_tip = glm::vec3(current_segment->get_local_inverse_transform() * parent_inverse_transform * glm::vec4(abs_end_effector_tip, 1));
+            glm::vec3 end_effector_tip = abs_end_effector_tip;
             find_solution = (glm::distance(end_effector_tip, target) < accept_end_effector_distance);
             glm::vec3 _target;
             if(end_effector_dir && current_segment == this) {
-                _target = in_abs_system() + *end_effector_dir;
+                _target = in_abs_system(glm::vec3(0), parent_abs_transform) + *end_effector_dir;
             } else {
                 _target = target;
             }
             if(current_segment->get_joint_type() == JOINT_TYPE_PRISMATIC) {
-                current_segment->set_origin(current_segment->get_origin() + (current_segment->from_origin_in_parent_system(_target) -
-                                                                             current_segment->from_origin_in_parent_system(end_effector_tip)));
+                current_segment->set_origin(current_segment->get_origin() + (current_segment->from_origin_in_parent_system(_target,          parent_abs_transform, &parent_inverse_transform) -
+                                                                             current_segment->from_origin_in_parent_system(end_effector_tip, parent_abs_transform, &parent_inverse_transform)));
+                abs_transforms[j]    = *parent_abs_transform * current_segment->get_local_transform();
+                abs_end_effector_tip = glm::vec3(abs_transforms[j] * glm::vec4(segment_end_effector_tip, 1));
                 continue;
             }
             if(is_hinge()) {
-                current_segment->project_to_plane_of_free_rotation(&_target, &end_effector_tip);
+                current_segment->project_to_plane_of_free_rotation(&_target, &end_effector_tip, parent_abs_transform, &parent_inverse_transform);
             }
 #if 1
             glm::vec3 local_arc_pivot_dir;
             float angle_delta = 0;
-            current_segment->arcball(&local_arc_pivot_dir, &angle_delta, _target, end_effector_tip);
+            current_segment->arcball(&local_arc_pivot_dir, &angle_delta, _target, end_effector_tip, parent_abs_transform, &parent_inverse_transform);
             glm::mat4 local_arc_rotation_transform = GLM_ROTATION_TRANSFORM(glm::mat4(1), -angle_delta, local_arc_pivot_dir);
     #if 1
             // attempt #3 -- same as attempt #2, but make use of roll component (suitable for ropes/snakes/boids)
-            current_segment->set_local_rotation_transform(local_arc_rotation_transform * current_segment->get_local_rotation_transform());
+            current_segment->set_local_rotation_transform(local_arc_rotation_transform * current_segment->get_local_rotation_transform(), parent_abs_transform, &parent_inverse_transform);
             // update guide wires (for debug)
-            glm::vec3 debug_local_target_dir           = glm::normalize(current_segment->from_origin_in_parent_system(_target));
-            glm::vec3 debug_local_end_effector_tip_dir = glm::normalize(current_segment->from_origin_in_parent_system(end_effector_tip));
+            glm::vec3 debug_local_target_dir           = glm::normalize(current_segment->from_origin_in_parent_system(_target,          parent_abs_transform, &parent_inverse_transform));
+            glm::vec3 debug_local_end_effector_tip_dir = glm::normalize(current_segment->from_origin_in_parent_system(end_effector_tip, parent_abs_transform, &parent_inverse_transform));
             glm::vec3 debug_local_arc_delta_dir        = glm::normalize(debug_local_target_dir - debug_local_end_effector_tip_dir);
             glm::vec3 debug_local_arc_midpoint_dir     = glm::normalize((debug_local_target_dir + debug_local_end_effector_tip_dir) * 0.5f);
             glm::vec3 debug_local_arc_pivot_dir        = glm::cross(debug_local_arc_delta_dir, debug_local_arc_midpoint_dir);
             current_segment->m_debug_target_dir           = debug_local_target_dir;
             current_segment->m_debug_end_effector_tip_dir = debug_local_end_effector_tip_dir;
             current_segment->m_debug_local_pivot          = debug_local_arc_pivot_dir;
-            current_segment->m_debug_local_target         = current_segment->from_origin_in_parent_system(_target);
+            current_segment->m_debug_local_target         = current_segment->from_origin_in_parent_system(_target, parent_abs_transform, &parent_inverse_transform);
         #ifdef DEBUG
             //std::cout << "TARGET: " << glm::to_string(local_target_dir) << ", END_EFF: " << glm::to_string(local_end_effector_tip_dir) << ", ANGLE: " << angle_delta << std::endl;
             //std::cout << "BEFORE: " << glm::to_string(new_current_segment_transform * glm::vec4(VEC_FORWARD, 1))
@@ -484,14 +539,16 @@ bool TransformObject::solve_ik_ccd(TransformObject* root,
             sum_angle += angle_delta;
 #else
             // attempt #1 -- do rotations in Euler coordinates (poor man's ik)
-            glm::vec3 local_target_euler           = offset_to_euler(current_segment->from_origin_in_parent_system(_target));
-            glm::vec3 local_end_effector_tip_euler = offset_to_euler(current_segment->from_origin_in_parent_system(end_effector_tip));
-            current_segment->set_euler(euler_modulo(current_segment->get_euler() + euler_modulo(local_target_euler - local_end_effector_tip_euler)));
+            glm::vec3 local_target_euler           = offset_to_euler(current_segment->from_origin_in_parent_system(_target,          parent_abs_transform, &parent_inverse_transform));
+            glm::vec3 local_end_effector_tip_euler = offset_to_euler(current_segment->from_origin_in_parent_system(end_effector_tip, parent_abs_transform, &parent_inverse_transform));
+            current_segment->set_euler(euler_modulo(current_segment->get_euler() + euler_modulo(local_target_euler - local_end_effector_tip_euler)), parent_abs_transform, &parent_inverse_transform);
             sum_angle += accept_avg_angle_distance; // to avoid convergence
 #endif
 #ifdef DEBUG
             std::cout << "NAME: " << current_segment->get_name() << ", EULER: " << glm::to_string(current_segment->get_euler()) << std::endl;
 #endif
+            abs_transforms[j]    = *parent_abs_transform * current_segment->get_local_transform();
+            abs_end_effector_tip = glm::vec3(abs_transforms[j] * glm::vec4(segment_end_effector_tip, 1));
             segment_count++;
         }
         if(!segment_count) {
@@ -502,6 +559,7 @@ bool TransformObject::solve_ik_ccd(TransformObject* root,
             converge = true;
         }
     }
+    segments.back()->get_transform(); // bring cached transforms of everything under root up to date
     return converge && find_solution;
 }
 
@@ -563,13 +621,24 @@ glm::mat4 TransformObject::get_local_rotation_transform() const
     return GLM_EULER_TRANSFORM(EULER_YAW(m_euler), EULER_PITCH(m_euler), EULER_ROLL(m_euler));
 }
 
+glm::mat4 TransformObject::get_local_transform() const
+{
+    return glm::translate(glm::mat4(1), m_origin) * get_local_rotation_transform() * glm::scale(glm::mat4(1), m_scale);
+}
+
+// inverse of get_local_transform without a general 4x4 inverse
+glm::mat4 TransformObject::get_local_inverse_transform() const
+{
+    return glm::scale(glm::mat4(1), 1.0f / m_scale) * glm::transpose(get_local_rotation_transform()) * glm::translate(glm::mat4(1), -m_origin);
+}
+
 //========
 // caching
 //========
 
 void TransformObject::update_transform()
 {
-    m_transform = glm::translate(glm::mat4(1), m_origin) * get_local_rotation_transform() * glm::scale(glm::mat4(1), m_scale);
+    m_transform = get_local_transform();
 }
 
 void TransformObject::update_transform_hier()
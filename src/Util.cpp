@@ -140,6 +140,16 @@ glm::vec3 euler_modulo(glm::vec3 euler)
     return euler;
 }
 
+glm::vec3 euler_index_to_axis(euler_index_t euler_index)
+{
+    switch(euler_index) {
+        case EULER_INDEX_ROLL:  return VEC_FORWARD;
+        case EULER_INDEX_PITCH: return VEC_LEFT;
+        case EULER_INDEX_YAW:   return VEC_UP;
+        default:                return glm::vec3(0);
+    }
+}
+
 float angle_modulo(float angle)
 {
     while(angle >= 360) {
@@ -0,0 +1,165 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Headless boids benchmark (no GL context required).
+ * Runs N FlockSimulator agents among flat box obstacles for M steps and reports steps/sec,
+ * once updating agents in place and once double buffered on the thread pool.
+ * Usage: bench_boids [agent_count] [step_count] [obstacle_count] [thread_count]
+ * Author: onlyuser
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <glm/glm.hpp>
+#include <FlockSimulator.h>
+#include <Octree.h>
+#include <ThreadPool.h>
+#include <Util.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+#define DEFAULT_AGENT_COUNT    1000
+#define DEFAULT_STEP_COUNT     200
+#define DEFAULT_OBSTACLE_COUNT 4
+#define DENSITY_AGENT_COUNT    40 // main_boids population in a box of DENSITY_DIM
+#define DENSITY_DIM            10
+#define OBSTACLE_DIM_MAX       glm::vec3(10, 0.1, 10) // of a DENSITY_DIM box, scaled with it
+#define OBSTACLE_DIM_MIN       glm::vec3(5, 0.1, 5)
+#define FORWARD_SPEED_MIN      0.025f
+#define FORWARD_SPEED_MAX      0.05f
+
+static float rand_float(float min_value, float max_value)
+{
+    return LERP(min_value, max_value, static_cast<float>(rand()) / RAND_MAX);
+}
+
+static glm::vec3 rand_vec(glm::vec3 min_value, glm::vec3 max_value)
+{
+    return glm::vec3(rand_float(min_value.x, max_value.x),
+                     rand_float(min_value.y, max_value.y),
+                     rand_float(min_value.z, max_value.z));
+}
+
+// order-dependent hash of final state, equal across runs iff the simulation is deterministic
+static unsigned long state_checksum(const vt::FlockSimulator& flock_simulator)
+{
+    unsigned long checksum = 0;
+    const std::vector<glm::vec3>& positions = flock_simulator.get_positions();
+    const std::vector<glm::vec3>& headings  = flock_simulator.get_headings();
+    for(size_t i = 0; i < positions.size(); i++) {
+        const float values[] = {positions[i].x, positions[i].y, positions[i].z, headings[i].x, headings[i].y, headings[i].z};
+        for(int j = 0; j < 6; j++) {
+            uint32_t bits;
+            memcpy(&bits, &values[j], sizeof(bits));
+            checksum = checksum * 1000003 + bits;
+        }
+    }
+    return checksum;
+}
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start_time)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
+
+static void run_flock(int  agent_count,
+                      int  step_count,
+                      int  obstacle_count,
+                      bool double_buffered,
+                      vt::ThreadPool* thread_pool)
+{
+    srand(0);
+
+    // grow the box with the population so neighbor density matches main_boids
+    float     scale  = powf(static_cast<float>(agent_count) / DENSITY_AGENT_COUNT, 1.0f / 3);
+    glm::vec3 dim    = glm::vec3(DENSITY_DIM * std::max(scale, 1.0f));
+    glm::vec3 origin = -dim * 0.5f;
+
+    vt::FlockSimulator flock_simulator(origin, dim);
+    flock_simulator.set_thread_pool(thread_pool);
+    flock_simulator.set_double_buffered(double_buffered);
+
+    // axis-aligned obstacles, the octree's own bbox test is exact for them
+    vt::Octree obstacle_octree(origin, dim);
+    float obstacle_scale = dim.x / DENSITY_DIM;
+    for(int i = 0; i < obstacle_count; i++) {
+        glm::vec3 center       = rand_vec(origin, origin + dim);
+        glm::vec3 obstacle_dim = rand_vec(OBSTACLE_DIM_MIN, OBSTACLE_DIM_MAX) * obstacle_scale;
+        obstacle_octree.insert_box(i, center - obstacle_dim * 0.5f, center + obstacle_dim * 0.5f);
+    }
+    flock_simulator.set_obstacles(&obstacle_octree);
+
+    for(int i = 0; i < agent_count; i++) {
+        glm::vec3 heading      = glm::normalize(rand_vec(glm::vec3(-1), glm::vec3(1)));
+        glm::vec3 up_direction = glm::normalize(glm::cross(heading, glm::cross(VEC_UP, heading)));
+        if(glm::length(glm::cross(VEC_UP, heading)) < EPSILON) {
+            up_direction = glm::normalize(glm::cross(heading, VEC_LEFT));
+        }
+        flock_simulator.add_agent(rand_vec(origin, origin + dim),
+                                  heading,
+                                  up_direction,
+                                  rand_float(FORWARD_SPEED_MIN, FORWARD_SPEED_MAX));
+    }
+
+    printf("%s: %d agents, %d obstacles, %d steps, box %.1f, %d threads\n",
+           double_buffered ? "double buffered" : "in place",
+           agent_count, obstacle_count, step_count, dim.x, thread_pool->get_thread_count());
+    std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < step_count; i++) {
+        flock_simulator.step();
+    }
+    double total_ms = elapsed_ms(start_time);
+
+    int behavior_counts[vt::FLOCK_BEHAVIOR_CRUISE + 1] = {0};
+    const std::vector<vt::flock_behavior_t>& behaviors = flock_simulator.get_behaviors();
+    for(std::vector<vt::flock_behavior_t>::const_iterator p = behaviors.begin(); p != behaviors.end(); p++) {
+        behavior_counts[*p]++;
+    }
+    printf("    %.1f ms total, %.3f ms/step, %.1f steps/sec, %.0f agent-steps/sec\n",
+           total_ms,
+           total_ms / step_count,
+           step_count * 1000.0 / total_ms,
+           static_cast<double>(agent_count) * step_count * 1000.0 / total_ms);
+    printf("    last step: reverse %d, obstacle avoid %d, separation %d, flocking %d, homing %d, cruise %d\n",
+           behavior_counts[vt::FLOCK_BEHAVIOR_REVERSE],
+           behavior_counts[vt::FLOCK_BEHAVIOR_OBSTACLE_AVOID],
+           behavior_counts[vt::FLOCK_BEHAVIOR_SEPARATION],
+           behavior_counts[vt::FLOCK_BEHAVIOR_FLOCKING],
+           behavior_counts[vt::FLOCK_BEHAVIOR_HOMING],
+           behavior_counts[vt::FLOCK_BEHAVIOR_CRUISE]);
+    printf("    state checksum %016lx\n", state_checksum(flock_simulator));
+}
+
+int main(int argc, char* argv[])
+{
+    int agent_count    = (argc > 1) ? atoi(argv[1]) : DEFAULT_AGENT_COUNT;
+    int step_count     = (argc > 2) ? atoi(argv[2]) : DEFAULT_STEP_COUNT;
+    int obstacle_count = (argc > 3) ? atoi(argv[3]) : DEFAULT_OBSTACLE_COUNT;
+    int thread_count   = (argc > 4) ? atoi(argv[4]) : 0;
+    if(agent_count <= 0 || step_count <= 0 || obstacle_count < 0 || thread_count < 0) {
+        fprintf(stderr, "Usage: %s [agent_count] [step_count] [obstacle_count] [thread_count]\n", argv[0]);
+        return 1;
+    }
+    vt::ThreadPool thread_pool(thread_count);
+    run_flock(agent_count, step_count, obstacle_count, false, &thread_pool);
+    run_flock(agent_count, step_count, obstacle_count, true,  &thread_pool);
+    return 0;
+}
@@ -0,0 +1,402 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Headless IK solver benchmark (no GL context required).
+ * Solves the same random reachable targets with each IKChain solver (and the closed form, on legs shaped for it)
+ * on rigs modeled on the demos and reports
+ * error and time, first from rest pose per iteration budget (convergence), then tracking a moving target with
+ * one iteration per frame as the demos do.
+ * Usage: bench_ik [target_count] [frame_count]
+ * Author: onlyuser
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <glm/glm.hpp>
+#include <glm/gtx/vector_angle.hpp>
+#include <IKChain.h>
+#include <TransformObject.h>
+#include <Util.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+
+#define DEFAULT_TARGET_COUNT         500
+#define DEFAULT_FRAME_COUNT          1000
+#define ACCEPT_AVG_ANGLE_DISTANCE    0.001
+#define ACCEPT_END_EFFECTOR_DISTANCE 0.001
+#define SOLVED_DISTANCE              0.01 // what counts as reaching the target
+#define SOLVED_ANGLE                 1    // and pointing the right way (degrees)
+#define FREE_JOINT_RANGE             45   // of random poses, for axes without constraints
+#define FRAMES_PER_POSE              30   // tracking target sweeps between random poses
+#define TRACKING_ITERS               1
+
+static const int                         iter_budgets[] = {1, 4, 16, 64};
+static const vt::IKChain::solver_t       solvers[]      = {vt::IKChain::SOLVER_CCD, vt::IKChain::SOLVER_FABRIK, vt::IKChain::SOLVER_DLS};
+static const char*                       solver_names[] = {"ccd", "fabrik", "dls", "analytic"}; // analytic falls back to ccd
+static const int                         solver_count   = sizeof(solvers) / sizeof(*solvers);
+
+struct Rig
+{
+    std::string                       m_name;
+    vt::TransformObject*              m_base;
+    std::vector<vt::TransformObject*> m_segments; // root first
+    glm::vec3                         m_local_end_effector_tip;
+};
+
+struct Pose
+{
+    std::vector<glm::vec3> m_origins;
+    std::vector<glm::vec3> m_eulers;
+};
+
+struct Stats
+{
+    double m_sum_distance;
+    double m_max_distance;
+    double m_sum_angle;
+    double m_total_ms;
+    int    m_solved_count;
+    int    m_result_count;
+    int    m_count;
+
+    Stats() : m_sum_distance(0), m_max_distance(0), m_sum_angle(0), m_total_ms(0), m_solved_count(0), m_result_count(0), m_count(0) {}
+};
+
+static float rand_float(float min_value, float max_value)
+{
+    return LERP(min_value, max_value, static_cast<float>(rand()) / RAND_MAX);
+}
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start_time)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
+
+//=====
+// rigs
+//=====
+
+static vt::TransformObject* add_segment(Rig* rig, glm::vec3 origin)
+{
+    std::stringstream ss;
+    ss << rig->m_name << "_" << rig->m_segments.size();
+    vt::TransformObject* segment = new vt::TransformObject(ss.str());
+    segment->link_parent(rig->m_segments.empty() ? rig->m_base : rig->m_segments.back());
+    segment->set_origin(origin);
+    rig->m_segments.push_back(segment);
+    return segment;
+}
+
+static void add_hinge(Rig* rig, glm::vec3 origin, vt::euler_index_t hinge_type, float center, float max_deviation)
+{
+    vt::TransformObject* segment = add_segment(rig, origin);
+    glm::vec3 joint_constraints_center        = glm::vec3(0);
+    glm::vec3 joint_constraints_max_deviation = glm::vec3(0);
+    joint_constraints_center[hinge_type]        = center;
+    joint_constraints_max_deviation[hinge_type] = max_deviation;
+    if(hinge_type == vt::EULER_INDEX_ROLL) {
+        segment->set_enable_joint_constraints(glm::ivec3(1, 0, 0));
+    }
+    segment->set_hinge_type(hinge_type);
+    segment->set_joint_constraints_center(joint_constraints_center);
+    segment->set_joint_constraints_max_deviation(joint_constraints_max_deviation);
+}
+
+// rest pose is at the center of every joint's constraints
+static void reset_rig(Rig* rig)
+{
+    for(std::vector<vt::TransformObject*>::iterator p = rig->m_segments.begin(); p != rig->m_segments.end(); p++) {
+        if((*p)->get_joint_type() == vt::TransformObject::JOINT_TYPE_PRISMATIC) {
+            (*p)->set_origin((*p)->get_joint_constraints_center());
+        } else {
+            (*p)->set_euler((*p)->get_joint_constraints_center());
+        }
+    }
+}
+
+static Rig* create_rig(std::string name, int rig_index, glm::vec3 local_end_effector_tip)
+{
+    Rig* rig = new Rig();
+    rig->m_name                   = name;
+    rig->m_base                   = new vt::TransformObject(name);
+    rig->m_local_end_effector_tip = local_end_effector_tip;
+    switch(rig_index) {
+        case 0: // main_hexapod leg: yaw hinge hip, then pitch hinges
+            add_hinge(rig, glm::vec3(0),       vt::EULER_INDEX_YAW,   0,   30);
+            add_hinge(rig, glm::vec3(0),       vt::EULER_INDEX_PITCH, -45, 15);
+            add_hinge(rig, glm::vec3(0, 0, 1), vt::EULER_INDEX_PITCH, 60,  60);
+            add_hinge(rig, glm::vec3(0, 0, 1), vt::EULER_INDEX_PITCH, 60,  60);
+            break;
+        case 1: // main_deltabot arm
+            add_hinge(rig, glm::vec3(0),         vt::EULER_INDEX_PITCH, 30,  60);
+            add_hinge(rig, glm::vec3(0, 0, 1),   vt::EULER_INDEX_PITCH, 120, 60);
+            add_hinge(rig, glm::vec3(0, 0, 0.1), vt::EULER_INDEX_YAW,   0,   30);
+            break;
+        case 2: // main_stewart leg: free joint, then piston
+            {
+                add_segment(rig, glm::vec3(0));
+                vt::TransformObject* piston = add_segment(rig, glm::vec3(0, 0, 0.75));
+                piston->set_joint_type(vt::TransformObject::JOINT_TYPE_PRISMATIC);
+                piston->set_enable_joint_constraints(glm::ivec3(1, 1, 1));
+                piston->set_joint_constraints_center(glm::vec3(0, 0, 0.75));
+                piston->set_joint_constraints_max_deviation(glm::vec3(0, 0, 0.75));
+            }
+            break;
+        case 3: // main_fanta arm: roll hinge, then pitch hinges
+            add_hinge(rig, glm::vec3(0), vt::EULER_INDEX_ROLL, 0, 60);
+            for(int i = 0; i < 4; i++) {
+                add_hinge(rig, glm::vec3(0, 0, 1.25), vt::EULER_INDEX_PITCH, -60, 60);
+            }
+            break;
+        case 4: // main_spot_mini leg: free joint locked to roll, then pitch hinges
+            {
+                vt::TransformObject* hip = add_segment(rig, glm::vec3(0));
+                hip->set_enable_joint_constraints(glm::ivec3(1, 1, 1));
+                hip->set_joint_constraints_center(glm::vec3(0));
+                hip->set_joint_constraints_max_deviation(glm::vec3(30, 0, 0));
+                add_hinge(rig, glm::vec3(0),       vt::EULER_INDEX_PITCH, 120, 30);
+                add_hinge(rig, glm::vec3(0, 0, 1), vt::EULER_INDEX_PITCH, -90, 60);
+            }
+            break;
+        case 5: // long chain of free joints
+            for(int i = 0; i < 20; i++) {
+                add_segment(rig, glm::vec3(0, 0, i ? 0.5 : 0));
+            }
+            break;
+    }
+    reset_rig(rig);
+    return rig;
+}
+
+static void delete_rig(Rig* rig)
+{
+    for(std::vector<vt::TransformObject*>::iterator p = rig->m_segments.begin(); p != rig->m_segments.end(); p++) {
+        delete *p;
+    }
+    delete rig->m_base;
+    delete rig;
+}
+
+//======
+// poses
+//======
+
+static Pose random_pose(const Rig* rig)
+{
+    Pose pose;
+    for(std::vector<vt::TransformObject*>::const_iterator p = rig->m_segments.begin(); p != rig->m_segments.end(); p++) {
+        glm::vec3  origin                   = (*p)->get_origin();
+        glm::vec3  euler                    = glm::vec3(0);
+        glm::vec3  center                   = (*p)->get_joint_constraints_center();
+        glm::vec3  max_deviation            = (*p)->get_joint_constraints_max_deviation();
+        glm::ivec3 enable_joint_constraints = (*p)->get_enable_joint_constraints();
+        if((*p)->get_joint_type() == vt::TransformObject::JOINT_TYPE_PRISMATIC) {
+            for(int i = 0; i < 3; i++) {
+                if(enable_joint_constraints[i]) {
+                    origin[i] = rand_float(center[i] - max_deviation[i], center[i] + max_deviation[i]);
+                }
+            }
+        } else if((*p)->is_hinge()) {
+            vt::euler_index_t hinge_type = (*p)->get_hinge_type();
+            euler[hinge_type] = rand_float(center[hinge_type] - max_deviation[hinge_type], center[hinge_type] + max_deviation[hinge_type]);
+        } else {
+            for(int i = 0; i < 3; i++) {
+                euler[i] = enable_joint_constraints[i] ? rand_float(center[i] - max_deviation[i], center[i] + max_deviation[i])
+                                                       : rand_float(-FREE_JOINT_RANGE, FREE_JOINT_RANGE);
+            }
+        }
+        pose.m_origins.push_back(origin);
+        pose.m_eulers.push_back(euler);
+    }
+    return pose;
+}
+
+static Pose lerp_pose(const Pose& pose, const Pose& pose2, float alpha)
+{
+    Pose result = pose;
+    for(size_t i = 0; i < pose.m_origins.size(); i++) {
+        result.m_origins[i] = LERP(pose.m_origins[i], pose2.m_origins[i], alpha);
+        result.m_eulers[i]  = LERP(pose.m_eulers[i],  pose2.m_eulers[i],  alpha);
+    }
+    return result;
+}
+
+// end effector tip and heading of rig in pose
+static void get_target(Rig* rig, const Pose& pose, glm::vec3* target, glm::vec3* end_effector_dir)
+{
+    for(size_t i = 0; i < rig->m_segments.size(); i++) {
+        rig->m_segments[i]->set_origin(pose.m_origins[i]);
+        rig->m_segments[i]->set_euler(pose.m_eulers[i]);
+    }
+    vt::TransformObject* end_effector = rig->m_segments.back();
+    *target           = end_effector->in_abs_system(rig->m_local_end_effector_tip);
+    *end_effector_dir = glm::normalize(*target - end_effector->in_abs_system());
+}
+
+//==========
+// benchmark
+//==========
+
+// solver_count picks analytic, if chain is shaped for it
+static bool select_solver(vt::IKChain* ik_chain, int solver_index, bool use_end_effector_dir)
+{
+    bool analytic = (solver_index == solver_count);
+    if(analytic && (!ik_chain->is_analytic() || use_end_effector_dir)) {
+        return false;
+    }
+    ik_chain->set_solver(analytic ? vt::IKChain::SOLVER_CCD : solvers[solver_index]);
+    ik_chain->set_enable_analytic(analytic);
+    return true;
+}
+
+static void solve(Rig*                  rig,
+                  vt::IKChain*          ik_chain,
+                  glm::vec3             target,
+                  glm::vec3*            end_effector_dir,
+                  int                   iters,
+                  Stats*                stats)
+{
+    std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+    ik_chain->load();
+    bool result = ik_chain->solve(target, end_effector_dir, iters, ACCEPT_END_EFFECTOR_DISTANCE, ACCEPT_AVG_ANGLE_DISTANCE);
+    ik_chain->commit();
+    stats->m_total_ms += elapsed_ms(start_time);
+    vt::TransformObject* end_effector = rig->m_segments.back();
+    glm::vec3 end_effector_tip = end_effector->in_abs_system(rig->m_local_end_effector_tip);
+    float     distance         = glm::distance(end_effector_tip, target);
+    float     angle            = end_effector_dir ? glm::degrees(glm::angle(glm::normalize(end_effector_tip - end_effector->in_abs_system()), *end_effector_dir)) : 0;
+    stats->m_sum_distance += distance;
+    stats->m_max_distance  = std::max(stats->m_max_distance, static_cast<double>(distance));
+    stats->m_sum_angle    += angle;
+    if(distance < SOLVED_DISTANCE && angle < SOLVED_ANGLE) {
+        stats->m_solved_count++;
+    }
+    if(result) {
+        stats->m_result_count++;
+    }
+    stats->m_count++;
+}
+
+static void print_stats(const char* solver_name, const char* label, int value, const Stats& stats, bool use_end_effector_dir)
+{
+    printf("    %-8s %s %2d: %6.1f%% solved (%5.1f%% converged), distance mean %.4f max %.4f",
+           solver_name, label, value,
+           stats.m_solved_count * 100.0 / stats.m_count,
+           stats.m_result_count * 100.0 / stats.m_count,
+           stats.m_sum_distance / stats.m_count,
+           stats.m_max_distance);
+    if(use_end_effector_dir) {
+        printf(", angle mean %5.2f", stats.m_sum_angle / stats.m_count);
+    }
+    printf(", %7.2f us/solve\n", stats.m_total_ms * 1000 / stats.m_count);
+}
+
+static void run_rig(int rig_index, std::string name, glm::vec3 local_end_effector_tip, int target_count, int frame_count)
+{
+    Rig* rig       = create_rig(name, rig_index, local_end_effector_tip);
+    Rig* ghost_rig = create_rig(name + "_ghost", rig_index, local_end_effector_tip); // poses targets
+    vt::IKChain ik_chain(rig->m_segments.front(), rig->m_segments.back(), local_end_effector_tip);
+    for(int k = 0; k < 2; k++) {
+        bool use_end_effector_dir = (k == 1);
+        printf("%s: %d segments, %s\n", name.c_str(), static_cast<int>(rig->m_segments.size()),
+               use_end_effector_dir ? "position and heading" : "position");
+
+        // convergence from rest pose, same targets for every solver
+        srand(rig_index);
+        std::vector<glm::vec3> targets;
+        std::vector<glm::vec3> end_effector_dirs;
+        for(int i = 0; i < target_count; i++) {
+            glm::vec3 target;
+            glm::vec3 end_effector_dir;
+            get_target(ghost_rig, random_pose(ghost_rig), &target, &end_effector_dir);
+            targets.push_back(target);
+            end_effector_dirs.push_back(end_effector_dir);
+        }
+        int    best_solver = -1;
+        int    best_iters  = 0;
+        double best_us     = 0;
+        for(int s = 0; s <= solver_count; s++) {
+            if(!select_solver(&ik_chain, s, use_end_effector_dir)) {
+                continue;
+            }
+            for(int b = 0; b < static_cast<int>(sizeof(iter_budgets) / sizeof(*iter_budgets)); b++) {
+                Stats stats;
+                for(int i = 0; i < target_count; i++) {
+                    reset_rig(rig);
+                    solve(rig, &ik_chain, targets[i], use_end_effector_dir ? &end_effector_dirs[i] : NULL, iter_budgets[b], &stats);
+                }
+                print_stats(solver_names[s], "iters", iter_budgets[b], stats, use_end_effector_dir);
+                double us = stats.m_total_ms * 1000 / stats.m_count;
+                if(stats.m_solved_count * 100 >= stats.m_count * 95 && (best_solver < 0 || us < best_us)) {
+                    best_solver = s;
+                    best_iters  = iter_budgets[b];
+                    best_us     = us;
+                }
+            }
+        }
+        if(best_solver < 0) {
+            printf("    fastest: none solves 95%% of targets\n");
+        } else {
+            printf("    fastest: %s, %d iters, %.2f us/solve\n", solver_names[best_solver], best_iters, best_us);
+        }
+
+        // tracking a target that moves between random poses, warm started from last frame
+        for(int s = 0; s <= solver_count; s++) {
+            if(!select_solver(&ik_chain, s, use_end_effector_dir)) {
+                continue;
+            }
+            srand(rig_index);
+            reset_rig(rig);
+            Pose  pose  = random_pose(ghost_rig);
+            Pose  pose2 = random_pose(ghost_rig);
+            Stats stats;
+            for(int i = 0; i < frame_count; i++) {
+                if(i && !(i % FRAMES_PER_POSE)) {
+                    pose  = pose2;
+                    pose2 = random_pose(ghost_rig);
+                }
+                glm::vec3 target;
+                glm::vec3 end_effector_dir;
+                get_target(ghost_rig, lerp_pose(pose, pose2, static_cast<float>(i % FRAMES_PER_POSE) / FRAMES_PER_POSE), &target, &end_effector_dir);
+                solve(rig, &ik_chain, target, use_end_effector_dir ? &end_effector_dir : NULL, TRACKING_ITERS, &stats);
+            }
+            print_stats(solver_names[s], "track", TRACKING_ITERS, stats, use_end_effector_dir);
+        }
+    }
+    delete_rig(ghost_rig);
+    delete_rig(rig);
+}
+
+int main(int argc, char* argv[])
+{
+    int target_count = (argc > 1) ? atoi(argv[1]) : DEFAULT_TARGET_COUNT;
+    int frame_count  = (argc > 2) ? atoi(argv[2]) : DEFAULT_FRAME_COUNT;
+    if(target_count <= 0 || frame_count <= 0) {
+        fprintf(stderr, "Usage: %s [target_count] [frame_count]\n", argv[0]);
+        return 1;
+    }
+    run_rig(0, "hexapod_leg",  glm::vec3(0, 0, 1),    target_count, frame_count);
+    run_rig(1, "deltabot_arm", glm::vec3(0, 0, 2),    target_count, frame_count);
+    run_rig(2, "stewart_leg",  glm::vec3(0, 0, 1.5),  target_count, frame_count);
+    run_rig(3, "fanta_arm",    glm::vec3(0, 0, 1.25), target_count, frame_count);
+    run_rig(4, "spot_leg",     glm::vec3(0, 0, 1),    target_count, frame_count);
+    run_rig(5, "snake",        glm::vec3(0, 0, 0.5),  target_count, frame_count);
+    return 0;
+}
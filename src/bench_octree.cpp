@@ -0,0 +1,738 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Headless Octree benchmark (no GL context required).
+ * Mode "check" compares every nearest neighbor query against brute force under motion, exits non-zero on mismatch.
+ * Author: onlyuser
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <glm/glm.hpp>
+#include <BBoxObject.h>
+#include <Octree.h>
+#include <ThreadPool.h>
+#include <SimdDistance.h>
+#include <Util.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string.h>
+
+#define DEFAULT_OBJECT_COUNT 1000
+#define DEFAULT_FRAME_COUNT  1000
+#define BUILD_FRAME_COUNT    20
+#define FIND_QUERY_COUNT     10000
+#define FIND_K               20
+#define FIND_RADIUS          1.0f
+#define WARMUP_FRAME_COUNT   100 // frames excluded from steady state (pool and leaf capacities settle early on)
+#define OBJECT_SPEED_MAX     0.05f
+#define RAY_COUNT            10000
+#define BOX_DIM_MIN          0.1f
+#define BOX_DIM_MAX          0.5f
+#define GRAVITY_SOFTENING    0.1f
+#define GRAVITY_SAMPLE_COUNT 100 // bodies checked against the exact all-pairs sum
+#define CHECK_FRAME_COUNT    10
+#define CHECK_TOLERANCE      1e-5f // relative, leaf scans may round squared distances differently
+#define OCTREE_ORIGIN        glm::vec3(-5)
+#define OCTREE_DIM           glm::vec3(10)
+
+// count every heap allocation made by this process
+static size_t alloc_count = 0;
+
+void* operator new(size_t size)
+{
+    alloc_count++;
+    void* p = malloc(size);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+static float rand_float(float min_value, float max_value)
+{
+    return LERP(min_value, max_value, static_cast<float>(rand()) / RAND_MAX);
+}
+
+static glm::vec3 rand_vec(glm::vec3 min_value, glm::vec3 max_value)
+{
+    return glm::vec3(rand_float(min_value.x, max_value.x),
+                     rand_float(min_value.y, max_value.y),
+                     rand_float(min_value.z, max_value.z));
+}
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start_time)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
+
+// counters gathered since the last reset_stats(), averaged over count
+static void print_stats(const vt::Octree& octree, double count, const char* unit)
+{
+    printf("   ");
+    for(int i = 0; i < vt::OCTREE_STAT_COUNT; i++) {
+        vt::octree_stat_t stat = static_cast<vt::octree_stat_t>(i);
+        printf(" %.2f %s,", octree.get_stat(stat) / count, vt::Octree::get_stat_name(stat));
+    }
+    printf(" per %s\n", unit);
+}
+
+// boid-like motion: every object drifts at constant velocity and wraps around the octree bounds
+// returns allocations made after warm-up, which should be none
+static size_t bench_update(int object_count, int frame_count)
+{
+    vt::BBoxObject bounds(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+    std::vector<glm::vec3> positions(object_count);
+    std::vector<glm::vec3> velocities(object_count);
+    vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM);
+    for(int i = 0; i < object_count; i++) {
+        positions[i]  = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+        velocities[i] = rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX));
+        octree.insert(i, positions[i]);
+    }
+
+    printf("update: %d objects, %d frames (move + rebalance)\n", object_count, frame_count);
+    octree.reset_stats();
+    size_t steady_state_allocs       = 0;
+    double steady_state_ms           = 0;
+    double steady_state_rebalance_ms = 0;
+    for(int frame = 0; frame < frame_count; frame++) {
+        size_t prev_alloc_count = alloc_count;
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < object_count; i++) {
+            positions[i] = bounds.wrap(positions[i] + velocities[i]);
+            octree.move(i, positions[i]);
+        }
+        std::chrono::high_resolution_clock::time_point rebalance_start_time = std::chrono::high_resolution_clock::now();
+        octree.rebalance();
+        double rebalance_ms = elapsed_ms(rebalance_start_time);
+        double frame_ms     = elapsed_ms(start_time);
+        size_t frame_allocs = alloc_count - prev_alloc_count;
+        if(frame < 5 || !(frame % WARMUP_FRAME_COUNT)) {
+            printf("  frame %4d: %6lu allocs, %8.3f ms\n", frame, frame_allocs, frame_ms);
+        }
+        if(frame >= WARMUP_FRAME_COUNT) {
+            steady_state_allocs       += frame_allocs;
+            steady_state_ms           += frame_ms;
+            steady_state_rebalance_ms += rebalance_ms;
+        }
+    }
+    int steady_state_frames = std::max(frame_count - WARMUP_FRAME_COUNT, 1);
+    printf("  steady state: %.2f allocs/frame, %.3f ms/frame (%.3f ms rebalance)\n",
+           static_cast<double>(steady_state_allocs) / steady_state_frames,
+           steady_state_ms / steady_state_frames,
+           steady_state_rebalance_ms / steady_state_frames);
+    print_stats(octree, std::max(frame_count, 1), "frame");
+    if(steady_state_allocs) {
+        printf("  FAILED: %lu allocs after warm-up\n", steady_state_allocs);
+    }
+    return steady_state_allocs;
+}
+
+// bulk-load vs. insert loop, then rebuild-every-frame vs. move + rebalance under the same motion
+static void bench_build(int object_count, int frame_count)
+{
+    vt::BBoxObject bounds(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+    std::vector<std::pair<long, glm::vec3> > objects(object_count);
+    std::vector<glm::vec3> velocities(object_count);
+    for(int i = 0; i < object_count; i++) {
+        objects[i]    = std::make_pair(static_cast<long>(i), rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM));
+        velocities[i] = rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX));
+    }
+
+    printf("build: %d objects, %d frames\n", object_count, frame_count);
+    vt::Octree insert_octree(OCTREE_ORIGIN, OCTREE_DIM);
+    std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < object_count; i++) {
+        insert_octree.insert(objects[i].first, objects[i].second);
+    }
+    printf("  insert loop:          %8.3f ms\n", elapsed_ms(start_time));
+
+    vt::Octree build_octree(OCTREE_ORIGIN, OCTREE_DIM);
+    start_time = std::chrono::high_resolution_clock::now();
+    build_octree.build(objects);
+    printf("  build:                %8.3f ms\n", elapsed_ms(start_time));
+
+    double rebalance_ms = 0;
+    double rebuild_ms   = 0;
+    for(int frame = 0; frame < frame_count; frame++) {
+        for(int i = 0; i < object_count; i++) {
+            objects[i].second = bounds.wrap(objects[i].second + velocities[i]);
+        }
+        start_time = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < object_count; i++) {
+            insert_octree.move(objects[i].first, objects[i].second);
+        }
+        insert_octree.rebalance();
+        rebalance_ms += elapsed_ms(start_time);
+        start_time = std::chrono::high_resolution_clock::now();
+        build_octree.build(objects);
+        rebuild_ms += elapsed_ms(start_time);
+    }
+    printf("  move + rebalance:     %8.3f ms/frame\n", rebalance_ms / frame_count);
+    printf("  rebuild every frame:  %8.3f ms/frame\n", rebuild_ms / frame_count);
+}
+
+// k nearest neighbors around random query points: visited nodes and time per query
+static void bench_find(int object_count, int query_count)
+{
+    vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM);
+    for(int i = 0; i < object_count; i++) {
+        octree.insert(i, rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM));
+    }
+    std::vector<glm::vec3> targets(query_count);
+    for(int i = 0; i < query_count; i++) {
+        targets[i] = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+    }
+
+    printf("find: %d objects, %d queries, k=%d\n", object_count, query_count, FIND_K);
+    for(int pass = 0; pass < 2; pass++) {
+        float  radius        = pass ? FIND_RADIUS : -1;
+        size_t visited_total = 0;
+        size_t found_total   = 0;
+        std::vector<long> nearest_k_vec;
+        octree.reset_stats();
+        size_t prev_alloc_count = alloc_count;
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < query_count; i++) {
+            int visited_node_count = 0;
+            nearest_k_vec.clear();
+            found_total   += octree.find(targets[i], FIND_K, &nearest_k_vec, radius, &visited_node_count);
+            visited_total += visited_node_count;
+        }
+        double total_ms = elapsed_ms(start_time);
+        printf("  radius %5.2f: %7.1f visited nodes/query, %5.1f found/query, %7.3f us/query, %5.2f allocs/query\n",
+               radius,
+               static_cast<double>(visited_total) / query_count,
+               static_cast<double>(found_total) / query_count,
+               total_ms * 1000 / query_count,
+               static_cast<double>(alloc_count - prev_alloc_count) / query_count);
+        print_stats(octree, query_count, "query");
+    }
+
+    // same queries into caller-owned buffers with reused scratch, leaf scan on each instruction set
+    std::vector<long>  nearest_k_ids(FIND_K);
+    std::vector<float> nearest_k_dist2(FIND_K);
+    vt::FindScratch    scratch;
+    vt::simd_isa_t     best_isa = vt::get_simd_isa();
+    vt::simd_isa_t     isas[]   = {vt::SIMD_ISA_SCALAR, vt::SIMD_ISA_SSE, vt::SIMD_ISA_AVX};
+    for(int j = 0; j < static_cast<int>(sizeof(isas) / sizeof(isas[0])); j++) {
+        if(!vt::set_simd_isa(isas[j])) {
+            continue;
+        }
+        for(int pass = 0; pass < 2; pass++) {
+            float  radius      = pass ? FIND_RADIUS : -1;
+            size_t found_total = 0;
+            size_t prev_alloc_count = alloc_count;
+            std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+            for(int i = 0; i < query_count; i++) {
+                found_total += octree.find(targets[i], FIND_K, nearest_k_ids.data(), nearest_k_dist2.data(), &scratch, radius);
+            }
+            double total_ms = elapsed_ms(start_time);
+            printf("  radius %5.2f, scratch, %-6s leaf scan: %5.1f found/query, %7.3f us/query, %lu allocs total\n",
+                   radius,
+                   vt::get_simd_isa_name(isas[j]),
+                   static_cast<double>(found_total) / query_count,
+                   total_ms * 1000 / query_count,
+                   alloc_count - prev_alloc_count);
+        }
+    }
+    vt::set_simd_isa(best_isa);
+
+    // same queries as one batch, serial then across the pool
+    vt::ThreadPool thread_pool;
+    vt::FindBatchResults results;
+    for(int pass = 0; pass < 2; pass++) {
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        octree.find_batch(targets, FIND_K, FIND_RADIUS, &results, pass ? &thread_pool : NULL);
+        printf("  batch, %2d thread(s): %7.3f us/query\n",
+               pass ? thread_pool.get_thread_count() : 1,
+               elapsed_ms(start_time) * 1000 / query_count);
+    }
+}
+
+// neighbor lists for every object: one knn_graph vs. one find_batch query per object (k + 1 to include self)
+static void bench_graph(int object_count, int frame_count)
+{
+    vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM);
+    std::vector<glm::vec3> positions(object_count);
+    for(int i = 0; i < object_count; i++) {
+        positions[i] = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+        octree.insert(i, positions[i]);
+    }
+
+    printf("graph: %d objects, %d frames, k=%d\n", object_count, frame_count, FIND_K);
+    for(int pass = 0; pass < 2; pass++) {
+        float radius = pass ? FIND_RADIUS : -1;
+        vt::KnnGraph         graph;
+        vt::FindBatchResults results;
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        for(int frame = 0; frame < frame_count; frame++) {
+            octree.find_batch(positions, FIND_K + 1, radius, &results);
+        }
+        double batch_ms = elapsed_ms(start_time) / frame_count;
+        start_time = std::chrono::high_resolution_clock::now();
+        for(int frame = 0; frame < frame_count; frame++) {
+            octree.knn_graph(FIND_K, radius, &graph);
+        }
+        double graph_ms = elapsed_ms(start_time) / frame_count;
+        printf("  radius %5.2f: find_batch %8.3f ms, knn_graph %8.3f ms (%lu edges)\n",
+               radius,
+               batch_ms,
+               graph_ms,
+               graph.m_neighbor_ids.size());
+    }
+}
+
+// boid-like motion, every object queries its own neighborhood each frame, with and without per-object hints
+static void bench_coherence(int object_count, int frame_count)
+{
+    vt::BBoxObject bounds(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+    std::vector<glm::vec3> positions(object_count);
+    std::vector<glm::vec3> velocities(object_count);
+    vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM);
+    for(int i = 0; i < object_count; i++) {
+        positions[i]  = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+        velocities[i] = rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX));
+        octree.insert(i, positions[i]);
+    }
+
+    printf("coherence: %d objects, %d frames, k=%d\n", object_count, frame_count, FIND_K);
+    std::vector<vt::FindHint> hints(object_count);
+    std::vector<long> nearest_k_vec;
+    size_t plain_visited_total = 0;
+    size_t hint_visited_total  = 0;
+    double plain_ms            = 0;
+    double hint_ms             = 0;
+    for(int frame = 0; frame < frame_count; frame++) {
+        for(int i = 0; i < object_count; i++) {
+            positions[i] = bounds.wrap(positions[i] + velocities[i]);
+            octree.move(i, positions[i]);
+        }
+        octree.rebalance();
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < object_count; i++) {
+            int visited_node_count = 0;
+            nearest_k_vec.clear();
+            octree.find(positions[i], FIND_K, &nearest_k_vec, FIND_RADIUS, &visited_node_count);
+            plain_visited_total += visited_node_count;
+        }
+        plain_ms += elapsed_ms(start_time);
+        start_time = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < object_count; i++) {
+            int visited_node_count = 0;
+            nearest_k_vec.clear();
+            octree.find(positions[i], FIND_K, &nearest_k_vec, FIND_RADIUS, &visited_node_count, &hints[i]);
+            hint_visited_total += visited_node_count;
+        }
+        hint_ms += elapsed_ms(start_time);
+    }
+    double query_count = static_cast<double>(object_count) * frame_count;
+    printf("  no hint: %7.1f visited nodes/query, %7.3f us/query\n", plain_visited_total / query_count, plain_ms * 1000 / query_count);
+    printf("  hint:    %7.1f visited nodes/query, %7.3f us/query, %ld hits, %ld misses\n",
+           hint_visited_total / query_count,
+           hint_ms * 1000 / query_count,
+           octree.get_hint_hit_count(),
+           octree.get_hint_miss_count());
+}
+
+// LIDAR-like rays against axis-aligned boxes: octree raycast vs. testing every box
+static void bench_raycast(int box_count, int ray_count)
+{
+    vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM);
+    std::vector<glm::vec3> box_mins(box_count);
+    std::vector<glm::vec3> box_maxs(box_count);
+    for(int i = 0; i < box_count; i++) {
+        box_mins[i] = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM - glm::vec3(BOX_DIM_MAX));
+        box_maxs[i] = box_mins[i] + rand_vec(glm::vec3(BOX_DIM_MIN), glm::vec3(BOX_DIM_MAX));
+        octree.insert_box(i, box_mins[i], box_maxs[i]);
+    }
+    std::vector<glm::vec3> ray_origins(ray_count);
+    std::vector<glm::vec3> ray_dirs(ray_count);
+    for(int i = 0; i < ray_count; i++) {
+        ray_origins[i] = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+        ray_dirs[i]    = glm::normalize(rand_vec(glm::vec3(-1), glm::vec3(1)));
+    }
+
+    printf("raycast: %d boxes, %d rays\n", box_count, ray_count);
+    int    hit_count = 0;
+    double hit_dist  = 0;
+    std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < ray_count; i++) {
+        vt::RayHit hit;
+        if(octree.raycast(ray_origins[i], ray_dirs[i], BIG_NUMBER, &hit)) {
+            hit_count++;
+            hit_dist += hit.m_dist;
+        }
+    }
+    printf("  octree:    %7.3f us/ray (%d hits, %.3f mean distance)\n", elapsed_ms(start_time) * 1000 / ray_count, hit_count, hit_dist / std::max(hit_count, 1));
+
+    hit_count = 0;
+    hit_dist  = 0;
+    start_time = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < ray_count; i++) {
+        glm::vec3 inv_dir      = glm::vec3(1) / ray_dirs[i];
+        float     nearest_dist = BIG_NUMBER;
+        bool      hit          = false;
+        for(int j = 0; j < box_count; j++) {
+            glm::vec3 t0 = (box_mins[j] - ray_origins[i]) * inv_dir;
+            glm::vec3 t1 = (box_maxs[j] - ray_origins[i]) * inv_dir;
+            glm::vec3 t_near = glm::min(t0, t1);
+            glm::vec3 t_far  = glm::max(t0, t1);
+            float enter = std::max(std::max(std::max(t_near.x, t_near.y), t_near.z), 0.0f);
+            float exit  = std::min(std::min(t_far.x, t_far.y), t_far.z);
+            if(enter <= exit && enter < nearest_dist) {
+                nearest_dist = enter;
+                hit          = true;
+            }
+        }
+        if(hit) {
+            hit_count++;
+            hit_dist += nearest_dist;
+        }
+    }
+    printf("  every box: %7.3f us/ray (%d hits, %.3f mean distance)\n", elapsed_ms(start_time) * 1000 / ray_count, hit_count, hit_dist / std::max(hit_count, 1));
+}
+
+// moving boxes, all overlapping pairs every frame: tight vs. loose octree (move_box + all_overlapping_pairs) vs. every pair
+static void bench_pairs(int box_count, int frame_count)
+{
+    vt::BBoxObject bounds(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM - glm::vec3(BOX_DIM_MAX));
+    std::vector<glm::vec3> box_mins(box_count);
+    std::vector<glm::vec3> box_dims(box_count);
+    std::vector<glm::vec3> velocities(box_count);
+    for(int i = 0; i < box_count; i++) {
+        box_mins[i]   = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM - glm::vec3(BOX_DIM_MAX));
+        box_dims[i]   = rand_vec(glm::vec3(BOX_DIM_MIN), glm::vec3(BOX_DIM_MAX));
+        velocities[i] = rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX));
+    }
+
+    printf("pairs: %d boxes, %d frames\n", box_count, frame_count);
+    for(int pass = 0; pass < 2; pass++) {
+        float looseness = pass ? 2.0f : 1.0f;
+        std::vector<glm::vec3> mins(box_mins);
+        vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM);
+        octree.set_looseness(looseness);
+        for(int i = 0; i < box_count; i++) {
+            octree.insert_box(i, mins[i], mins[i] + box_dims[i]);
+        }
+        std::vector<std::pair<long, long> > pairs;
+        size_t pair_total = 0;
+        double move_ms    = 0;
+        double pairs_ms   = 0;
+        for(int frame = 0; frame < frame_count; frame++) {
+            std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+            for(int i = 0; i < box_count; i++) {
+                mins[i] = bounds.wrap(mins[i] + velocities[i]);
+                octree.move_box(i, mins[i], mins[i] + box_dims[i]);
+            }
+            move_ms += elapsed_ms(start_time);
+            start_time = std::chrono::high_resolution_clock::now();
+            pairs.clear();
+            octree.all_overlapping_pairs(&pairs);
+            pairs_ms   += elapsed_ms(start_time);
+            pair_total += pairs.size();
+        }
+        printf("  looseness %.1f: %8.3f ms/frame move_box, %8.3f ms/frame pairs (%.1f pairs/frame)\n",
+               looseness,
+               move_ms / frame_count,
+               pairs_ms / frame_count,
+               static_cast<double>(pair_total) / frame_count);
+    }
+
+    std::vector<glm::vec3> mins(box_mins);
+    size_t pair_total = 0;
+    double pairs_ms   = 0;
+    for(int frame = 0; frame < frame_count; frame++) {
+        for(int i = 0; i < box_count; i++) {
+            mins[i] = bounds.wrap(mins[i] + velocities[i]);
+        }
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < box_count; i++) {
+            glm::vec3 max = mins[i] + box_dims[i];
+            for(int j = i + 1; j < box_count; j++) {
+                glm::vec3 other_max = mins[j] + box_dims[j];
+                if(mins[i].x <= other_max.x && mins[j].x <= max.x &&
+                   mins[i].y <= other_max.y && mins[j].y <= max.y &&
+                   mins[i].z <= other_max.z && mins[j].z <= max.z)
+                {
+                    pair_total++;
+                }
+            }
+        }
+        pairs_ms += elapsed_ms(start_time);
+    }
+    printf("  every pair:    %8.3f ms/frame pairs (%.1f pairs/frame)\n",
+           pairs_ms / frame_count,
+           static_cast<double>(pair_total) / frame_count);
+}
+
+// barnes-hut gravity on every body at several opening angles, error measured against direct summation
+static void bench_gravity(int body_count, int frame_count)
+{
+    vt::BBoxObject bounds(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+    std::vector<glm::vec3> positions(body_count);
+    std::vector<glm::vec3> velocities(body_count);
+    std::vector<float>     masses(body_count);
+    vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM, vt::OctreeConfig(16, 8));
+    for(int i = 0; i < body_count; i++) {
+        positions[i]  = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+        velocities[i] = rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX));
+        masses[i]     = rand_float(0.5, 1.5);
+        octree.insert(i, positions[i], masses[i]);
+    }
+
+    // direct sum for a few bodies
+    int sample_count = std::min(body_count, GRAVITY_SAMPLE_COUNT);
+    std::vector<glm::vec3> exact_accelerations(sample_count);
+    for(int i = 0; i < sample_count; i++) {
+        for(int j = 0; j < body_count; j++) {
+            glm::vec3 offset     = positions[j] - positions[i];
+            float     soft_dist2 = glm::dot(offset, offset) + GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+            exact_accelerations[i] += offset * (masses[j] / (soft_dist2 * sqrtf(soft_dist2)));
+        }
+    }
+
+    printf("gravity: %d bodies, %d frames\n", body_count, frame_count);
+    vt::ThreadPool thread_pool;
+    std::vector<glm::vec3> accelerations;
+    float thetas[] = {0.3, 0.5, 0.7, 1.0};
+    for(int j = 0; j < static_cast<int>(sizeof(thetas) / sizeof(thetas[0])); j++) {
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        for(int frame = 0; frame < frame_count; frame++) {
+            octree.gravity_batch(positions, thetas[j], GRAVITY_SOFTENING, &accelerations, &thread_pool);
+        }
+        double gravity_ms = elapsed_ms(start_time) / frame_count;
+        double error2 = 0;
+        double exact2 = 0;
+        for(int i = 0; i < sample_count; i++) {
+            glm::vec3 error = accelerations[i] - exact_accelerations[i];
+            error2 += glm::dot(error, error);
+            exact2 += glm::dot(exact_accelerations[i], exact_accelerations[i]);
+        }
+        printf("  theta %.1f: %9.3f ms/frame, %.2e rms relative error\n", thetas[j], gravity_ms, sqrt(error2 / exact2));
+    }
+
+    // keeping the mass aggregates current under motion
+    std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+    for(int frame = 0; frame < frame_count; frame++) {
+        for(int i = 0; i < body_count; i++) {
+            positions[i] = bounds.wrap(positions[i] + velocities[i]);
+            octree.move(i, positions[i]);
+        }
+        octree.rebalance();
+    }
+    printf("  move + rebalance: %9.3f ms/frame\n", elapsed_ms(start_time) / frame_count);
+}
+
+// squared distances of the k nearest positions to target (within radius unless negative), ascending, skipping skip_id
+static void brute_force_find(const std::vector<glm::vec3>& positions,
+                             glm::vec3                     target,
+                             int                           k,
+                             float                         radius,
+                             long                          skip_id,
+                             std::vector<float>*           nearest_k_dist2)
+{
+    nearest_k_dist2->clear();
+    for(int i = 0; i < static_cast<int>(positions.size()); i++) {
+        glm::vec3 offset = positions[i] - target;
+        float     dist2  = glm::dot(offset, offset);
+        if(i != skip_id && (radius < 0 || dist2 <= radius * radius)) {
+            nearest_k_dist2->push_back(dist2);
+        }
+    }
+    std::sort(nearest_k_dist2->begin(), nearest_k_dist2->end());
+    if(static_cast<int>(nearest_k_dist2->size()) > k) {
+        nearest_k_dist2->resize(k);
+    }
+}
+
+// ids found by the octree are distinct, nearest first, and as near as the brute force ones (ties may pick other ids)
+static bool match_brute_force(const std::vector<glm::vec3>& positions,
+                              glm::vec3                     target,
+                              const long*                   ids,
+                              int                           count,
+                              const std::vector<float>&     expected_dist2)
+{
+    if(count != static_cast<int>(expected_dist2.size())) {
+        return false;
+    }
+    std::vector<long> sorted_ids(ids, ids + count);
+    std::sort(sorted_ids.begin(), sorted_ids.end());
+    if(std::unique(sorted_ids.begin(), sorted_ids.end()) != sorted_ids.end()) {
+        return false;
+    }
+    float prev_dist2 = 0;
+    for(int i = 0; i < count; i++) {
+        if(ids[i] < 0 || ids[i] >= static_cast<long>(positions.size())) {
+            return false;
+        }
+        glm::vec3 offset    = positions[ids[i]] - target;
+        float     dist2     = glm::dot(offset, offset);
+        float     tolerance = CHECK_TOLERANCE * std::max(expected_dist2[i], 1.0f);
+        if(fabs(dist2 - expected_dist2[i]) > tolerance || dist2 < prev_dist2 - tolerance) {
+            return false;
+        }
+        prev_dist2 = dist2;
+    }
+    return true;
+}
+
+// boid-like motion, then every query flavor against brute force: find at random points, find with hints, find_batch
+// (serial and across the pool, with hints) and knn_graph at every object; returns the number of mismatched queries
+static int bench_check(int object_count, int frame_count)
+{
+    vt::BBoxObject bounds(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+    std::vector<glm::vec3> positions(object_count);
+    std::vector<glm::vec3> velocities(object_count);
+    vt::Octree octree(OCTREE_ORIGIN, OCTREE_DIM);
+    for(int i = 0; i < object_count; i++) {
+        positions[i]  = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+        velocities[i] = rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX)) * 10.0f; // cross leaves often
+        octree.insert(i, positions[i]);
+    }
+
+    printf("check: %d objects, %d frames, k=%d\n", object_count, frame_count, FIND_K);
+    vt::ThreadPool thread_pool;
+    std::vector<vt::FindHint> hints(object_count);
+    std::vector<vt::FindHint> batch_hints;
+    std::vector<long>         nearest_k_vec;
+    std::vector<float>        expected_dist2;
+    vt::FindBatchResults      results;
+    vt::FindBatchResults      pool_results;
+    vt::KnnGraph              graph;
+    int find_mismatch_count  = 0;
+    int hint_mismatch_count  = 0;
+    int batch_mismatch_count = 0;
+    int graph_mismatch_count = 0;
+    for(int frame = 0; frame < frame_count; frame++) {
+        for(int i = 0; i < object_count; i++) {
+            positions[i] = bounds.wrap(positions[i] + velocities[i]);
+            octree.move(i, positions[i]);
+        }
+        octree.rebalance();
+        for(int pass = 0; pass < 2; pass++) {
+            float radius = pass ? FIND_RADIUS : -1;
+            for(int i = 0; i < object_count; i++) {
+                glm::vec3 target = rand_vec(OCTREE_ORIGIN, OCTREE_ORIGIN + OCTREE_DIM);
+                brute_force_find(positions, target, FIND_K, radius, -1, &expected_dist2);
+                nearest_k_vec.clear();
+                octree.find(target, FIND_K, &nearest_k_vec, radius);
+                find_mismatch_count += !match_brute_force(positions, target, nearest_k_vec.data(), nearest_k_vec.size(), expected_dist2);
+            }
+            octree.find_batch(positions, FIND_K, radius, &results);
+            octree.find_batch(positions, FIND_K, radius, &pool_results, &thread_pool, &batch_hints);
+            for(int i = 0; i < object_count; i++) {
+                brute_force_find(positions, positions[i], FIND_K, radius, -1, &expected_dist2);
+                nearest_k_vec.clear();
+                octree.find(positions[i], FIND_K, &nearest_k_vec, radius, NULL, &hints[i]);
+                hint_mismatch_count  += !match_brute_force(positions, positions[i], nearest_k_vec.data(), nearest_k_vec.size(), expected_dist2);
+                batch_mismatch_count += !match_brute_force(positions, positions[i], results.m_ids.data() + results.m_offsets[i], results.m_counts[i], expected_dist2);
+                batch_mismatch_count += !match_brute_force(positions, positions[i], pool_results.m_ids.data() + pool_results.m_offsets[i], pool_results.m_counts[i], expected_dist2);
+            }
+            octree.knn_graph(FIND_K, radius, &graph, &thread_pool);
+            if(static_cast<int>(graph.m_ids.size()) != object_count) {
+                graph_mismatch_count += object_count;
+                continue;
+            }
+            for(int i = 0; i < object_count; i++) {
+                long id = graph.m_ids[i];
+                brute_force_find(positions, positions[id], FIND_K, radius, id, &expected_dist2);
+                graph_mismatch_count += !match_brute_force(positions,
+                                                           positions[id],
+                                                           graph.m_neighbor_ids.data() + graph.m_offsets[i],
+                                                           graph.m_offsets[i + 1] - graph.m_offsets[i],
+                                                           expected_dist2);
+            }
+        }
+    }
+    int query_count = object_count * frame_count * 2;
+    printf("  find:             %d of %d queries mismatched\n", find_mismatch_count, query_count);
+    printf("  find with hints:  %d of %d queries mismatched\n", hint_mismatch_count, query_count);
+    printf("  find_batch:       %d of %d queries mismatched\n", batch_mismatch_count, query_count * 2);
+    printf("  knn_graph:        %d of %d rows mismatched\n", graph_mismatch_count, query_count);
+    int mismatch_count = find_mismatch_count + hint_mismatch_count + batch_mismatch_count + graph_mismatch_count;
+    printf("  %s\n", mismatch_count ? "FAILED" : "passed");
+    return mismatch_count;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* mode = (argc > 1) ? argv[1] : "update";
+    int object_count = (argc > 2) ? atoi(argv[2]) : 0;
+    int frame_count  = (argc > 3) ? atoi(argv[3]) : 0;
+    if(object_count < 0 || frame_count < 0 || (strcmp(mode, "update") && strcmp(mode, "build") && strcmp(mode, "find") && strcmp(mode, "graph") && strcmp(mode, "coherence") && strcmp(mode, "raycast") && strcmp(mode, "pairs") && strcmp(mode, "gravity") && strcmp(mode, "check"))) {
+        fprintf(stderr, "Usage: %s [update|build|find|graph|coherence|raycast|pairs|gravity|check] [object_count] [frame_count]\n", argv[0]);
+        return 1;
+    }
+    srand(0);
+    if(!strcmp(mode, "update")) {
+        if(bench_update(object_count ? object_count : DEFAULT_OBJECT_COUNT,
+                        frame_count  ? frame_count  : DEFAULT_FRAME_COUNT))
+        {
+            return 1;
+        }
+    } else if(!strcmp(mode, "find")) {
+        bench_find(object_count ? object_count : DEFAULT_OBJECT_COUNT,
+                   frame_count  ? frame_count  : FIND_QUERY_COUNT);
+    } else if(!strcmp(mode, "graph")) {
+        bench_graph(object_count ? object_count : DEFAULT_OBJECT_COUNT,
+                    frame_count  ? frame_count  : BUILD_FRAME_COUNT);
+    } else if(!strcmp(mode, "coherence")) {
+        bench_coherence(object_count ? object_count : DEFAULT_OBJECT_COUNT,
+                        frame_count  ? frame_count  : BUILD_FRAME_COUNT);
+    } else if(!strcmp(mode, "raycast")) {
+        if(object_count) {
+            bench_raycast(object_count, frame_count ? frame_count : RAY_COUNT);
+        } else {
+            bench_raycast(10,   frame_count ? frame_count : RAY_COUNT);
+            bench_raycast(100,  frame_count ? frame_count : RAY_COUNT);
+            bench_raycast(1000, frame_count ? frame_count : RAY_COUNT);
+        }
+    } else if(!strcmp(mode, "pairs")) {
+        bench_pairs(object_count ? object_count : DEFAULT_OBJECT_COUNT,
+                    frame_count  ? frame_count  : BUILD_FRAME_COUNT);
+    } else if(!strcmp(mode, "gravity")) {
+        if(object_count) {
+            bench_gravity(object_count, frame_count ? frame_count : BUILD_FRAME_COUNT);
+        } else {
+            bench_gravity(10000,  frame_count ? frame_count : BUILD_FRAME_COUNT);
+            bench_gravity(100000, frame_count ? frame_count : 1);
+        }
+    } else if(!strcmp(mode, "check")) {
+        if(bench_check(object_count ? object_count : DEFAULT_OBJECT_COUNT,
+                       frame_count  ? frame_count  : CHECK_FRAME_COUNT))
+        {
+            return 1;
+        }
+    } else if(object_count) {
+        bench_build(object_count, frame_count ? frame_count : BUILD_FRAME_COUNT);
+    } else {
+        bench_build(1000,   frame_count ? frame_count : BUILD_FRAME_COUNT);
+        bench_build(10000,  frame_count ? frame_count : BUILD_FRAME_COUNT);
+        bench_build(100000, frame_count ? frame_count : BUILD_FRAME_COUNT);
+    }
+    return 0;
+}
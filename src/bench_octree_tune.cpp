@@ -0,0 +1,253 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Headless Octree tuning sweep (no GL context required).
+ * Replays recorded position streams (press 'o' in main_boids / main_nbody) through
+ * every node capacity / depth limit pair and reports the fastest one for each.
+ * Author: onlyuser
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <glm/glm.hpp>
+#include <Octree.h>
+#include <PositionStream.h>
+#include <Util.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+#define SYNTH_OBJECT_COUNT     1000
+#define SYNTH_FRAME_COUNT      200
+#define SYNTH_DIM              glm::vec3(10)
+#define SYNTH_ATTRACTOR_COUNT  4
+#define FIND_K                 20
+#define FIND_RADIUS_FRACTION   0.1f // of the largest stream extent
+#define OBJECT_SPEED_MAX       0.05f
+#define GRAVITATIONAL_CONSTANT 0.0005f
+#define SOFTENING              0.1f
+
+static const int node_capacities[] = {2, 4, 5, 8, 16, 32, 64};
+static const int depth_limits[]    = {2, 3, 4, 5, 6, 7, 8};
+
+struct TuneResult
+{
+    vt::OctreeConfig m_config;
+    double           m_update_ms; // move + rebalance, per frame
+    double           m_query_ms;  // knn_graph, per frame
+};
+
+static float rand_float(float min_value, float max_value)
+{
+    return LERP(min_value, max_value, static_cast<float>(rand()) / RAND_MAX);
+}
+
+static glm::vec3 rand_vec(glm::vec3 min_value, glm::vec3 max_value)
+{
+    return glm::vec3(rand_float(min_value.x, max_value.x),
+                     rand_float(min_value.y, max_value.y),
+                     rand_float(min_value.z, max_value.z));
+}
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start_time)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
+
+static glm::vec3 wrap(glm::vec3 pos, glm::vec3 min, glm::vec3 max)
+{
+    glm::vec3 dim = max - min;
+    for(int i = 0; i < 3; i++) {
+        if(pos[i] < min[i]) {
+            pos[i] += dim[i];
+        } else if(pos[i] > max[i]) {
+            pos[i] -= dim[i];
+        }
+    }
+    return pos;
+}
+
+// boid-like: constant speed, heading eased toward one of a few wandering attractors, wrapped
+static void synth_boids_stream(int object_count, int frame_count, vt::PositionStream* stream)
+{
+    glm::vec3 min = -SYNTH_DIM * 0.5f;
+    glm::vec3 max =  SYNTH_DIM * 0.5f;
+    std::vector<glm::vec3> positions(object_count);
+    std::vector<glm::vec3> velocities(object_count);
+    glm::vec3 attractors[SYNTH_ATTRACTOR_COUNT];
+    for(int i = 0; i < SYNTH_ATTRACTOR_COUNT; i++) {
+        attractors[i] = rand_vec(min, max);
+    }
+    for(int i = 0; i < object_count; i++) {
+        positions[i]  = rand_vec(min, max);
+        velocities[i] = rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX));
+    }
+    stream->clear(object_count);
+    for(int frame = 0; frame < frame_count; frame++) {
+        for(int i = 0; i < SYNTH_ATTRACTOR_COUNT; i++) {
+            attractors[i] = wrap(attractors[i] + rand_vec(glm::vec3(-OBJECT_SPEED_MAX), glm::vec3(OBJECT_SPEED_MAX)), min, max);
+        }
+        for(int i = 0; i < object_count; i++) {
+            glm::vec3 heading = glm::normalize(attractors[i % SYNTH_ATTRACTOR_COUNT] - positions[i] + glm::vec3(0.001f));
+            velocities[i] = glm::normalize(LERP(velocities[i], heading * OBJECT_SPEED_MAX, 0.05f) + glm::vec3(0.0001f)) * OBJECT_SPEED_MAX;
+            positions[i]  = wrap(positions[i] + velocities[i], min, max);
+        }
+        stream->add_frame(&positions[0]);
+    }
+}
+
+// n-body-like: softened all-pairs gravity, so objects clump instead of staying uniform
+static void synth_nbody_stream(int object_count, int frame_count, vt::PositionStream* stream)
+{
+    glm::vec3 min = -SYNTH_DIM * 0.5f;
+    glm::vec3 max =  SYNTH_DIM * 0.5f;
+    std::vector<glm::vec3> positions(object_count);
+    std::vector<glm::vec3> velocities(object_count);
+    for(int i = 0; i < object_count; i++) {
+        positions[i] = rand_vec(min, max);
+    }
+    stream->clear(object_count);
+    for(int frame = 0; frame < frame_count; frame++) {
+        for(int i = 0; i < object_count; i++) {
+            glm::vec3 accel;
+            for(int j = 0; j < object_count; j++) {
+                glm::vec3 offset = positions[j] - positions[i];
+                float     dist2  = glm::dot(offset, offset) + SOFTENING * SOFTENING;
+                accel += offset * (GRAVITATIONAL_CONSTANT / (dist2 * sqrtf(dist2)));
+            }
+            velocities[i] += accel;
+            if(glm::length(velocities[i]) > OBJECT_SPEED_MAX) {
+                velocities[i] = glm::normalize(velocities[i]) * OBJECT_SPEED_MAX;
+            }
+        }
+        for(int i = 0; i < object_count; i++) {
+            positions[i] = wrap(positions[i] + velocities[i], min, max);
+        }
+        stream->add_frame(&positions[0]);
+    }
+}
+
+static void get_stream_bounds(const vt::PositionStream& stream, glm::vec3* min, glm::vec3* max)
+{
+    *min = glm::vec3(BIG_NUMBER);
+    *max = glm::vec3(-BIG_NUMBER);
+    for(int frame = 0; frame < stream.get_frame_count(); frame++) {
+        const glm::vec3* positions = stream.get_frame(frame);
+        for(int i = 0; i < stream.get_object_count(); i++) {
+            *min = glm::min(*min, positions[i]);
+            *max = glm::max(*max, positions[i]);
+        }
+    }
+}
+
+static TuneResult replay_stream(const vt::PositionStream& stream, glm::vec3 min, glm::vec3 max, float radius, vt::OctreeConfig config)
+{
+    TuneResult result;
+    result.m_config    = config;
+    result.m_update_ms = 0;
+    result.m_query_ms  = 0;
+    vt::Octree octree(min, max - min, config);
+    vt::KnnGraph graph;
+    const glm::vec3* positions = stream.get_frame(0);
+    for(int i = 0; i < stream.get_object_count(); i++) {
+        octree.insert(i, positions[i]);
+    }
+    for(int frame = 1; frame < stream.get_frame_count(); frame++) {
+        positions = stream.get_frame(frame);
+        std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+        for(int i = 0; i < stream.get_object_count(); i++) {
+            octree.move(i, positions[i]);
+        }
+        octree.rebalance();
+        result.m_update_ms += elapsed_ms(start_time);
+        start_time = std::chrono::high_resolution_clock::now();
+        octree.knn_graph(FIND_K, radius, &graph);
+        result.m_query_ms += elapsed_ms(start_time);
+    }
+    int frame_count = std::max(stream.get_frame_count() - 1, 1);
+    result.m_update_ms /= frame_count;
+    result.m_query_ms  /= frame_count;
+    return result;
+}
+
+static void tune_stream(std::string name, const vt::PositionStream& stream)
+{
+    glm::vec3 min, max;
+    get_stream_bounds(stream, &min, &max);
+    glm::vec3 dim = max - min;
+    min -= dim * 0.01f; // keep boundary objects strictly inside
+    max += dim * 0.01f;
+    float radius = std::max(dim.x, std::max(dim.y, dim.z)) * FIND_RADIUS_FRACTION;
+    printf("%s: %d objects, %d frames, knn_graph k=%d radius %.2f\n",
+           name.c_str(), stream.get_object_count(), stream.get_frame_count(), FIND_K, radius);
+    printf("  capacity depth  update ms/frame  query ms/frame\n");
+    std::vector<TuneResult> results;
+    for(size_t i = 0; i < sizeof(node_capacities) / sizeof(node_capacities[0]); i++) {
+        for(size_t j = 0; j < sizeof(depth_limits) / sizeof(depth_limits[0]); j++) {
+            TuneResult result = replay_stream(stream, min, max, radius, vt::OctreeConfig(node_capacities[i], depth_limits[j]));
+            printf("  %8d %5d  %15.3f  %14.3f\n",
+                   result.m_config.m_node_capacity,
+                   result.m_config.m_depth_limit,
+                   result.m_update_ms,
+                   result.m_query_ms);
+            results.push_back(result);
+        }
+    }
+    const TuneResult* best_update = &results[0];
+    const TuneResult* best_query  = &results[0];
+    const TuneResult* best_total  = &results[0];
+    for(std::vector<TuneResult>::const_iterator p = results.begin(); p != results.end(); p++) {
+        if((*p).m_update_ms < best_update->m_update_ms) {
+            best_update = &(*p);
+        }
+        if((*p).m_query_ms < best_query->m_query_ms) {
+            best_query = &(*p);
+        }
+        if((*p).m_update_ms + (*p).m_query_ms < best_total->m_update_ms + best_total->m_query_ms) {
+            best_total = &(*p);
+        }
+    }
+    printf("  best update: capacity %d, depth %d (%.3f ms/frame)\n",
+           best_update->m_config.m_node_capacity, best_update->m_config.m_depth_limit, best_update->m_update_ms);
+    printf("  best query:  capacity %d, depth %d (%.3f ms/frame)\n",
+           best_query->m_config.m_node_capacity, best_query->m_config.m_depth_limit, best_query->m_query_ms);
+    printf("  best total:  capacity %d, depth %d (%.3f ms/frame)\n",
+           best_total->m_config.m_node_capacity, best_total->m_config.m_depth_limit, best_total->m_update_ms + best_total->m_query_ms);
+}
+
+int main(int argc, char* argv[])
+{
+    srand(0);
+    if(argc > 1) {
+        for(int i = 1; i < argc; i++) {
+            vt::PositionStream stream;
+            if(!stream.load(argv[i]) || stream.get_frame_count() < 2) {
+                fprintf(stderr, "Error: cannot load position stream \"%s\"\n", argv[i]);
+                return 1;
+            }
+            tune_stream(argv[i], stream);
+        }
+        return 0;
+    }
+    vt::PositionStream stream;
+    synth_boids_stream(SYNTH_OBJECT_COUNT, SYNTH_FRAME_COUNT, &stream);
+    tune_stream("synthetic boids", stream);
+    synth_nbody_stream(SYNTH_OBJECT_COUNT, SYNTH_FRAME_COUNT, &stream);
+    tune_stream("synthetic nbody", stream);
+    return 0;
+}
@@ -42,18 +42,21 @@
 #include <Camera.h>
 #include <Octree.h>
 #include <File3ds.h>
+#include <FlockSimulator.h>
 #include <FrameBuffer.h>
 #include <Light.h>
 #include <Material.h>
 #include <Mesh.h>
 #include <Modifiers.h>
 #include <Octree.h>
+#include <PositionStream.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
 #include <Texture.h>
+#include <ThreadPool.h>
 #include <Util.h>
 #include <VarAttribute.h>
 #include <VarUniform.h>
@@ -63,13 +66,8 @@
 #include <iomanip> // std::setprecision
 #include <math.h>
 
-#define BOID_AVOID_RADIUS            0.25f
-#define BOID_FLOCKING_RADIUS         4
-#define BOID_NEAREST_NEIGHBOR_RADIUS 2
-#define BOID_OBSTACLE_AVOID_RADIUS   2
-#define BOID_OBSTACLE_REVERSE_RADIUS 1
-
-#define BOID_COUNT            40 //100
+#define BOID_COUNT            40   // default when not given on the command line
+#define BOID_MESH_COUNT_MAX   1000 // boids past this have no mesh and are drawn as points
 #define BOID_DIM              glm::vec3(0.0625, 0.0625, 0.25)
 #define BOID_INIT_SCATTER_MAX glm::vec3(5)
 #define BOID_INIT_SCATTER_MIN glm::vec3(-5)
@@ -80,17 +78,10 @@
 #define OBSTACLE_INIT_SCATTER_MAX glm::vec3(5)
 #define OBSTACLE_INIT_SCATTER_MIN glm::vec3(-5)
 
-#define BOID_ANGLE_DELTA                          2.5f
-#define BOID_AVOID_ANGLE_DELTA                    5.0f
-#define BOID_FLOCKING_COHESION_TO_ALIGNMENT_RATIO 0.25f
-#define BOID_MAX_HEADING_DEVIATION                90
-#define BOID_MAX_FOV_DEVIATION                    180
-#define BOID_FORWARD_SPEED_MIN                    0.025f
-#define BOID_FORWARD_SPEED_MAX                    0.05f
-#define BOID_LIDAR_FOV                            15.0f
-#define BOID_NEAREST_NEIGHBOR_COUNT               5
-#define OCTREE_ORIGIN                             glm::vec3(-5)
-#define OCTREE_DIM                                glm::vec3(10)
+#define BOID_FORWARD_SPEED_MIN 0.025f
+#define BOID_FORWARD_SPEED_MAX 0.05f
+#define OCTREE_ORIGIN          glm::vec3(-5)
+#define OCTREE_DIM             glm::vec3(10)
 
 //#define DEBUG 1
 
@@ -99,13 +90,15 @@ const char* DEFAULT_CAPTION = "";
 int init_screen_width  = 800,
     init_screen_height = 600;
 vt::Camera  *camera         = NULL;
-vt::Octree  *octree         = NULL;
+vt::Octree  *obstacle_octree = NULL;
+vt::FlockSimulator *flock_simulator = NULL;
 vt::Mesh    *mesh_skybox    = NULL,
             *box            = NULL;
 vt::Light   *light          = NULL,
             *light2         = NULL,
             *light3         = NULL;
 vt::Texture *texture_skybox = NULL;
+vt::ThreadPool *thread_pool = NULL;
 
 bool left_mouse_down  = false,
      right_mouse_down = false;
@@ -146,10 +139,13 @@ int angle_delta = 1;
 int target_index = 7;
 glm::vec3 targets[8];
 
+int boid_count = BOID_COUNT;
 std::vector<vt::Mesh*> boid_meshes;
-float boid_speeds[BOID_COUNT];
+vt::PositionStream position_stream;
+bool record_positions = false;
 
 std::vector<vt::Mesh*> obstacle_meshes;
+vt::Octree::ray_hit_func_t obstacle_hit_func;
 
 static void randomize_meshes(std::vector<vt::Mesh*>* meshes,
                              glm::vec3               scatter_min,
@@ -166,31 +162,50 @@ static void randomize_meshes(std::vector<vt::Mesh*>* meshes,
     }
 }
 
-static void randomize_boids(std::vector<vt::Mesh*>* boid_meshes,
-                            glm::vec3               scatter_min,
-                            glm::vec3               scatter_max)
+// obstacle i is box i in obstacle octree
+static void index_obstacles(vt::Octree* obstacle_octree, std::vector<vt::Mesh*>* obstacle_meshes)
 {
-    randomize_meshes(boid_meshes,
-                     scatter_min,
-                     scatter_max);
-    size_t boid_count = boid_meshes->size();
-    for(int i = 0; i < static_cast<int>(boid_count); i++) {
-        boid_speeds[i] = BOID_FORWARD_SPEED_MIN + (BOID_FORWARD_SPEED_MAX - BOID_FORWARD_SPEED_MIN) * static_cast<float>(rand()) / RAND_MAX;
+    obstacle_octree->clear();
+    long index = 0;
+    for(std::vector<vt::Mesh*>::iterator p = obstacle_meshes->begin(); p != obstacle_meshes->end(); p++) {
+        glm::vec3 min, max;
+        (*p)->get_abs_min_max(*p, &min, &max);
+        obstacle_octree->insert_box(index, min, max);
+        (*p)->get_normal_transform(); // fill transform caches now, LIDAR rays test obstacles from several threads
+        index++;
+    }
+}
+
+// boid state lives in the flock simulator only, meshes just mirror the first few boids
+static void randomize_boids(vt::FlockSimulator* flock_simulator,
+                            int                 boid_count,
+                            glm::vec3           scatter_min,
+                            glm::vec3           scatter_max)
+{
+    flock_simulator->clear_agents();
+    for(int i = 0; i < boid_count; i++) {
+        glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
+                           static_cast<float>(rand()) / RAND_MAX,
+                           static_cast<float>(rand()) / RAND_MAX);
+        glm::mat4 rotation_transform = GLM_EULER_TRANSFORM(-180 + static_cast<float>(rand()) / RAND_MAX * 360,
+                                                           -90  + static_cast<float>(rand()) / RAND_MAX * 90,
+                                                           -180 + static_cast<float>(rand()) / RAND_MAX * 360);
+        flock_simulator->add_agent(LERP(scatter_min, scatter_max, rand_vec),
+                                   glm::vec3(rotation_transform * glm::vec4(VEC_FORWARD, 0)),
+                                   glm::vec3(rotation_transform * glm::vec4(VEC_UP, 0)),
+                                   BOID_FORWARD_SPEED_MIN + (BOID_FORWARD_SPEED_MAX - BOID_FORWARD_SPEED_MIN) * static_cast<float>(rand()) / RAND_MAX);
     }
 }
 
 static void create_boids(vt::Scene*              scene,
                          std::vector<vt::Mesh*>* boid_meshes,
                          int                     boid_count,
-                         glm::vec3               scatter_min,
-                         glm::vec3               scatter_max,
                          glm::vec3               box_dim,
                          std::string             name)
 {
     if(!scene || !boid_meshes) {
         return;
     }
-    srand(time(NULL));
     for(int i = 0; i < boid_count; i++) {
         std::stringstream ss;
         ss << i;
@@ -202,11 +217,7 @@ static void create_boids(vt::Scene*              scene,
         mesh->center_axis();
         scene->add_mesh(mesh);
         boid_meshes->push_back(mesh);
-        boid_speeds[i] = BOID_FORWARD_SPEED_MIN;
     }
-    randomize_boids(boid_meshes,
-                    scatter_min,
-                    scatter_max);
 }
 
 static void create_obstacles(vt::Scene*              scene,
@@ -282,8 +293,12 @@ int init_resources()
     glm::vec3 origin = glm::vec3(0);
     camera = new vt::Camera("camera", origin + glm::vec3(0, 0, orbit_radius), origin);
     scene->set_camera(camera);
-    octree = new vt::Octree(OCTREE_ORIGIN, OCTREE_DIM);
-    scene->set_octree(octree);
+    flock_simulator = new vt::FlockSimulator(OCTREE_ORIGIN, OCTREE_DIM);
+    scene->set_octree(flock_simulator->get_octree());
+    obstacle_octree = new vt::Octree(OCTREE_ORIGIN, OCTREE_DIM);
+    thread_pool = new vt::ThreadPool();
+    flock_simulator->set_thread_pool(thread_pool);
+    flock_simulator->set_double_buffered(true);
     box = vt::PrimitiveFactory::create_box("octree", OCTREE_DIM.x, OCTREE_DIM.y, OCTREE_DIM.z);
     box->center_axis();
     box->set_origin(glm::vec3(0));
@@ -299,20 +314,20 @@ int init_resources()
     mesh_skybox->set_material(skybox_material);
     mesh_skybox->set_texture_index(mesh_skybox->get_material()->get_texture_index_by_name("skybox_texture"));
 
+    srand(time(NULL));
     create_boids(scene,
                  &boid_meshes,
-                 BOID_COUNT,
-                 BOID_INIT_SCATTER_MIN,
-                 BOID_INIT_SCATTER_MAX,
+                 std::min(boid_count, BOID_MESH_COUNT_MAX),
                  BOID_DIM,
                  "boid");
-    long index = 0;
     for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); p++) {
         (*p)->set_material(phong_material);
         (*p)->set_ambient_color(glm::vec3(0));
-        octree->insert(index, (*p)->get_origin());
-        index++;
     }
+    randomize_boids(flock_simulator,
+                    boid_count,
+                    BOID_INIT_SCATTER_MIN,
+                    BOID_INIT_SCATTER_MAX);
 
     create_obstacles(scene,
                      &obstacle_meshes,
@@ -329,6 +344,16 @@ int init_resources()
 
     // NOTE: must add last!
     obstacle_meshes.push_back(box);
+    index_obstacles(obstacle_octree, &obstacle_meshes);
+    obstacle_hit_func = [](long id, glm::vec3 ray_origin, glm::vec3 ray_dir, float* dist) {
+        vt::Mesh* obstacle_mesh = obstacle_meshes[id];
+        float nearest_distance = BIG_NUMBER;
+        obstacle_mesh->is_ray_intersect(obstacle_mesh, ray_origin, ray_dir, &nearest_distance);
+        *dist = nearest_distance;
+        return nearest_distance != BIG_NUMBER;
+    };
+    flock_simulator->set_obstacles(obstacle_octree, obstacle_hit_func);
+    flock_simulator->set_target(targets[target_index]);
 
     vt::Scene::instance()->m_debug_target = targets[target_index];
 
@@ -337,6 +362,9 @@ int init_resources()
 
 int deinit_resources()
 {
+    delete flock_simulator;
+    delete thread_pool;
+    delete obstacle_octree;
     return 1;
 }
 
@@ -363,6 +391,9 @@ void onTick()
             << "Mouse: {" << mouse_drag.x << ", " << mouse_drag.y << "}, "
             << "Yaw=" << EULER_YAW(euler) << ", Pitch=" << EULER_PITCH(euler) << ", Radius=" << orbit_radius << ", "
             << "Zoom=" << zoom;
+        if(flock_simulator->get_use_find_hints()) {
+            ss << ", Hint hits=" << flock_simulator->get_octree()->get_hint_hit_count() << ", misses=" << flock_simulator->get_octree()->get_hint_miss_count();
+        }
         //ss << "Width=" << camera->get_width() << ", Width=" << camera->get_height();
         glutSetWindowTitle(ss.str().c_str());
     }
@@ -371,229 +402,63 @@ void onTick()
         return;
     }
 
-    // clear
-    //octree->clear();
+    flock_simulator->get_octree()->reset_stats(); // hud shows this tick's counters
 
-    long index = 0;
-    for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); p++) {
-        vt::Mesh* self_object = *p;
-
-        // keep boids in octree
-        glm::vec3 self_object_pos = box->wrap(self_object->get_origin());
-        self_object->set_origin(self_object_pos);
+    // steer, move and wrap all boids
+    flock_simulator->set_target(targets[target_index]);
+    flock_simulator->step();
 
-        // add/update
-        if(octree->exists(index)) {
-            octree->move(index, self_object_pos);
-        } else {
-            octree->insert(index, self_object_pos);
-        }
-        index++;
+    // record for bench_octree_tune
+    if(record_positions) {
+        position_stream.add_frame(&flock_simulator->get_positions()[0]);
     }
 
-    // rebalance
-    octree->rebalance();
-
-    long index2 = 0;
+    const std::vector<glm::vec3>&            positions     = flock_simulator->get_positions();
+    const std::vector<glm::vec3>&            headings      = flock_simulator->get_headings();
+    const std::vector<glm::vec3>&            up_directions = flock_simulator->get_up_directions();
+    const std::vector<vt::flock_behavior_t>& behaviors     = flock_simulator->get_behaviors();
+    long index = 0;
     for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); p++) {
-        vt::Mesh* self_object         = *p;
-        glm::vec3 self_object_pos     = self_object->get_origin();
-        glm::vec3 self_object_heading = self_object->get_abs_heading();
-        float     boid_speed          = boid_speeds[index2];
+        vt::Mesh* self_object  = *p;
+        glm::vec3 up_direction = up_directions[index];
+        self_object->set_origin(positions[index]);
+        self_object->set_euler(vt::offset_to_euler(headings[index], &up_direction));
 
         self_object->m_debug_lines.clear();
 
-        float lateral_offset = BIG_NUMBER * tan(glm::radians(BOID_LIDAR_FOV));
-
-        float min_nearest_distance       = BIG_NUMBER;
-        float min_nearest_distance_up    = BIG_NUMBER;
-        float min_nearest_distance_left  = BIG_NUMBER;
-        float min_nearest_distance_right = BIG_NUMBER;
-
-        glm::vec3 nearest_dir_up = glm::normalize(self_object->in_abs_system(glm::vec3(0,
-                                                                                       lateral_offset,
-                                                                                       BIG_NUMBER)) - self_object->in_abs_system());
-        glm::vec3 nearest_dir_left = glm::normalize(self_object->in_abs_system(glm::vec3(lateral_offset * cos(glm::radians(210.0f)),
-                                                                                         lateral_offset * sin(glm::radians(210.0f)),
-                                                                                         BIG_NUMBER)) - self_object->in_abs_system());
-        glm::vec3 nearest_dir_right = glm::normalize(self_object->in_abs_system(glm::vec3(lateral_offset * cos(glm::radians(330.0f)),
-                                                                                          lateral_offset * sin(glm::radians(330.0f)),
-                                                                                          BIG_NUMBER)) - self_object->in_abs_system());
-
-        for(std::vector<vt::Mesh*>::iterator q = obstacle_meshes.begin(); q != obstacle_meshes.end(); q++) {
-            vt::Mesh* obstacle_mesh = *q;
-
-            float nearest_distance       = BIG_NUMBER;
-            float nearest_distance_up    = BIG_NUMBER;
-            float nearest_distance_left  = BIG_NUMBER;
-            float nearest_distance_right = BIG_NUMBER;
-
-            // forward
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            self_object->get_abs_heading(),
-                                            &nearest_distance);
-
-            // up
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            nearest_dir_up,
-                                            &nearest_distance_up);
-
-            // left
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            nearest_dir_left,
-                                            &nearest_distance_left);
-
-            // right
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            nearest_dir_right,
-                                            &nearest_distance_right);
-
-            if(nearest_distance < min_nearest_distance) {
-                min_nearest_distance = nearest_distance;
-            }
-            if(nearest_distance_up < min_nearest_distance_up) {
-                min_nearest_distance_up = nearest_distance_up;
-            }
-            if(nearest_distance_left < min_nearest_distance_left) {
-                min_nearest_distance_left = nearest_distance_left;
-            }
-            if(nearest_distance_right < min_nearest_distance_right) {
-                min_nearest_distance_right = nearest_distance_right;
-            }
+        // LIDAR readings
+        for(int i = vt::FLOCK_LIDAR_UP; i <= vt::FLOCK_LIDAR_RIGHT; i++) {
+            vt::flock_lidar_t lidar = static_cast<vt::flock_lidar_t>(i);
+            self_object->m_debug_lines.push_back(std::tuple<glm::vec3, glm::vec3, glm::vec3>(glm::vec3(0, 1, 1),
+                                                                                             positions[index],
+                                                                                             positions[index] + flock_simulator->get_lidar_dir(index, lidar) *
+                                                                                                                flock_simulator->get_lidar_dist(index, lidar)));
         }
 
-        //self_object->m_debug_lines.push_back(std::pair<glm::vec3, glm::vec3>(self_object->in_abs_system(),
-        //                                                                     self_object->in_abs_system(glm::vec3(0, 0, min_nearest_distance))));
-
-#if 1
-        float lateral_offset_up    = min_nearest_distance_up    * tan(glm::radians(BOID_LIDAR_FOV));
-        float lateral_offset_left  = min_nearest_distance_left  * tan(glm::radians(BOID_LIDAR_FOV));
-        float lateral_offset_right = min_nearest_distance_right * tan(glm::radians(BOID_LIDAR_FOV));
-
-        self_object->m_debug_lines.push_back(std::tuple<glm::vec3, glm::vec3, glm::vec3>(glm::vec3(0, 1, 1),
-                                                                                         self_object->in_abs_system(),
-                                                                                         self_object->in_abs_system(glm::vec3(0, lateral_offset_up, min_nearest_distance_up))));
-        self_object->m_debug_lines.push_back(std::tuple<glm::vec3, glm::vec3, glm::vec3>(glm::vec3(0, 1, 1),
-                                                                                         self_object->in_abs_system(),
-                                                                                         self_object->in_abs_system(glm::vec3(lateral_offset_left * cos(glm::radians(210.0f)),
-                                                                                                                                lateral_offset_left * sin(glm::radians(210.0f)),
-                                                                                                                                min_nearest_distance_left))));
-        self_object->m_debug_lines.push_back(std::tuple<glm::vec3, glm::vec3, glm::vec3>(glm::vec3(0, 1, 1),
-                                                                                         self_object->in_abs_system(),
-                                                                                         self_object->in_abs_system(glm::vec3(lateral_offset_right * cos(glm::radians(330.0f)),
-                                                                                                                              lateral_offset_right * sin(glm::radians(330.0f)),
-                                                                                                                              min_nearest_distance_right))));
-#endif
-
-        // obstacle normal
-        glm::vec3 nearest_obstacle_ahead  = self_object->in_abs_system() + self_object->get_abs_heading() * min_nearest_distance;
-        glm::vec3 nearest_obstacle_up     = self_object->in_abs_system() + nearest_dir_up                 * min_nearest_distance_up;
-        glm::vec3 nearest_obstacle_left   = self_object->in_abs_system() + nearest_dir_left               * min_nearest_distance_left;
-        glm::vec3 nearest_obstacle_right  = self_object->in_abs_system() + nearest_dir_right              * min_nearest_distance_right;
-        glm::vec3 nearest_obstacle_normal = glm::normalize(glm::cross(nearest_obstacle_right - nearest_obstacle_up, nearest_obstacle_left - nearest_obstacle_up));
-        //self_object->m_debug_lines.push_back(std::pair<glm::vec3, glm::vec3>(nearest_obstacle,
-        //                                                                     nearest_obstacle + nearest_obstacle_normal));
-
-        if(glm::distance(self_object_pos, nearest_obstacle_ahead) < BOID_OBSTACLE_REVERSE_RADIUS) {
-            // avoid head-on collision with obstacle
-            glm::vec3 up_direction = self_object->get_abs_up_direction();
-            self_object->set_euler(vt::offset_to_euler(-self_object->get_abs_heading(), &up_direction)); // rotate 180 degrees maintaining up direction
-        } else if(glm::distance(self_object_pos, nearest_obstacle_up)    < BOID_OBSTACLE_AVOID_RADIUS ||
-                  glm::distance(self_object_pos, nearest_obstacle_left)  < BOID_OBSTACLE_AVOID_RADIUS ||
-                  glm::distance(self_object_pos, nearest_obstacle_right) < BOID_OBSTACLE_AVOID_RADIUS)
-        {
-            // avoid glancing collision with obstacle
-            // explore deepest LIDAR reading direction
-            glm::vec3 target = nearest_obstacle_ahead + nearest_obstacle_normal;
-            self_object->update_boid(target,
-                                     boid_speed,
-                                     BOID_ANGLE_DELTA,
-                                     BOID_AVOID_RADIUS); // target homing
-            if(wireframe_mode) {
-                self_object->set_ambient_color(glm::vec3(1, 0, 1)); // magenta
-            }
-        } else {
-            // flocking behavior
-            std::vector<long> nearest_k_indices;
-            bool boid_updated = false;
-            if(octree->find(self_object_pos,
-                            BOID_NEAREST_NEIGHBOR_COUNT,
-                            &nearest_k_indices,
-                            BOID_NEAREST_NEIGHBOR_RADIUS))
-            {
-                glm::vec3 group_centroid;
-                glm::vec3 average_heading;
-                size_t valid_neighbor_count = 0;
-                for(std::vector<long>::iterator q = nearest_k_indices.begin(); q != nearest_k_indices.end(); q++) {
-                    if(*q == index2) { // ignore self
-                        continue;
-                    }
-                    vt::Mesh* other_object         = boid_meshes[*q];
-                    glm::vec3 other_object_pos     = other_object->get_origin();
-                    glm::vec3 other_object_heading = other_object->get_abs_heading();
-
-                    // collect stats
-                    if(glm::degrees(glm::angle(self_object_heading, other_object_heading))                               < BOID_MAX_HEADING_DEVIATION &&
-                       glm::degrees(glm::angle(self_object_heading, glm::normalize(other_object_pos - self_object_pos))) < BOID_MAX_FOV_DEVIATION)
-                    {
-                        group_centroid  += other_object_pos;
-                        average_heading += other_object_heading;
-                        valid_neighbor_count++;
-                        self_object->m_debug_lines.push_back(std::tuple<glm::vec3, glm::vec3, glm::vec3>(glm::vec3(1, 1, 0), self_object_pos, other_object_pos));
-                    }
-                }
-                if(nearest_k_indices.size() >= 2) {
-                    vt::Mesh* nearest_other_object     = boid_meshes[nearest_k_indices[1]];
-                    glm::vec3 nearest_other_object_pos = nearest_other_object->get_origin();
-
-                    if(glm::distance(self_object_pos, nearest_other_object_pos) < BOID_AVOID_RADIUS) {
-                        self_object->update_boid(nearest_other_object_pos,
-                                                 boid_speed,
-                                                 BOID_AVOID_ANGLE_DELTA,
-                                                 BOID_AVOID_RADIUS); // separation
-                        if(wireframe_mode) {
-                            self_object->set_ambient_color(glm::vec3(1, 0, 0)); // red
-                        }
-                        boid_updated = true;
-                    } else if(valid_neighbor_count) {
-                        float contrib_factor = 1.0f / valid_neighbor_count;
-                        group_centroid *= contrib_factor;
-                        average_heading = self_object_pos + average_heading * contrib_factor;
-                        glm::vec3 weighted_average_target = LERP(group_centroid, average_heading, BOID_FLOCKING_COHESION_TO_ALIGNMENT_RATIO);
-                        self_object->update_boid(weighted_average_target,
-                                                 boid_speed,
-                                                 BOID_ANGLE_DELTA,
-                                                 0); // cohesion & alignment
-                        if(wireframe_mode) {
-                            self_object->set_ambient_color(glm::vec3(0, 1, 0)); // green
-                        }
-                        boid_updated = true;
-                    }
+        // neighbors
+        if(behaviors[index] == vt::FLOCK_BEHAVIOR_FLOCKING) {
+            const long* nearest_k_indices     = NULL;
+            int         nearest_k_index_count = flock_simulator->get_neighbors(index, &nearest_k_indices);
+            for(const long* q = nearest_k_indices; q != nearest_k_indices + nearest_k_index_count; q++) {
+                if(!flock_simulator->is_flocking_neighbor(index, *q)) { // only those that steer this boid
+                    continue;
                 }
+                self_object->m_debug_lines.push_back(std::tuple<glm::vec3, glm::vec3, glm::vec3>(glm::vec3(1, 1, 0), positions[index], positions[*q]));
             }
-            if(!boid_updated) {
-                glm::vec3 target = targets[target_index];
-                if(glm::distance(self_object_pos, target) < BOID_FLOCKING_RADIUS) {
-                    self_object->update_boid(target,
-                                             boid_speed,
-                                             BOID_ANGLE_DELTA,
-                                             BOID_AVOID_RADIUS); // target homing
-                    if(wireframe_mode) {
-                        self_object->set_ambient_color(glm::vec3(0, 1, 1)); // cyan
-                    }
-                } else {
-                    self_object->update_boid(boid_speed);
-                    if(wireframe_mode) {
-                        self_object->set_ambient_color(glm::vec3(0, 0, 1)); // blue
-                    }
-                }
+        }
+
+        if(wireframe_mode) {
+            switch(behaviors[index]) {
+                case vt::FLOCK_BEHAVIOR_OBSTACLE_AVOID: self_object->set_ambient_color(glm::vec3(1, 0, 1)); break; // magenta
+                case vt::FLOCK_BEHAVIOR_SEPARATION:     self_object->set_ambient_color(glm::vec3(1, 0, 0)); break; // red
+                case vt::FLOCK_BEHAVIOR_FLOCKING:       self_object->set_ambient_color(glm::vec3(0, 1, 0)); break; // green
+                case vt::FLOCK_BEHAVIOR_HOMING:         self_object->set_ambient_color(glm::vec3(0, 1, 1)); break; // cyan
+                case vt::FLOCK_BEHAVIOR_CRUISE:         self_object->set_ambient_color(glm::vec3(0, 0, 1)); break; // blue
+                default:
+                    break;
             }
         }
-        index2++;
+        index++;
     }
     static int angle = 0;
     angle = (angle + angle_delta) % 360;
@@ -617,6 +482,10 @@ void onDisplay()
     } else {
         scene->render();
     }
+    const std::vector<glm::vec3>& positions = flock_simulator->get_positions();
+    if(positions.size() > boid_meshes.size()) {
+        scene->render_points(&positions[boid_meshes.size()], positions.size() - boid_meshes.size(), glm::vec3(1));
+    }
     if(show_guide_wires || show_paths || show_axis || show_axis_labels || show_bbox || show_normals || show_help) {
         scene->render_lines_and_text(show_guide_wires, show_paths, show_axis, show_axis_labels, show_bbox, show_normals, show_help, get_help_string());
     }
@@ -632,6 +501,12 @@ void onKeyboard(unsigned char key, int x, int y)
         case 'b': // bbox
             show_bbox = !show_bbox;
             break;
+        case 'c': // temporal coherence
+            flock_simulator->set_use_find_hints(!flock_simulator->get_use_find_hints());
+            break;
+        case 'd': // double buffering
+            flock_simulator->set_double_buffered(!flock_simulator->get_double_buffered());
+            break;
         case 'f': // frame rate
             show_fps = !show_fps;
             if(!show_fps) {
@@ -653,6 +528,15 @@ void onKeyboard(unsigned char key, int x, int y)
         case 'n': // normals
             show_normals = !show_normals;
             break;
+        case 'o': // record positions
+            record_positions = !record_positions;
+            if(record_positions) {
+                position_stream.clear(flock_simulator->get_agent_count());
+            } else {
+                position_stream.save("boids.stream");
+                std::cout << "Saved " << position_stream.get_frame_count() << " frames to boids.stream" << std::endl;
+            }
+            break;
         case 'p': // projection
             if(camera->get_projection_mode() == vt::Camera::PROJECTION_MODE_PERSPECTIVE) {
                 camera->set_projection_mode(vt::Camera::PROJECTION_MODE_ORTHO);
@@ -664,10 +548,11 @@ void onKeyboard(unsigned char key, int x, int y)
             randomize_meshes(&obstacle_meshes,
                              OBSTACLE_INIT_SCATTER_MIN,
                              OBSTACLE_INIT_SCATTER_MAX);
-            randomize_boids(&boid_meshes,
+            index_obstacles(obstacle_octree, &obstacle_meshes);
+            randomize_boids(flock_simulator,
+                            boid_count,
                             BOID_INIT_SCATTER_MIN,
                             BOID_INIT_SCATTER_MAX);
-            octree->clear();
             break;
         case 's': // paths
             show_paths = !show_paths;
@@ -830,6 +715,15 @@ int main(int argc, char* argv[])
     glutInitWindowSize(init_screen_width, init_screen_height);
     glutCreateWindow(DEFAULT_CAPTION);
 
+    // glutInit leaves only non-GLUT arguments
+    if(argc > 1) {
+        boid_count = atoi(argv[1]);
+        if(boid_count <= 0) {
+            fprintf(stderr, "Usage: %s [boid_count]\n", argv[0]);
+            return 1;
+        }
+    }
+
     GLenum glew_status = glewInit();
     if(glew_status != GLEW_OK) {
         fprintf(stderr, "Error: %s\n", glewGetErrorString(glew_status));
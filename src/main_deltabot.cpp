@@ -41,6 +41,8 @@
 #include <Camera.h>
 #include <File3ds.h>
 #include <FrameBuffer.h>
+#include <IKBatchSolver.h>
+#include <IKChain.h>
 #include <KeyframeMgr.h>
 #include <Light.h>
 #include <Material.h>
@@ -52,6 +54,7 @@
 #include <Shader.h>
 #include <ShaderContext.h>
 #include <Texture.h>
+#include <ThreadPool.h>
 #include <Util.h>
 #include <VarAttribute.h>
 #include <VarUniform.h>
@@ -78,6 +81,7 @@
 #define IK_SEGMENT_COUNT             3
 #define IK_SEGMENT_HEIGHT            0.125
 #define IK_SEGMENT_WIDTH             0.25
+#define IK_SOLVER                    vt::IKChain::SOLVER_CCD // see bench_ik
 #define PATH_RADIUS                  0.5
 #define PUMP_SHRINK_FACTOR           0.5
 #define PUMP_SIDES                   6
@@ -137,9 +141,12 @@ struct IK_Leg
     vt::Mesh*              m_joint;
     vt::Mesh*              m_target;
     std::vector<vt::Mesh*> m_ik_meshes;
+    vt::IKChain*           m_ik_chain;
 };
 
 std::vector<IK_Leg*> ik_legs;
+vt::ThreadPool*      thread_pool     = NULL;
+vt::IKBatchSolver*   ik_batch_solver = NULL;
 
 static void create_linked_segments(vt::Scene*              scene,
                                    std::vector<vt::Mesh*>* ik_meshes,
@@ -316,9 +323,14 @@ int init_resources()
             }
             leg_segment_index++;
         }
+        ik_leg->m_ik_chain = new vt::IKChain(ik_meshes[0], ik_meshes[IK_SEGMENT_COUNT - 1], glm::vec3(0, 0, IK_SEGMENT_2_LENGTH));
+        ik_leg->m_ik_chain->set_solver(IK_SOLVER);
         ik_legs.push_back(ik_leg);
     }
 
+    thread_pool     = new vt::ThreadPool();
+    ik_batch_solver = new vt::IKBatchSolver(thread_pool);
+
     long object_id = 0;
     float low_height  = -BODY_ELEVATION;
     float high_height = -BODY_ELEVATION * 0.75;
@@ -339,6 +351,11 @@ int init_resources()
 
 int deinit_resources()
 {
+    for(std::vector<IK_Leg*>::iterator p = ik_legs.begin(); p != ik_legs.end(); p++) {
+        delete (*p)->m_ik_chain;
+    }
+    delete ik_batch_solver;
+    delete thread_pool;
     return 1;
 }
 
@@ -401,17 +418,15 @@ void onTick()
     body->get_transform(); // ensure transform is updated
     target_index = (target_index + 1) % vt::Scene::instance()->m_debug_targets.size();
     if(user_input) {
+        ik_batch_solver->clear();
+        for(std::vector<IK_Leg*>::iterator q = ik_legs.begin(); q != ik_legs.end(); q++) {
+            ik_batch_solver->add((*q)->m_ik_chain, (*q)->m_target->in_abs_system());
+        }
+        ik_batch_solver->solve(IK_ITERS, ACCEPT_END_EFFECTOR_DISTANCE, ACCEPT_AVG_ANGLE_DISTANCE);
         std::stringstream ss;
         int leg_index = 0;
         for(std::vector<IK_Leg*>::iterator r = ik_legs.begin(); r != ik_legs.end(); r++) {
             std::vector<vt::Mesh*> &ik_meshes = (*r)->m_ik_meshes;
-            ik_meshes[IK_SEGMENT_COUNT - 1]->solve_ik_ccd(ik_meshes[0],
-                                                          glm::vec3(0, 0, IK_SEGMENT_2_LENGTH),
-                                                          (*r)->m_target->in_abs_system(),
-                                                          NULL,
-                                                          IK_ITERS,
-                                                          ACCEPT_END_EFFECTOR_DISTANCE,
-                                                          ACCEPT_AVG_ANGLE_DISTANCE);
             ss << "Leg #" << leg_index << ": Pitch=" << EULER_PITCH(ik_meshes[0]->get_euler());
             if(r != --ik_legs.end()) {
                 ss << ", ";
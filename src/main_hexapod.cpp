@@ -41,6 +41,8 @@
 #include <Camera.h>
 #include <File3ds.h>
 #include <FrameBuffer.h>
+#include <IKBatchSolver.h>
+#include <IKChain.h>
 #include <KeyframeMgr.h>
 #include <Light.h>
 #include <Material.h>
@@ -52,6 +54,7 @@
 #include <Shader.h>
 #include <ShaderContext.h>
 #include <Texture.h>
+#include <ThreadPool.h>
 #include <Util.h>
 #include <VarAttribute.h>
 #include <VarUniform.h>
@@ -74,6 +77,7 @@
 #define IK_SEGMENT_HEIGHT            0.25
 #define IK_SEGMENT_LENGTH            1
 #define IK_SEGMENT_WIDTH             0.25
+#define IK_SOLVER                    vt::IKChain::SOLVER_CCD // see bench_ik
 #define PATH_RADIUS                  0.5
 
 const char* DEFAULT_CAPTION = "";
@@ -129,10 +133,13 @@ struct IK_Leg
 {
     vt::Mesh*              m_joint;
     std::vector<vt::Mesh*> m_ik_meshes;
+    vt::IKChain*           m_ik_chain;
     glm::vec3              m_target;
 };
 
 std::vector<IK_Leg*> ik_legs;
+vt::ThreadPool*      thread_pool     = NULL;
+vt::IKBatchSolver*   ik_batch_solver = NULL;
 
 static void create_linked_segments(vt::Scene*              scene,
                                    std::vector<vt::Mesh*>* ik_meshes,
@@ -262,10 +269,15 @@ int init_resources()
             }
             leg_segment_index++;
         }
+        ik_leg->m_ik_chain = new vt::IKChain(ik_leg->m_joint, ik_meshes[IK_SEGMENT_COUNT - 1], glm::vec3(0, 0, IK_SEGMENT_LENGTH));
+        ik_leg->m_ik_chain->set_solver(IK_SOLVER);
         ik_legs.push_back(ik_leg);
         angle += (360 / IK_LEG_COUNT);
     }
 
+    thread_pool     = new vt::ThreadPool();
+    ik_batch_solver = new vt::IKBatchSolver(thread_pool);
+
     long object_id = 0;
     float low_height  = -BODY_ELEVATION * 0.25;
     float high_height = 0;
@@ -286,6 +298,11 @@ int init_resources()
 
 int deinit_resources()
 {
+    for(std::vector<IK_Leg*>::iterator p = ik_legs.begin(); p != ik_legs.end(); p++) {
+        delete (*p)->m_ik_chain;
+    }
+    delete ik_batch_solver;
+    delete thread_pool;
     return 1;
 }
 
@@ -366,16 +383,11 @@ void onTick()
     body->get_transform(); // ensure transform is updated
     target_index = (target_index + 1) % vt::Scene::instance()->m_debug_targets.size();
     if(user_input) {
+        ik_batch_solver->clear();
         for(std::vector<IK_Leg*>::iterator r = ik_legs.begin(); r != ik_legs.end(); r++) {
-            std::vector<vt::Mesh*> &ik_meshes = (*r)->m_ik_meshes;
-            ik_meshes[IK_SEGMENT_COUNT - 1]->solve_ik_ccd((*r)->m_joint,
-                                                          glm::vec3(0, 0, IK_SEGMENT_LENGTH),
-                                                          (*r)->m_target,
-                                                          NULL,
-                                                          IK_ITERS,
-                                                          ACCEPT_END_EFFECTOR_DISTANCE,
-                                                          ACCEPT_AVG_ANGLE_DISTANCE);
+            ik_batch_solver->add((*r)->m_ik_chain, (*r)->m_target);
         }
+        ik_batch_solver->solve(IK_ITERS, ACCEPT_END_EFFECTOR_DISTANCE, ACCEPT_AVG_ANGLE_DISTANCE);
         user_input = false;
     }
     static int angle = 0;
@@ -48,12 +48,14 @@
 #include <Mesh.h>
 #include <Modifiers.h>
 #include <Octree.h>
+#include <PositionStream.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
 #include <Texture.h>
+#include <ThreadPool.h>
 #include <Util.h>
 #include <VarAttribute.h>
 #include <VarUniform.h>
@@ -63,9 +65,8 @@
 #include <iomanip> // std::setprecision
 #include <math.h>
 
-#define BOID_NEAREST_NEIGHBOR_RADIUS 10
-
-#define BOID_COUNT            100
+#define BOID_COUNT            100  // default when not given on the command line
+#define BOID_MESH_COUNT_MAX   1000 // bodies past this have no mesh and are drawn as points
 #define BOID_DIM              glm::vec3(0.0625, 0.0625, 0.0625)
 #define BOID_INIT_SCATTER_MAX glm::vec3(5)
 #define BOID_INIT_SCATTER_MIN glm::vec3(-5)
@@ -73,11 +74,23 @@
 #define BOID_ANGLE_DELTA            2.5f
 #define BOID_FORWARD_SPEED_MIN      0.0125f
 #define BOID_FORWARD_SPEED_MAX      0.025f
-#define BOID_NEAREST_NEIGHBOR_COUNT 20
+#define BOID_MASS                   1.0f
 #define OCTREE_ORIGIN               glm::vec3(-5)
 #define OCTREE_DIM                  glm::vec3(10)
+#define OCTREE_NODE_CAPACITY        16 // gravity traversals favor fewer, fuller leaves (see bench_octree gravity)
+#define OCTREE_DEPTH_LIMIT          8
 
 #define GRAVITATIONAL_CONSTANT 0.00001f
+#define BARNES_HUT_THETA       0.7f // ~0.35% rms force error on 100k uniform bodies, 2.2x faster than 0.5
+#define GRAVITY_SOFTENING      0.1f
+
+#define SIM_TICK_MS             (1000.0f / 60) // one unit of simulation time
+#define SIM_STEP_MIN            0.125f         // fixed step bounds, in ticks
+#define SIM_STEP_MAX            8.0f
+#define SIM_MAX_STEPS_PER_FRAME 8              // drop sim time rather than fall further behind on slow frames
+#define SIM_SUBSTEP_ETA         0.25f          // substep <= eta * sqrt(softening / peak acceleration)
+#define SIM_MAX_SUBSTEPS        16
+#define SIM_BUDGET_MS           50             // wall-clock time simulate() may spend per frame, the rest is dropped
 
 //#define DEBUG 1
 
@@ -93,6 +106,7 @@ vt::Light   *light          = NULL,
             *light2         = NULL,
             *light3         = NULL;
 vt::Texture *texture_skybox = NULL;
+vt::ThreadPool *thread_pool = NULL;
 
 bool left_mouse_down  = false,
      right_mouse_down = false;
@@ -133,16 +147,28 @@ int angle_delta = 1;
 int target_index = 7;
 glm::vec3 targets[8];
 
-std::vector<vt::Mesh*> boid_meshes;
-glm::vec3 boid_origin[BOID_COUNT];
-glm::vec3 boid_velocity[BOID_COUNT];
-
-static void randomize_boids(std::vector<vt::Mesh*>* meshes,
-                            glm::vec3               scatter_min,
-                            glm::vec3               scatter_max)
+int boid_count = BOID_COUNT;
+std::vector<vt::Mesh*> boid_meshes; // mirror the first few bodies
+std::vector<glm::vec3> boid_origin;
+std::vector<glm::vec3> boid_velocity;
+std::vector<glm::vec3> boid_accelerations;
+std::vector<float> boid_potentials;
+
+float sim_step       = 1; // fixed step, in ticks
+float sim_time_accum = 0; // wall-clock time not yet simulated, in ticks
+int   sim_substeps   = 1; // taken by the last step
+float initial_energy = 0;
+float energy         = 0;
+vt::PositionStream position_stream;
+bool record_positions = false;
+
+static void randomize_boids(int       boid_count,
+                            glm::vec3 scatter_min,
+                            glm::vec3 scatter_max)
 {
-    size_t boid_count = meshes->size();
-    for(int i = 0; i < static_cast<int>(boid_count); i++) {
+    boid_origin.resize(boid_count);
+    boid_velocity.resize(boid_count);
+    for(int i = 0; i < boid_count; i++) {
         glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
                            static_cast<float>(rand()) / RAND_MAX,
                            static_cast<float>(rand()) / RAND_MAX);
@@ -157,15 +183,12 @@ static void randomize_boids(std::vector<vt::Mesh*>* meshes,
 static void create_boids(vt::Scene*              scene,
                          std::vector<vt::Mesh*>* boid_meshes,
                          int                     boid_count,
-                         glm::vec3               scatter_min,
-                         glm::vec3               scatter_max,
                          glm::vec3               box_dim,
                          std::string             name)
 {
     if(!scene || !boid_meshes) {
         return;
     }
-    srand(time(NULL));
     for(int i = 0; i < boid_count; i++) {
         std::stringstream ss;
         ss << i;
@@ -178,9 +201,119 @@ static void create_boids(vt::Scene*              scene,
         scene->add_mesh(mesh);
         boid_meshes->push_back(mesh);
     }
-    randomize_boids(boid_meshes,
-                    scatter_min,
-                    scatter_max);
+}
+
+// bounce off the octree walls (unlike wrapping around, keeps the total energy)
+static void reflect_boid(int index)
+{
+    glm::vec3 wall_min = OCTREE_ORIGIN;
+    glm::vec3 wall_max = OCTREE_ORIGIN + OCTREE_DIM;
+    for(int i = 0; i < 3; i++) {
+        if(boid_origin[index][i] < wall_min[i]) {
+            boid_origin[index][i]   = wall_min[i] * 2 - boid_origin[index][i];
+            boid_velocity[index][i] = -boid_velocity[index][i];
+        } else if(boid_origin[index][i] > wall_max[i]) {
+            boid_origin[index][i]   = wall_max[i] * 2 - boid_origin[index][i];
+            boid_velocity[index][i] = -boid_velocity[index][i];
+        }
+    }
+}
+
+static void update_octree()
+{
+    for(long index = 0; index < boid_count; index++) {
+        // keep boids in octree
+        reflect_boid(index);
+        glm::vec3 self_object_pos = boid_origin[index];
+        if(index < static_cast<long>(boid_meshes.size())) {
+            boid_meshes[index]->set_origin(self_object_pos);
+        }
+
+        // add/update
+        if(octree->exists(index)) {
+            octree->move(index, self_object_pos);
+        } else {
+            octree->insert(index, self_object_pos, BOID_MASS);
+        }
+    }
+
+    // rebalance
+    octree->rebalance();
+}
+
+// pull of every other body at once, far-away clusters lumped together (octree stays unchanged meanwhile)
+static void update_accelerations()
+{
+    octree->gravity_batch(boid_origin,
+                          BARNES_HUT_THETA,
+                          GRAVITY_SOFTENING,
+                          &boid_accelerations,
+                          thread_pool,
+                          &boid_potentials);
+    for(int i = 0; i < boid_count; i++) {
+        boid_accelerations[i] *= GRAVITATIONAL_CONSTANT;
+    }
+}
+
+// kinetic plus potential, from the potentials of the last update_accelerations()
+static float get_total_energy()
+{
+    float total_energy = 0;
+    for(int i = 0; i < boid_count; i++) {
+        total_energy += BOID_MASS * 0.5f * glm::dot(boid_velocity[i], boid_velocity[i]);
+        total_energy += BOID_MASS * 0.5f * GRAVITATIONAL_CONSTANT * boid_potentials[i]; // each pair counted twice
+    }
+    return total_energy;
+}
+
+// velocity verlet (kick-drift-kick), reusing accelerations left by the previous step
+static void step_verlet(float dt)
+{
+    for(int i = 0; i < boid_count; i++) {
+        boid_velocity[i] += boid_accelerations[i] * (dt * 0.5f);
+        boid_origin[i]   += boid_velocity[i] * dt;
+    }
+    update_octree();
+    update_accelerations();
+    for(int i = 0; i < boid_count; i++) {
+        boid_velocity[i] += boid_accelerations[i] * (dt * 0.5f);
+    }
+}
+
+// fixed steps for the elapsed wall-clock time, each split finer while bodies pass close to each other
+// stops once SIM_BUDGET_MS is spent (large populations in close encounters), dropping the sim time still owed
+static void simulate(float elapsed_ticks)
+{
+    unsigned int start_tick = glutGet(GLUT_ELAPSED_TIME);
+    sim_time_accum = std::min(sim_time_accum + elapsed_ticks, sim_step * SIM_MAX_STEPS_PER_FRAME);
+    while(sim_time_accum >= sim_step) {
+        float max_acceleration2 = 0;
+        for(int i = 0; i < boid_count; i++) {
+            max_acceleration2 = std::max(max_acceleration2, glm::dot(boid_accelerations[i], boid_accelerations[i]));
+        }
+        sim_substeps = 1;
+        if(max_acceleration2 > 0) {
+            float max_substep = SIM_SUBSTEP_ETA * sqrt(GRAVITY_SOFTENING / sqrt(max_acceleration2));
+            sim_substeps = std::min(std::max(static_cast<int>(ceil(sim_step / max_substep)), 1), SIM_MAX_SUBSTEPS);
+        }
+        for(int i = 0; i < sim_substeps; i++) {
+            step_verlet(sim_step / sim_substeps);
+            if(glutGet(GLUT_ELAPSED_TIME) - start_tick >= SIM_BUDGET_MS) {
+                sim_time_accum = 0;
+                break;
+            }
+        }
+        sim_time_accum = std::max(sim_time_accum - sim_step, 0.0f);
+    }
+    energy = get_total_energy();
+}
+
+static void reset_simulation()
+{
+    update_octree();
+    update_accelerations();
+    initial_energy = energy = get_total_energy();
+    sim_time_accum = 0;
 }
 
 int init_resources()
@@ -224,8 +357,9 @@ int init_resources()
     glm::vec3 origin = glm::vec3(0);
     camera = new vt::Camera("camera", origin + glm::vec3(0, 0, orbit_radius), origin);
     scene->set_camera(camera);
-    octree = new vt::Octree(OCTREE_ORIGIN, OCTREE_DIM);
+    octree = new vt::Octree(OCTREE_ORIGIN, OCTREE_DIM, vt::OctreeConfig(OCTREE_NODE_CAPACITY, OCTREE_DEPTH_LIMIT));
     scene->set_octree(octree);
+    thread_pool = new vt::ThreadPool();
     box = vt::PrimitiveFactory::create_box("octree", OCTREE_DIM.x, OCTREE_DIM.y, OCTREE_DIM.z);
     box->center_axis();
     box->set_origin(glm::vec3(0));
@@ -241,20 +375,20 @@ int init_resources()
     mesh_skybox->set_material(skybox_material);
     mesh_skybox->set_texture_index(mesh_skybox->get_material()->get_texture_index_by_name("skybox_texture"));
 
+    srand(time(NULL));
     create_boids(scene,
                  &boid_meshes,
-                 BOID_COUNT,
-                 BOID_INIT_SCATTER_MIN,
-                 BOID_INIT_SCATTER_MAX,
+                 std::min(boid_count, BOID_MESH_COUNT_MAX),
                  BOID_DIM,
                  "boid");
-    long index = 0;
+    randomize_boids(boid_count,
+                    BOID_INIT_SCATTER_MIN,
+                    BOID_INIT_SCATTER_MAX);
     for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); p++) {
         (*p)->set_material(phong_material);
         (*p)->set_ambient_color(glm::vec3(0));
-        octree->insert(index, (*p)->get_origin());
-        index++;
     }
+    reset_simulation();
 
     vt::Scene::instance()->m_debug_target = targets[target_index];
 
@@ -263,6 +397,7 @@ int init_resources()
 
 int deinit_resources()
 {
+    delete thread_pool;
     return 1;
 }
 
@@ -288,81 +423,29 @@ void onTick()
         ss << std::setprecision(2) << std::fixed << fps << " FPS, "
             << "Mouse: {" << mouse_drag.x << ", " << mouse_drag.y << "}, "
             << "Yaw=" << EULER_YAW(euler) << ", Pitch=" << EULER_PITCH(euler) << ", Radius=" << orbit_radius << ", "
-            << "Zoom=" << zoom;
+            << "Zoom=" << zoom << ", "
+            << "Step=" << sim_step << "x" << sim_substeps << ", "
+            << "Energy drift=" << std::setprecision(4) << (initial_energy ? (energy - initial_energy) / fabs(initial_energy) * 100 : 0) << "%";
         //ss << "Width=" << camera->get_width() << ", Width=" << camera->get_height();
         glutSetWindowTitle(ss.str().c_str());
     }
     frames++;
+    static unsigned int prev_sim_tick = tick;
+    float elapsed_ticks = (tick - prev_sim_tick) / SIM_TICK_MS;
+    prev_sim_tick = tick;
     if(!do_animation) {
         return;
     }
 
     // clear
     //octree->clear();
+    octree->reset_stats(); // hud shows this tick's counters
 
-    long index = 0;
-    for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); p++) {
-        vt::Mesh* self_object = *p;
-
-        // keep boids in octree
-        boid_origin[index] = box->wrap(boid_origin[index]);
-        glm::vec3 self_object_pos = boid_origin[index];
-        self_object->set_origin(self_object_pos);
-
-        // add/update
-        if(octree->exists(index)) {
-            octree->move(index, self_object_pos);
-        } else {
-            octree->insert(index, self_object_pos);
-        }
-        index++;
-    }
-
-    // rebalance
-    octree->rebalance();
+    simulate(elapsed_ticks);
 
-    long index2 = 0;
-    for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); p++) {
-        vt::Mesh* self_object     = *p;
-        glm::vec3 self_object_pos = self_object->get_origin();
-
-        self_object->m_debug_lines.clear();
-
-        // flocking behavior
-        std::vector<long> nearest_k_indices;
-        bool boid_updated = false;
-        if(octree->find(self_object_pos,
-                        BOID_NEAREST_NEIGHBOR_COUNT,
-                        &nearest_k_indices,
-                        BOID_NEAREST_NEIGHBOR_RADIUS))
-        {
-            glm::vec3 group_centroid;
-            size_t valid_neighbor_count = 0;
-            for(std::vector<long>::iterator q = nearest_k_indices.begin(); q != nearest_k_indices.end(); q++) {
-                if(*q == index2) { // ignore self
-                    continue;
-                }
-                vt::Mesh* other_object     = boid_meshes[*q];
-                glm::vec3 other_object_pos = other_object->get_origin();
-
-                // collect stats
-                group_centroid += other_object_pos;
-                valid_neighbor_count++;
-                self_object->m_debug_lines.push_back(std::tuple<glm::vec3, glm::vec3, glm::vec3>(glm::vec3(0, 1, 1), self_object_pos, other_object_pos));
-            }
-            if(nearest_k_indices.size() >= 2) {
-                float contrib_factor = 1.0f / valid_neighbor_count;
-                group_centroid *= contrib_factor;
-                float mass = valid_neighbor_count;
-                float force = GRAVITATIONAL_CONSTANT * mass / pow(glm::distance(group_centroid, self_object_pos), 2);
-                boid_velocity[index2] += glm::normalize(group_centroid - self_object_pos) * force;
-                boid_velocity[index2] = glm::normalize(boid_velocity[index2]) * std::min(glm::length(boid_velocity[index2]), BOID_FORWARD_SPEED_MAX);
-            }
-        }
-        if(!boid_updated) {
-            boid_origin[index2] += boid_velocity[index2];
-        }
-        index2++;
+    // record for bench_octree_tune
+    if(record_positions) {
+        position_stream.add_frame(&boid_origin[0]);
     }
 
     static int angle = 0;
@@ -387,6 +470,9 @@ void onDisplay()
     } else {
         scene->render();
     }
+    if(boid_count > static_cast<int>(boid_meshes.size())) {
+        scene->render_points(&boid_origin[boid_meshes.size()], boid_count - boid_meshes.size(), glm::vec3(1));
+    }
     if(show_guide_wires || show_paths || show_axis || show_axis_labels || show_bbox || show_normals || show_help) {
         scene->render_lines_and_text(show_guide_wires, show_paths, show_axis, show_axis_labels, show_bbox, show_normals, show_help, get_help_string());
     }
@@ -399,6 +485,12 @@ void onDisplay()
 void onKeyboard(unsigned char key, int x, int y)
 {
     switch(key) {
+        case '[': // smaller step
+            sim_step = std::max(sim_step * 0.5f, SIM_STEP_MIN);
+            break;
+        case ']': // larger step
+            sim_step = std::min(sim_step * 2, SIM_STEP_MAX);
+            break;
         case 'b': // bbox
             show_bbox = !show_bbox;
             break;
@@ -423,6 +515,15 @@ void onKeyboard(unsigned char key, int x, int y)
         case 'n': // normals
             show_normals = !show_normals;
             break;
+        case 'o': // record positions
+            record_positions = !record_positions;
+            if(record_positions) {
+                position_stream.clear(boid_count);
+            } else {
+                position_stream.save("nbody.stream");
+                std::cout << "Saved " << position_stream.get_frame_count() << " frames to nbody.stream" << std::endl;
+            }
+            break;
         case 'p': // projection
             if(camera->get_projection_mode() == vt::Camera::PROJECTION_MODE_PERSPECTIVE) {
                 camera->set_projection_mode(vt::Camera::PROJECTION_MODE_ORTHO);
@@ -431,10 +532,11 @@ void onKeyboard(unsigned char key, int x, int y)
             }
             break;
         case 'r': // reset
-            randomize_boids(&boid_meshes,
+            randomize_boids(boid_count,
                             BOID_INIT_SCATTER_MIN,
                             BOID_INIT_SCATTER_MAX);
             octree->clear();
+            reset_simulation();
             break;
         case 's': // paths
             show_paths = !show_paths;
@@ -591,6 +693,15 @@ int main(int argc, char* argv[])
     glutInitWindowSize(init_screen_width, init_screen_height);
     glutCreateWindow(DEFAULT_CAPTION);
 
+    // glutInit leaves only non-GLUT arguments
+    if(argc > 1) {
+        boid_count = atoi(argv[1]);
+        if(boid_count <= 0) {
+            fprintf(stderr, "Usage: %s [boid_count]\n", argv[0]);
+            return 1;
+        }
+    }
+
     GLenum glew_status = glewInit();
     if(glew_status != GLEW_OK) {
         fprintf(stderr, "Error: %s\n", glewGetErrorString(glew_status));
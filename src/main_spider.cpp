@@ -43,6 +43,8 @@
 #include <File3ds.h>
 #include <FilePng.h>
 #include <FrameBuffer.h>
+#include <IKBatchSolver.h>
+#include <IKChain.h>
 #include <Light.h>
 #include <Material.h>
 #include <Mesh.h>
@@ -53,6 +55,7 @@
 #include <Shader.h>
 #include <ShaderContext.h>
 #include <Texture.h>
+#include <ThreadPool.h>
 #include <Util.h>
 #include <VarAttribute.h>
 #include <VarUniform.h>
@@ -78,6 +81,7 @@
 #define IK_SEGMENT_HEIGHT              0.05
 #define IK_SEGMENT_LENGTH              0.5
 #define IK_SEGMENT_WIDTH               0.05
+#define IK_SOLVER                      vt::IKChain::SOLVER_CCD // see bench_ik
 #define LEG_INNER_RADIUS               0.25
 #define LEG_OUTER_RADIUS               1
 #define LERP_PARABOLIC_DOWN_ARC(alpha) (-pow((alpha) * 2 - 1, 2) + 1)
@@ -147,6 +151,7 @@ struct IK_Leg
 {
     vt::Mesh*              m_joint;
     std::vector<vt::Mesh*> m_ik_meshes;
+    vt::IKChain*           m_ik_chain;
     int                    m_target_index;
     glm::vec3              m_from_point;
     glm::vec3              m_to_point;
@@ -154,6 +159,8 @@ struct IK_Leg
 };
 
 std::vector<IK_Leg*> ik_legs;
+vt::ThreadPool*      thread_pool     = NULL;
+vt::IKBatchSolver*   ik_batch_solver = NULL;
 
 static void create_linked_segments(vt::Scene*              scene,
                                    std::vector<vt::Mesh*>* ik_meshes,
@@ -509,10 +516,15 @@ int init_resources()
             }
             leg_segment_index++;
         }
+        ik_leg->m_ik_chain = new vt::IKChain(ik_leg->m_joint, ik_meshes[IK_SEGMENT_COUNT - 1], glm::vec3(0, 0, IK_SEGMENT_LENGTH));
+        ik_leg->m_ik_chain->set_solver(IK_SOLVER);
         ik_legs.push_back(ik_leg);
         angle += (360 / IK_LEG_COUNT);
     }
 
+    thread_pool     = new vt::ThreadPool();
+    ik_batch_solver = new vt::IKBatchSolver(thread_pool);
+
     vt::Scene::instance()->m_debug_targets.resize(IK_LEG_COUNT);
 
     return 1;
@@ -523,6 +535,11 @@ int deinit_resources()
     if(height_map_pixel_data) {
         delete[] height_map_pixel_data;
     }
+    for(std::vector<IK_Leg*>::iterator p = ik_legs.begin(); p != ik_legs.end(); p++) {
+        delete (*p)->m_ik_chain;
+    }
+    delete ik_batch_solver;
+    delete thread_pool;
     return 1;
 }
 
@@ -647,21 +664,16 @@ void onTick()
         }
         user_input = false;
     }
+    ik_batch_solver->clear();
     for(std::vector<IK_Leg*>::iterator r = ik_legs.begin(); r != ik_legs.end(); r++) {
-        std::vector<vt::Mesh*> &ik_meshes = (*r)->m_ik_meshes;
         glm::vec3 interp_point = LERP((*r)->m_from_point, (*r)->m_to_point, (*r)->m_alpha);
         float leg_lift_height = LERP_PARABOLIC_DOWN_ARC((*r)->m_alpha) * IK_LEG_MAX_LIFT_HEIGHT; // parabolic leg-lift path
-        ik_meshes[IK_SEGMENT_COUNT - 1]->solve_ik_ccd((*r)->m_joint,
-                                                      glm::vec3(0, 0, IK_SEGMENT_LENGTH),
-                                                      interp_point + glm::vec3(0, leg_lift_height, 0),
-                                                      NULL,
-                                                      IK_ITERS,
-                                                      ACCEPT_END_EFFECTOR_DISTANCE,
-                                                      ACCEPT_AVG_ANGLE_DISTANCE);
+        ik_batch_solver->add((*r)->m_ik_chain, interp_point + glm::vec3(0, leg_lift_height, 0));
         if((*r)->m_alpha < 1) {
             (*r)->m_alpha += ANIM_ALPHA_STEP;
         }
     }
+    ik_batch_solver->solve(IK_ITERS, ACCEPT_END_EFFECTOR_DISTANCE, ACCEPT_AVG_ANGLE_DISTANCE);
     static int angle = 0;
     angle = (angle + angle_delta) % 360;
 }
@@ -41,6 +41,7 @@
 #include <Camera.h>
 #include <File3ds.h>
 #include <FrameBuffer.h>
+#include <IKChain.h>
 #include <KeyframeMgr.h>
 #include <Light.h>
 #include <Material.h>
@@ -129,6 +130,7 @@ struct IK_Leg
 {
     vt::Mesh*              m_joint;
     std::vector<vt::Mesh*> m_ik_meshes;
+    vt::IKChain*           m_ik_chain;
     glm::vec3              m_target;
 };
 
@@ -314,6 +316,7 @@ int init_resources()
                 }
                 leg_segment_index++;
             }
+            ik_leg->m_ik_chain = new vt::IKChain(ik_leg->m_joint, ik_meshes[IK_SEGMENT_COUNT + 1 - 1], glm::vec3(0, 0, IK_SEGMENT_LENGTH));
             ik_legs.push_back(ik_leg);
         } else {
             //ik_leg->m_joint->set_hinge_type(vt::EULER_INDEX_ROLL);
@@ -351,6 +354,7 @@ int init_resources()
                 }
                 leg_segment_index++;
             }
+            ik_leg->m_ik_chain = new vt::IKChain(ik_leg->m_joint, ik_meshes[IK_SEGMENT_COUNT - 1], glm::vec3(0, 0, IK_SEGMENT_LENGTH)); // closed form, see IKChain::solve_analytic
             ik_legs.push_back(ik_leg);
         }
         //angle += (360 / IK_LEG_COUNT);
@@ -407,6 +411,9 @@ int init_resources()
 
 int deinit_resources()
 {
+    for(std::vector<IK_Leg*>::iterator p = ik_legs.begin(); p != ik_legs.end(); p++) {
+        delete (*p)->m_ik_chain;
+    }
     return 1;
 }
 
@@ -488,28 +495,26 @@ void onTick()
     if(user_input) {
         for(int i = 0; i < IK_LEG_COUNT; i++) {
             IK_Leg* ik_leg = ik_legs[i];
-            std::vector<vt::Mesh*> &ik_meshes = ik_leg->m_ik_meshes;
+            vt::IKChain* ik_chain = ik_leg->m_ik_chain;
+            ik_chain->load();
             if(i == 4) { // end-effector
-                ik_meshes[IK_SEGMENT_COUNT + 1 - 1]->solve_ik_ccd(ik_leg->m_joint,
-                                                                  glm::vec3(0, 0, IK_SEGMENT_LENGTH),
-                                                                  ik_leg->m_target,
-                                                                  &end_effector_dir,
-                                                                  IK_ITERS,
-                                                                  ACCEPT_END_EFFECTOR_DISTANCE,
-                                                                  ACCEPT_AVG_ANGLE_DISTANCE);
+                ik_chain->solve(ik_leg->m_target,
+                                &end_effector_dir,
+                                IK_ITERS,
+                                ACCEPT_END_EFFECTOR_DISTANCE,
+                                ACCEPT_AVG_ANGLE_DISTANCE);
             } else {
-                ik_meshes[IK_SEGMENT_COUNT - 1]->solve_ik_ccd(ik_leg->m_joint,
-                                                              glm::vec3(0, 0, IK_SEGMENT_LENGTH),
-                                                              vt::Scene::instance()->m_debug_targets[leg_anim_frame[i]],
-                                                              NULL,
-                                                              IK_ITERS,
-                                                              ACCEPT_END_EFFECTOR_DISTANCE,
-                                                              ACCEPT_AVG_ANGLE_DISTANCE);
+                ik_chain->solve(vt::Scene::instance()->m_debug_targets[leg_anim_frame[i]],
+                                NULL,
+                                IK_ITERS,
+                                ACCEPT_END_EFFECTOR_DISTANCE,
+                                ACCEPT_AVG_ANGLE_DISTANCE);
                 leg_anim_frame[i]++;
                 if(leg_anim_frame[i] > leg_anim_frame_range[i].second) {
                     leg_anim_frame[i] = leg_anim_frame_range[i].first;
                 }
             }
+            ik_chain->commit();
         }
         user_input = false;
     }